@@ -20,14 +20,25 @@
 
 #include "CRC32.h"
 
-CRC32::CRC32() : crc(0) {
+CRC32::CRC32() : crc(0xFFFFFFFF) {
     crcFunction = detectBestCRC32C();
+    //reflected polynomial 0x1EDC6F41, same result as the crc32 instruction of sse 4.2
+    for(unsigned i = 0; i < (1<<8); ++i) {
+        unsigned entry = i;
+        for(unsigned bit = 0; bit < 8; ++bit) {
+            entry = (entry >> 1) ^ (0x82F63B78 & (0 - (entry & 1)));
+        }
+        slowcrc_table[i] = entry;
+    }
 }
 
+//continues from crc like the sse based computation
 unsigned CRC32::SoftwareBasedCRC32(char *str, unsigned len, unsigned crc) {
-    boost::crc_optimal<32, 0x1EDC6F41, 0x0, 0x0, true, true> CRC32_Processor;
-    CRC32_Processor.process_bytes( str, len);
-    return CRC32_Processor.checksum();
+    while (len--) {
+        crc = slowcrc_table[(crc ^ (unsigned char)*str) & 0xff] ^ (crc >> 8);
+        ++str;
+    }
+    return crc;
 }
 
 unsigned CRC32::SSEBasedCRC32( char *str, unsigned len, unsigned crc) {
@@ -45,10 +56,11 @@ unsigned CRC32::SSEBasedCRC32( char *str, unsigned len, unsigned crc) {
         ++p;
     }
 
+    //the remaining bytes are processed one at a time (crc32b)
     str=(char*)p;
     while (r--) {
         __asm__ __volatile__(
-                ".byte 0xf2, 0xf, 0x38, 0xf1, 0xf1;"
+                ".byte 0xf2, 0xf, 0x38, 0xf0, 0xf1;"
                 :"=S"(crc)
                  :"0"(crc), "c"(*str)
         );
@@ -62,10 +74,8 @@ CRC32::CRC32CFunctionPtr CRC32::detectBestCRC32C() {
     unsigned ecx = cpuid(1);
     bool hasSSE42 = ecx & (1 << SSE42_BIT);
     if (hasSSE42) {
-        std::cout << "using hardware base sse computation" << std::endl;
         return &CRC32::SSEBasedCRC32; //crc32 hardware accelarated;
     } else {
-        std::cout << "using software base sse computation" << std::endl;
         return &CRC32::SoftwareBasedCRC32; //crc32cSlicingBy8;
     }
 }
@@ -79,7 +89,8 @@ unsigned CRC32::cpuid(unsigned functionInput) {
     return ecx;
 }
 
+//standard CRC32C: the state starts at all ones and the checksum of the data so far is the inverted state
 unsigned CRC32::operator()(char *str, unsigned len){
     crc =((*this).*(crcFunction))(str, len, crc);
-    return crc;
+    return crc ^ 0xFFFFFFFF;
 }
@@ -29,7 +29,7 @@ private:
     unsigned crc;
     unsigned slowcrc_table[1<<8];
 
-    typedef boost::crc_optimal<32, 0x1EDC6F41, 0x0, 0x0, true, true> my_crc_32_type;
+    typedef boost::crc_optimal<32, 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true, true> my_crc_32_type;
     typedef unsigned (CRC32::*CRC32CFunctionPtr)(char *str, unsigned len, unsigned crc);
 
     unsigned SoftwareBasedCRC32(char *str, unsigned len, unsigned crc);
@@ -24,8 +24,10 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <cassert>
 #include <cfloat>
 #include <stack>
+#include <vector>
 
 #include "../DataStructures/Coordinate.h"
+#include "SegmentDistance.h"
 
 /*This class object computes the bitvector of indicating generalized input points
  * according to the (Ramer-)Douglas-Peucker algorithm.
@@ -44,37 +46,10 @@ private:
     //Stack to simulate the recursion
     std::stack<PairOfPoints > recursionStack;
 
-    double ComputeDistanceOfPointToLine(const _Coordinate& inputPoint, const _Coordinate& source, const _Coordinate& target) const {
-        double r;
-        const double x = (double)inputPoint.lat;
-        const double y = (double)inputPoint.lon;
-        const double a = (double)source.lat;
-        const double b = (double)source.lon;
-        const double c = (double)target.lat;
-        const double d = (double)target.lon;
-        double p,q,mX,nY;
-        if(c != a) {
-            const double m = (d-b)/(c-a); // slope
-            // Projection of (x,y) on line joining (a,b) and (c,d)
-            p = ((x + (m*y)) + (m*m*a - m*b))/(1 + m*m);
-            q = b + m*(p - a);
-        } else {
-            p = c;
-            q = y;
-        }
-        nY = (d*p - c*q)/(a*d - b*c);
-        mX = (p - nY*a)/c;// These values are actually n/m+n and m/m+n , we neednot calculate the values of m an n as we are just interested in the ratio
-        r = mX;
-        if(r<=0){
-            return ((b - y)*(b - y) + (a - x)*(a - x));
-        }
-        else if(r >= 1){
-            return ((d - y)*(d - y) + (c - x)*(c - x));
-
-        }
-        // point lies in between
-        return (p-x)*(p-x) + (q-y)*(q-y);
-    }
+    //coordinates of the input in separate arrays and the distances of a range, reused between runs
+    std::vector<int> latitudes;
+    std::vector<int> longitudes;
+    std::vector<double> distances;
 
 public:
     void Run(std::vector<PointT> & inputVector, const unsigned zoomLevel) {
@@ -96,6 +71,13 @@ public:
                 ++rightBorderOfRange;
             } while( rightBorderOfRange < inputVector.size());
         }
+        latitudes.resize(inputVector.size());
+        longitudes.resize(inputVector.size());
+        distances.resize(inputVector.size());
+        for(std::size_t i = 0; i < inputVector.size(); ++i) {
+            latitudes[i] = inputVector[i].location.lat;
+            longitudes[i] = inputVector[i].location.lon;
+        }
         while(!recursionStack.empty()) {
             //pop next element
             const PairOfPoints pair = recursionStack.top();
@@ -106,9 +88,10 @@ public:
             assert(pair.first < pair.second);
             double maxDistance = -DBL_MAX;
             std::size_t indexOfFarthestElement = pair.second;
-            //find index idx of element with maxDistance
+            //find index idx of element with maxDistance, the distances of the range are computed in one batch
+            ComputeSquaredDistancesOfPointsToSegment(&latitudes[pair.first+1], &longitudes[pair.first+1], pair.second-pair.first-1, inputVector[pair.first].location, inputVector[pair.second].location, &distances[pair.first+1]);
             for(std::size_t i = pair.first+1; i < pair.second; ++i){
-                double distance = std::fabs(ComputeDistanceOfPointToLine(inputVector[i].location, inputVector[pair.first].location, inputVector[pair.second].location));
+                const double distance = distances[i];
                 if(distance > DouglasPeuckerThresholds[zoomLevel] && distance > maxDistance) {
                     indexOfFarthestElement = i;
                     maxDistance = distance;
@@ -0,0 +1,207 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SEGMENTDISTANCE_H_
+#define SEGMENTDISTANCE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../DataStructures/Coordinate.h"
+
+/*
+ * Squared distances between points and segments, computed in batches. The
+ * point is projected onto the segment as ratio = clamp(dot(P-S, T-S) /
+ * |T-S|^2, 0, 1), with ratio 0 for segments of length zero. Coordinates are
+ * read as separate arrays of lat and lon values, so that AVX handles four and
+ * SSE2 two segments per instruction. Other CPUs use the scalar version, which
+ * performs the same steps. Distances are in the squared units of the input,
+ * doubles keep them exact enough to compare equal segments.
+ */
+
+//coordinates of segments in separate arrays, the layout that the batch functions read
+struct _SegmentArrays {
+    std::vector<int> sourceLat;
+    std::vector<int> sourceLon;
+    std::vector<int> targetLat;
+    std::vector<int> targetLon;
+
+    inline void Append(const _Coordinate & source, const _Coordinate & target) {
+        sourceLat.push_back(source.lat);
+        sourceLon.push_back(source.lon);
+        targetLat.push_back(target.lat);
+        targetLon.push_back(target.lon);
+    }
+
+    inline void Clear() {
+        sourceLat.clear();
+        sourceLon.clear();
+        targetLat.clear();
+        targetLon.clear();
+    }
+
+    inline std::size_t size() const {
+        return sourceLat.size();
+    }
+};
+
+inline double ComputeSquaredDistanceToSegment(const double pLat, const double pLon, const double sLat, const double sLon, const double tLat, const double tLon, double & ratio) {
+    const double segmentLat = tLat - sLat;
+    const double segmentLon = tLon - sLon;
+    const double deltaLat = pLat - sLat;
+    const double deltaLon = pLon - sLon;
+    const double squaredLength = segmentLat*segmentLat + segmentLon*segmentLon;
+    const double dotProduct = deltaLat*segmentLat + deltaLon*segmentLon;
+    ratio = (squaredLength > 0. ? dotProduct/squaredLength : 0.);
+    ratio = std::min(std::max(ratio, 0.), 1.);
+    const double offsetLat = deltaLat - ratio*segmentLat;
+    const double offsetLon = deltaLon - ratio*segmentLon;
+    return offsetLat*offsetLat + offsetLon*offsetLon;
+}
+
+//point on the segment at the given ratio, truncated to the grid of the coordinates
+inline _Coordinate GetPointOnSegment(const _Coordinate & source, const _Coordinate & target, const double ratio) {
+    if(ratio <= 0.) {
+        return source;
+    }
+    if(ratio >= 1.) {
+        return target;
+    }
+    return _Coordinate(source.lat + ratio*((double) target.lat - source.lat), source.lon + ratio*((double) target.lon - source.lon));
+}
+
+#if defined(__AVX__)
+static inline __m256d ComputeSquaredDistancesToSegments4(const __m256d pLat, const __m256d pLon, const __m256d sLat, const __m256d sLon, const __m256d tLat, const __m256d tLon, __m256d & ratio) {
+    const __m256d segmentLat = _mm256_sub_pd(tLat, sLat);
+    const __m256d segmentLon = _mm256_sub_pd(tLon, sLon);
+    const __m256d deltaLat = _mm256_sub_pd(pLat, sLat);
+    const __m256d deltaLon = _mm256_sub_pd(pLon, sLon);
+    const __m256d squaredLength = _mm256_add_pd(_mm256_mul_pd(segmentLat, segmentLat), _mm256_mul_pd(segmentLon, segmentLon));
+    const __m256d dotProduct = _mm256_add_pd(_mm256_mul_pd(deltaLat, segmentLat), _mm256_mul_pd(deltaLon, segmentLon));
+    //lanes of segments without length get ratio 0 instead of NaN
+    const __m256d hasLength = _mm256_cmp_pd(squaredLength, _mm256_setzero_pd(), _CMP_GT_OQ);
+    ratio = _mm256_and_pd(hasLength, _mm256_div_pd(dotProduct, squaredLength));
+    ratio = _mm256_min_pd(_mm256_max_pd(ratio, _mm256_setzero_pd()), _mm256_set1_pd(1.));
+    const __m256d offsetLat = _mm256_sub_pd(deltaLat, _mm256_mul_pd(ratio, segmentLat));
+    const __m256d offsetLon = _mm256_sub_pd(deltaLon, _mm256_mul_pd(ratio, segmentLon));
+    return _mm256_add_pd(_mm256_mul_pd(offsetLat, offsetLat), _mm256_mul_pd(offsetLon, offsetLon));
+}
+
+static inline __m256d LoadCoordinates4(const int * values) {
+    return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(values)));
+}
+#elif defined(__SSE2__)
+static inline __m128d ComputeSquaredDistancesToSegments2(const __m128d pLat, const __m128d pLon, const __m128d sLat, const __m128d sLon, const __m128d tLat, const __m128d tLon, __m128d & ratio) {
+    const __m128d segmentLat = _mm_sub_pd(tLat, sLat);
+    const __m128d segmentLon = _mm_sub_pd(tLon, sLon);
+    const __m128d deltaLat = _mm_sub_pd(pLat, sLat);
+    const __m128d deltaLon = _mm_sub_pd(pLon, sLon);
+    const __m128d squaredLength = _mm_add_pd(_mm_mul_pd(segmentLat, segmentLat), _mm_mul_pd(segmentLon, segmentLon));
+    const __m128d dotProduct = _mm_add_pd(_mm_mul_pd(deltaLat, segmentLat), _mm_mul_pd(deltaLon, segmentLon));
+    //lanes of segments without length get ratio 0 instead of NaN
+    const __m128d hasLength = _mm_cmpgt_pd(squaredLength, _mm_setzero_pd());
+    ratio = _mm_and_pd(hasLength, _mm_div_pd(dotProduct, squaredLength));
+    ratio = _mm_min_pd(_mm_max_pd(ratio, _mm_setzero_pd()), _mm_set1_pd(1.));
+    const __m128d offsetLat = _mm_sub_pd(deltaLat, _mm_mul_pd(ratio, segmentLat));
+    const __m128d offsetLon = _mm_sub_pd(deltaLon, _mm_mul_pd(ratio, segmentLon));
+    return _mm_add_pd(_mm_mul_pd(offsetLat, offsetLat), _mm_mul_pd(offsetLon, offsetLon));
+}
+
+static inline __m128d LoadCoordinates2(const int * values) {
+    return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(values)));
+}
+#endif
+
+//Distances of one point to n segments. Ratios are only stored if an array is given.
+inline void ComputeSquaredDistancesToSegments(const _Coordinate & point, const int * sourceLat, const int * sourceLon, const int * targetLat, const int * targetLon, const std::size_t n, double * distances, double * ratios) {
+    std::size_t i = 0;
+#if defined(__AVX__)
+    const __m256d pLat = _mm256_set1_pd(point.lat);
+    const __m256d pLon = _mm256_set1_pd(point.lon);
+    for(; i+4 <= n; i += 4) {
+        __m256d ratio;
+        _mm256_storeu_pd(distances+i, ComputeSquaredDistancesToSegments4(pLat, pLon, LoadCoordinates4(sourceLat+i), LoadCoordinates4(sourceLon+i), LoadCoordinates4(targetLat+i), LoadCoordinates4(targetLon+i), ratio));
+        if(NULL != ratios) {
+            _mm256_storeu_pd(ratios+i, ratio);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128d pLat = _mm_set1_pd(point.lat);
+    const __m128d pLon = _mm_set1_pd(point.lon);
+    for(; i+2 <= n; i += 2) {
+        __m128d ratio;
+        _mm_storeu_pd(distances+i, ComputeSquaredDistancesToSegments2(pLat, pLon, LoadCoordinates2(sourceLat+i), LoadCoordinates2(sourceLon+i), LoadCoordinates2(targetLat+i), LoadCoordinates2(targetLon+i), ratio));
+        if(NULL != ratios) {
+            _mm_storeu_pd(ratios+i, ratio);
+        }
+    }
+#endif
+    for(; i < n; ++i) {
+        double ratio;
+        distances[i] = ComputeSquaredDistanceToSegment(point.lat, point.lon, sourceLat[i], sourceLon[i], targetLat[i], targetLon[i], ratio);
+        if(NULL != ratios) {
+            ratios[i] = ratio;
+        }
+    }
+}
+
+inline void ComputeSquaredDistancesToSegments(const _Coordinate & point, const _SegmentArrays & segments, double * distances, double * ratios) {
+    if(0 == segments.size()) {
+        return;
+    }
+    ComputeSquaredDistancesToSegments(point, &segments.sourceLat[0], &segments.sourceLon[0], &segments.targetLat[0], &segments.targetLon[0], segments.size(), distances, ratios);
+}
+
+//distances of n points to one segment, e.g. the points that a simplified line skips
+inline void ComputeSquaredDistancesOfPointsToSegment(const int * pointLat, const int * pointLon, const std::size_t n, const _Coordinate & source, const _Coordinate & target, double * distances) {
+    std::size_t i = 0;
+#if defined(__AVX__)
+    const __m256d sLat = _mm256_set1_pd(source.lat);
+    const __m256d sLon = _mm256_set1_pd(source.lon);
+    const __m256d tLat = _mm256_set1_pd(target.lat);
+    const __m256d tLon = _mm256_set1_pd(target.lon);
+    for(; i+4 <= n; i += 4) {
+        __m256d ratio;
+        _mm256_storeu_pd(distances+i, ComputeSquaredDistancesToSegments4(LoadCoordinates4(pointLat+i), LoadCoordinates4(pointLon+i), sLat, sLon, tLat, tLon, ratio));
+    }
+#elif defined(__SSE2__)
+    const __m128d sLat = _mm_set1_pd(source.lat);
+    const __m128d sLon = _mm_set1_pd(source.lon);
+    const __m128d tLat = _mm_set1_pd(target.lat);
+    const __m128d tLon = _mm_set1_pd(target.lon);
+    for(; i+2 <= n; i += 2) {
+        __m128d ratio;
+        _mm_storeu_pd(distances+i, ComputeSquaredDistancesToSegments2(LoadCoordinates2(pointLat+i), LoadCoordinates2(pointLon+i), sLat, sLon, tLat, tLon, ratio));
+    }
+#endif
+    for(; i < n; ++i) {
+        double ratio;
+        distances[i] = ComputeSquaredDistanceToSegment(pointLat[i], pointLon[i], source.lat, source.lon, target.lat, target.lon, ratio);
+    }
+}
+
+#endif /* SEGMENTDISTANCE_H_ */
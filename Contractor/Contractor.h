@@ -225,6 +225,9 @@ public:
         std::vector< std::pair< NodeID, bool > > remainingNodes( numberOfNodes );
         std::vector< float > nodePriority( numberOfNodes );
         std::vector< _PriorityData > nodeData( numberOfNodes );
+        //round in which each node is contracted, nodes of one round form an independent set
+        nodeLevels.resize( numberOfNodes );
+        unsigned currentLevel = 0;
 
         //initialize the variables
 #pragma omp parallel for schedule ( guided )
@@ -403,6 +406,13 @@ public:
                     _UpdateNeighbours( nodePriority, nodeData, data, x );
                 }
             }
+            //note the level of the contracted nodes by their ids before renumbering
+            for ( int position = firstIndependent ; position < last; ++position ) {
+                const NodeID x = remainingNodes[position].first;
+                nodeLevels[flushedContractor ? oldNodeIDFromNewNodeIDMap[x] : x] = currentLevel;
+            }
+            ++currentLevel;
+
             //remove contracted nodes from the pool
             numberOfContractedNodes += last - firstIndependent;
             remainingNodes.resize( firstIndependent );
@@ -435,6 +445,12 @@ public:
         }
     }
 
+    //level of each node in the hierarchy, i.e. the round in which it got contracted
+    void GetNodeLevels( std::vector< unsigned > & levels ) {
+        levels.swap( nodeLevels );
+        std::vector< unsigned >().swap( nodeLevels );
+    }
+
     template< class Edge >
     void GetEdges( DeallocatingVector< Edge >& edges ) {
         Percent p (_graph->GetNumberOfNodes());
@@ -767,6 +783,7 @@ private:
 //    std::string temporaryEdgeStorageFilename;
     unsigned temporaryStorageSlotID;
     std::vector<NodeID> oldNodeIDFromNewNodeIDMap;
+    std::vector<unsigned> nodeLevels;
 
     XORFastHash fastHash;
 };
@@ -110,10 +110,6 @@ void EdgeBasedGraphFactory::GetEdgeBasedNodes( DeallocatingVector< EdgeBasedNode
     nodes.swap(edgeBasedNodes);
 }
 
-void EdgeBasedGraphFactory::GetOriginalEdgeData( std::vector< OriginalEdgeData> & oed) {
-    oed.swap(originalEdgeData);
-}
-
 NodeID EdgeBasedGraphFactory::CheckForEmanatingIsOnlyTurn(const NodeID u, const NodeID v) const {
     std::pair < NodeID, NodeID > restrictionSource = std::make_pair(u, v);
     RestrictionMap::const_iterator restrIter = _restrictionMap.find(restrictionSource);
@@ -165,9 +161,7 @@ void EdgeBasedGraphFactory::Run(const char * originalEdgeDataFilename) {
     Percent p(_nodeBasedGraph->GetNumberOfNodes());
     int numberOfSkippedTurns(0);
     int nodeBasedEdgeCounter(0);
-    unsigned numberOfOriginalEdges(0);
-    std::ofstream originalEdgeDataOutFile(originalEdgeDataFilename, std::ios::binary);
-    originalEdgeDataOutFile.write((char*)&numberOfOriginalEdges, sizeof(unsigned));
+    OriginalEdgeTable::Writer originalEdgeDataWriter(originalEdgeDataFilename);
 
 
     INFO("Identifying small components");
@@ -287,17 +281,9 @@ void EdgeBasedGraphFactory::Run(const char * originalEdgeDataFilename) {
                         //distance += heightPenalty;
                         //distance += ComputeTurnPenalty(u, v, w);
                         assert(edgeData1.edgeBasedNodeID != edgeData2.edgeBasedNodeID);
-                        if(originalEdgeData.size() == originalEdgeData.capacity()-3) {
-                            originalEdgeData.reserve(originalEdgeData.size()*1.2);
-                        }
-                        OriginalEdgeData oed(v,edgeData2.nameID, turnInstruction);
+                        //the id of the new edge is the position of its original edge data
                         EdgeBasedEdge newEdge(edgeData1.edgeBasedNodeID, edgeData2.edgeBasedNodeID, edgeBasedEdges.size(), distance, true, false );
-                        originalEdgeData.push_back(oed);
-                        if(originalEdgeData.size() > 100000) {
-                            originalEdgeDataOutFile.write((char*)&(originalEdgeData[0]), originalEdgeData.size()*sizeof(OriginalEdgeData));
-                            originalEdgeData.clear();
-                        }
-                        ++numberOfOriginalEdges;
+                        originalEdgeDataWriter.Add(_Coordinate(inputNodeInfoList[v].lat, inputNodeInfoList[v].lon), edgeData2.nameID, turnInstruction);
                         ++nodeBasedEdgeCounter;
                         edgeBasedEdges.push_back(newEdge);
                     } else {
@@ -308,11 +294,7 @@ void EdgeBasedGraphFactory::Run(const char * originalEdgeDataFilename) {
         }
         p.printIncrement();
     }
-    numberOfOriginalEdges += originalEdgeData.size();
-    originalEdgeDataOutFile.write((char*)&(originalEdgeData[0]), originalEdgeData.size()*sizeof(OriginalEdgeData));
-    originalEdgeDataOutFile.seekp(std::ios::beg);
-    originalEdgeDataOutFile.write((char*)&numberOfOriginalEdges, sizeof(unsigned));
-    originalEdgeDataOutFile.close();
+    originalEdgeDataWriter.Close();
 
 //    INFO("Sorting edge-based Nodes");
 //    std::sort(edgeBasedNodes.begin(), edgeBasedNodes.end());
@@ -89,6 +89,45 @@ private:
     boost::unordered_map< NodeID, Key > nodes;
 };
 
+/*
+ * Flat array of size maxID that tags each slot with the generation in which it
+ * was last written. Clear() only bumps the generation, stale slots read as
+ * "not inserted" and are reset lazily on their first access.
+ */
+template< typename NodeID, typename Key >
+class TimestampedArrayStorage {
+public:
+
+    TimestampedArrayStorage( size_t size ) : positions( size ), currentTimestamp(1) { }
+
+    Key &operator[]( NodeID node ) {
+        assert( node < positions.size() );
+        TimestampedCell & cell = positions[node];
+        if( cell.timestamp != currentTimestamp ) {
+            cell.timestamp = currentTimestamp;
+            cell.key = std::numeric_limits< Key >::max();
+        }
+        return cell.key;
+    }
+
+    void Clear() {
+        ++currentTimestamp;
+        if( std::numeric_limits< unsigned >::max() == currentTimestamp ) {
+            std::fill( positions.begin(), positions.end(), TimestampedCell() );
+            currentTimestamp = 1;
+        }
+    }
+
+private:
+    struct TimestampedCell {
+        TimestampedCell() : key(0), timestamp(0) { }
+        Key key;
+        unsigned timestamp;
+    };
+    std::vector< TimestampedCell > positions;
+    unsigned currentTimestamp;
+};
+
 template<typename NodeID = unsigned>
 struct _SimpleHeapData {
     NodeID parent;
@@ -105,10 +144,15 @@ public:
     typedef Data DataType;
 
     BinaryHeap( size_t maxID )
-    : nodeIndex( maxID ) {
+    : nodeIndex( maxID ), maxID( maxID ) {
         Clear();
     }
 
+    //node ids must be smaller than this
+    size_t GetMaxID() const {
+        return maxID;
+    }
+
     void Clear() {
         heap.resize( 1 );
         insertedNodes.clear();
@@ -213,6 +257,7 @@ private:
     std::vector< HeapNode > insertedNodes;
     std::vector< HeapElement > heap;
     IndexStorage nodeIndex;
+    size_t maxID;
 
     void Downheap( Key key ) {
         const Key droppingIndex = heap[key].index;
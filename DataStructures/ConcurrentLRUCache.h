@@ -0,0 +1,148 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CONCURRENTLRUCACHE_H_
+#define CONCURRENTLRUCACHE_H_
+
+#include <cstddef>
+#include <list>
+
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+/*
+ * LRU cache that is shared by several threads. Keys are spread over a fixed
+ * number of shards, each with its own lock, its own LRU order and an equal
+ * part of the budget, which is rounded up so that small budgets still cache. Every entry is charged with a cost, e.g. its size in
+ * bytes, and the least recently used entries of a shard are evicted once the
+ * shard exceeds its part of the budget.
+ */
+template<typename KeyT, typename ValueT, unsigned NumberOfShards = 16>
+class ConcurrentLRUCache : private boost::noncopyable {
+private:
+    struct CacheEntry {
+        CacheEntry(const KeyT & k, const ValueT & v, const std::size_t c) : key(k), value(v), cost(c) {}
+        KeyT key;
+        ValueT value;
+        std::size_t cost;
+    };
+    typedef std::list<CacheEntry> EntryList;
+    typedef boost::unordered_map<KeyT, typename EntryList::iterator, boost::hash<KeyT> > PositionMap;
+
+    struct Shard {
+        Shard() : cost(0), hits(0), misses(0) {}
+        boost::mutex mutex;
+        EntryList itemsInCache;
+        PositionMap positionMap;
+        std::size_t cost;
+        unsigned long long hits;
+        unsigned long long misses;
+    };
+
+    std::size_t budgetPerShard;
+    Shard shards[NumberOfShards];
+
+    inline Shard & GetShard(const KeyT & key) {
+        return shards[boost::hash<KeyT>()(key) % NumberOfShards];
+    }
+
+    inline void EraseEntry(Shard & shard, const typename EntryList::iterator it) {
+        shard.cost -= it->cost;
+        shard.positionMap.erase(it->key);
+        shard.itemsInCache.erase(it);
+    }
+
+public:
+    ConcurrentLRUCache(const std::size_t budget) : budgetPerShard((budget + NumberOfShards - 1)/NumberOfShards) {}
+
+    bool Fetch(const KeyT & key, ValueT & result) {
+        Shard & shard = GetShard(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename PositionMap::iterator position = shard.positionMap.find(key);
+        if(shard.positionMap.end() == position) {
+            ++shard.misses;
+            return false;
+        }
+        ++shard.hits;
+        //move to front
+        shard.itemsInCache.splice(shard.itemsInCache.begin(), shard.itemsInCache, position->second);
+        result = position->second->value;
+        return true;
+    }
+
+    //entries that cost more than the budget of a shard are not cached at all
+    void Insert(const KeyT & key, const ValueT & value, const std::size_t cost = 1) {
+        if(cost > budgetPerShard) {
+            return;
+        }
+        Shard & shard = GetShard(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename PositionMap::iterator position = shard.positionMap.find(key);
+        if(shard.positionMap.end() != position) {
+            EraseEntry(shard, position->second);
+        }
+        shard.itemsInCache.push_front(CacheEntry(key, value, cost));
+        shard.positionMap.insert(std::make_pair(key, shard.itemsInCache.begin()));
+        shard.cost += cost;
+        while(shard.cost > budgetPerShard) {
+            EraseEntry(shard, --shard.itemsInCache.end());
+        }
+    }
+
+    void Clear() {
+        for(unsigned i = 0; i < NumberOfShards; ++i) {
+            boost::mutex::scoped_lock lock(shards[i].mutex);
+            shards[i].itemsInCache.clear();
+            shards[i].positionMap.clear();
+            shards[i].cost = 0;
+        }
+    }
+
+    unsigned long long GetNumberOfHits() {
+        unsigned long long hits = 0;
+        for(unsigned i = 0; i < NumberOfShards; ++i) {
+            boost::mutex::scoped_lock lock(shards[i].mutex);
+            hits += shards[i].hits;
+        }
+        return hits;
+    }
+
+    unsigned long long GetNumberOfMisses() {
+        unsigned long long misses = 0;
+        for(unsigned i = 0; i < NumberOfShards; ++i) {
+            boost::mutex::scoped_lock lock(shards[i].mutex);
+            misses += shards[i].misses;
+        }
+        return misses;
+    }
+
+    std::size_t GetCost() {
+        std::size_t cost = 0;
+        for(unsigned i = 0; i < NumberOfShards; ++i) {
+            boost::mutex::scoped_lock lock(shards[i].mutex);
+            cost += shards[i].cost;
+        }
+        return cost;
+    }
+};
+
+#endif /* CONCURRENTLRUCACHE_H_ */
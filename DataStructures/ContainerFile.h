@@ -0,0 +1,332 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CONTAINERFILE_H_
+#define CONTAINERFILE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../Algorithms/CRC32.h"
+#include "../typedefs.h"
+
+/*
+ * Container format of the data files that osrm-routed loads. A file starts
+ * with a header that names the format version and the type of the file,
+ * followed by a table of its sections. Each section starts at a page boundary
+ * and carries the CRC32C of its contents, so that it can be mapped and used in
+ * place, and so that damaged files or files of the wrong kind are rejected
+ * while loading instead of corrupting queries.
+ */
+class ContainerFormat {
+public:
+    enum FileType {
+        GRAPH_FILE = 1,     //.hsgr
+        NODES_FILE,         //.nodes
+        EDGES_FILE,         //.edges
+        NAMES_FILE,         //.names
+        RAM_INDEX_FILE,     //.ramIndex
+        FILE_INDEX_FILE,    //.fileIndex
+        RTREE_FILE          //.rtree
+    };
+
+    //sections of the files other than .hsgr and .names, whose classes number their own
+    enum SectionID {
+        COORDINATES_SECTION = 0,    //.nodes, _Coordinate of each node
+        NODE_IDS_SECTION,           //.nodes, OSM id of each node
+        ORIGINAL_EDGES_SECTION,     //.edges of earlier versions, OriginalEdgeData of each edge
+        RAM_INDEX_SECTION,          //.ramIndex, first level of the grid
+        FILE_INDEX_SECTION,         //.fileIndex, cells of the second level
+        EDGE_LINES_SECTION,         //.edges, see OriginalEdgeTable
+        EDGE_EXCEPTIONS_SECTION,    //.edges, see OriginalEdgeTable
+        EDGE_COUNT_SECTION,         //.edges, number of original edges
+        RTREE_PROPERTIES_SECTION,   //.rtree, see StaticRTree
+        RTREE_NODES_SECTION,        //.rtree, nodes from the root to the leaves
+        RTREE_EDGES_SECTION,        //.rtree, _GridEdge of each edge-based node in Hilbert order
+        RTREE_SEGMENTS_SECTION      //.rtree, coordinates of the edges as arrays of source lat, source lon, target lat and target lon
+    };
+
+    struct _StrHeader {
+        unsigned magic;
+        unsigned version;
+        unsigned fileType;
+        unsigned numberOfSections;
+    };
+
+    struct _StrSection {
+        unsigned id;
+        unsigned checkSum;
+        unsigned long long offset;
+        unsigned long long size;
+    };
+
+    //"OSRC"
+    static const unsigned MAGIC = 0x4352534f;
+    static const unsigned VERSION = 2;
+    static const unsigned SECTION_ALIGNMENT = 4096;
+
+    static inline unsigned long long Align( const unsigned long long offset ) {
+        return (offset + SECTION_ALIGNMENT - 1)/SECTION_ALIGNMENT*SECTION_ALIGNMENT;
+    }
+
+    static inline unsigned long long GetSizeOfTable( const unsigned numberOfSections ) {
+        return sizeof(_StrHeader) + (unsigned long long) numberOfSections*sizeof(_StrSection);
+    }
+
+    //CRC32 takes the length as unsigned, so the data is passed on in chunks of 1 GB
+    static void UpdateCheckSum( CRC32 & crc32, const char * data, unsigned long long size, unsigned & checkSum ) {
+        while(0 < size) {
+            const unsigned sizeOfChunk = std::min<unsigned long long>(size, 1 << 30);
+            checkSum = crc32(const_cast<char *>(data), sizeOfChunk);
+            data += sizeOfChunk;
+            size -= sizeOfChunk;
+        }
+    }
+};
+
+//writes a container section by section, the header and the table are written on Close().
+//The file is written next to its final name and renamed over it on Close(), so that
+//processes that have mapped the previous file keep reading intact pages.
+class ContainerFileWriter : private boost::noncopyable {
+public:
+    ContainerFileWriter( const char * fileName, const ContainerFormat::FileType fileType, const unsigned numberOfSections ) :
+        _fileName(fileName), _temporaryFileName(_fileName + ".tmp"), _out(_temporaryFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc), _position(0), _crc32(NULL), _closed(false)
+    {
+        _header.magic = ContainerFormat::MAGIC;
+        _header.version = ContainerFormat::VERSION;
+        _header.fileType = fileType;
+        _header.numberOfSections = numberOfSections;
+        Pad(ContainerFormat::GetSizeOfTable(numberOfSections));
+    }
+
+    //a writer that is not closed, e.g. because an exception was thrown, leaves the previous file in place
+    ~ContainerFileWriter() {
+        delete _crc32;
+        if(!_closed) {
+            _out.close();
+            std::remove(_temporaryFileName.c_str());
+        }
+    }
+
+    void BeginSection( const unsigned id ) {
+        if(NULL != _crc32 || _sections.size() == _header.numberOfSections) {
+            std::remove(_temporaryFileName.c_str());
+            ERR("cannot begin section " << id << " of " << _fileName);
+        }
+        Pad(ContainerFormat::Align(_position));
+        ContainerFormat::_StrSection section;
+        section.id = id;
+        section.checkSum = 0;
+        section.offset = _position;
+        section.size = 0;
+        _sections.push_back(section);
+        _crc32 = new CRC32();
+    }
+
+    void Write( const char * data, const unsigned long long size ) {
+        assert(NULL != _crc32);
+        ContainerFormat::UpdateCheckSum(*_crc32, data, size, _sections.back().checkSum);
+        _out.write(data, size);
+        _position += size;
+        _sections.back().size += size;
+    }
+
+    void EndSection() {
+        delete _crc32;
+        _crc32 = NULL;
+    }
+
+    void WriteSection( const unsigned id, const char * data, const unsigned long long size ) {
+        BeginSection(id);
+        Write(data, size);
+        EndSection();
+    }
+
+    void Close() {
+        if(NULL != _crc32 || _sections.size() != _header.numberOfSections) {
+            std::remove(_temporaryFileName.c_str());
+            ERR("sections of " << _fileName << " are incomplete");
+        }
+        Pad(ContainerFormat::Align(_position));
+        _out.seekp(0);
+        _out.write((char *) &_header, sizeof(ContainerFormat::_StrHeader));
+        if(!_sections.empty()) {
+            _out.write((char *) &_sections[0], _sections.size()*sizeof(ContainerFormat::_StrSection));
+        }
+        _out.close();
+        if(_out.fail() || !SyncToDisk(_temporaryFileName.c_str()) || 0 != std::rename(_temporaryFileName.c_str(), _fileName.c_str())) {
+            std::remove(_temporaryFileName.c_str());
+            ERR("could not write " << _fileName);
+        }
+        _closed = true;
+    }
+
+private:
+    //the contents have to be on disk before the rename makes them visible under the final name
+    static bool SyncToDisk( const char * fileName ) {
+        const int fd = open(fileName, O_RDONLY);
+        if(-1 == fd) {
+            return false;
+        }
+        const bool synced = (0 == fsync(fd));
+        return (0 == close(fd)) && synced;
+    }
+
+    void Pad( const unsigned long long offset ) {
+        for(; _position < offset; ++_position) {
+            _out.put(0);
+        }
+    }
+
+    std::string _fileName;
+    std::string _temporaryFileName;
+    std::ofstream _out;
+    unsigned long long _position;
+    ContainerFormat::_StrHeader _header;
+    std::vector<ContainerFormat::_StrSection> _sections;
+    CRC32 * _crc32;
+    bool _closed;
+};
+
+//a container that is mapped from a file or that is already in memory, errors are thrown as std::runtime_error
+class ContainerFile : private boost::noncopyable {
+public:
+    ContainerFile( const char * fileName, const ContainerFormat::FileType fileType ) : _name(fileName) {
+        boost::interprocess::file_mapping mapping(fileName, boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+        _region.swap(region);
+        Parse(static_cast<const char *>(_region.get_address()), _region.get_size(), fileType);
+    }
+
+    //uses memory that outlives the container, e.g. shared memory
+    ContainerFile( const char * memory, const std::size_t size, const ContainerFormat::FileType fileType, const std::string & name ) : _name(name) {
+        Parse(memory, size, fileType);
+    }
+
+    //true if the file starts like a container, files in older formats do not
+    static bool IsContainerFile( const char * fileName ) {
+        std::ifstream in(fileName, std::ios::binary);
+        ContainerFormat::_StrHeader header = ContainerFormat::_StrHeader();
+        in.read((char *) &header, sizeof(ContainerFormat::_StrHeader));
+        return in.good() && ContainerFormat::MAGIC == header.magic;
+    }
+
+    inline bool HasSection( const unsigned id ) const {
+        return NULL != FindSection(id);
+    }
+
+    inline const char * GetSection( const unsigned id ) const {
+        return _base + GetSectionEntry(id).offset;
+    }
+
+    inline unsigned long long GetSectionSize( const unsigned id ) const {
+        return GetSectionEntry(id).size;
+    }
+
+    //offset of the section from the start of the file
+    inline unsigned long long GetSectionOffset( const unsigned id ) const {
+        return GetSectionEntry(id).offset;
+    }
+
+    void VerifySection( const unsigned id ) const {
+        const ContainerFormat::_StrSection & section = GetSectionEntry(id);
+        CRC32 crc32;
+        unsigned checkSum = 0;
+        ContainerFormat::UpdateCheckSum(crc32, _base + section.offset, section.size, checkSum);
+        if(checkSum != section.checkSum) {
+            throw std::runtime_error("checksum of section " + boost::lexical_cast<std::string>(id) + " of " + _name + " does not match, the file is damaged");
+        }
+    }
+
+    void VerifyAllSections() const {
+        for(unsigned i = 0; i < _sections.size(); ++i) {
+            VerifySection(_sections[i].id);
+        }
+    }
+
+private:
+    void Parse( const char * base, const std::size_t size, const ContainerFormat::FileType fileType ) {
+        _base = base;
+        ContainerFormat::_StrHeader header;
+        if(size < sizeof(ContainerFormat::_StrHeader)) {
+            throw std::runtime_error(_name + " is too small for a data file");
+        }
+        memcpy(&header, base, sizeof(ContainerFormat::_StrHeader));
+        if(ContainerFormat::MAGIC != header.magic) {
+            throw std::runtime_error(_name + " is not a data file of this kind, rerun osrm-prepare");
+        }
+        if(ContainerFormat::VERSION != header.version) {
+            throw std::runtime_error(_name + " has format version " + boost::lexical_cast<std::string>(header.version) + ", expected " + boost::lexical_cast<std::string>((unsigned) ContainerFormat::VERSION));
+        }
+        if((unsigned) fileType != header.fileType) {
+            throw std::runtime_error(_name + " holds data of another kind, check the file names");
+        }
+        if(size < ContainerFormat::GetSizeOfTable(header.numberOfSections)) {
+            throw std::runtime_error(_name + " is truncated");
+        }
+        _sections.resize(header.numberOfSections);
+        if(!_sections.empty()) {
+            memcpy(&_sections[0], base + sizeof(ContainerFormat::_StrHeader), _sections.size()*sizeof(ContainerFormat::_StrSection));
+        }
+        for(unsigned i = 0; i < _sections.size(); ++i) {
+            if(_sections[i].offset > size || _sections[i].size > size - _sections[i].offset) {
+                throw std::runtime_error(_name + " is truncated");
+            }
+        }
+    }
+
+    inline const ContainerFormat::_StrSection * FindSection( const unsigned id ) const {
+        for(unsigned i = 0; i < _sections.size(); ++i) {
+            if(id == _sections[i].id) {
+                return &_sections[i];
+            }
+        }
+        return NULL;
+    }
+
+    inline const ContainerFormat::_StrSection & GetSectionEntry( const unsigned id ) const {
+        const ContainerFormat::_StrSection * section = FindSection(id);
+        if(NULL == section) {
+            throw std::runtime_error(_name + " has no section " + boost::lexical_cast<std::string>(id));
+        }
+        return *section;
+    }
+
+    std::string _name;
+    const char * _base;
+    std::vector<ContainerFormat::_StrSection> _sections;
+    boost::interprocess::mapped_region _region;
+};
+
+#endif /* CONTAINERFILE_H_ */
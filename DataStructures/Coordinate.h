@@ -21,7 +21,9 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef COORDINATE_H_
 #define COORDINATE_H_
 
+#include <cassert>
 #include <climits>
+#include <cmath>
 #include <iostream>
 
 struct _Coordinate {
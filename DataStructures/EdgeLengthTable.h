@@ -0,0 +1,108 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef EDGELENGTHTABLE_H_
+#define EDGELENGTHTABLE_H_
+
+#include <cassert>
+#include <climits>
+#include <vector>
+
+#include "../typedefs.h"
+#include "PhantomNodes.h"
+#include "ShortcutUnpackingIndex.h"
+
+/*
+ * Side array with the length in meters of every edge of the query graph, so
+ * that the length of a route is known without unpacking it. Lengths follow
+ * the edge weights: an edge u->v is as long as the edge-based node u that it
+ * leaves, a shortcut is as long as its two halves. Edges are referenced as in
+ * ShortcutUnpackingIndex.
+ */
+class EdgeLengthTable {
+public:
+    template<class GraphT>
+    static void Build( const GraphT & graph, const std::vector<ShortcutUnpackingIndex::_StrEdgeHalves> & halves, const std::vector<unsigned> & nodeLengths, std::vector<unsigned> & edgeLengths ) {
+        std::vector<NodeID> sourceOfEdge(graph.GetNumberOfEdges());
+        for(NodeID u = 0; u < graph.GetNumberOfNodes(); ++u) {
+            for(typename GraphT::EdgeIterator eit = graph.BeginEdges(u); eit < graph.EndEdges(u); ++eit) {
+                sourceOfEdge[eit] = u;
+            }
+        }
+        edgeLengths.clear();
+        edgeLengths.resize(2*graph.GetNumberOfEdges(), UINT_MAX);
+        for(EdgeID edgeReference = 0; edgeReference < edgeLengths.size(); ++edgeReference) {
+            ComputeLengthOfEdge(graph, halves, nodeLengths, sourceOfEdge, edgeReference, edgeLengths);
+        }
+    }
+
+    EdgeLengthTable( std::vector<unsigned> & nodeLengths, std::vector<unsigned> & edgeLengths ) {
+        _nodeLengths.swap(nodeLengths);
+        _edgeLengths.swap(edgeLengths);
+    }
+
+    inline unsigned GetNumberOfNodes() const {
+        return _nodeLengths.size();
+    }
+
+    inline unsigned GetNumberOfEdges() const {
+        return _edgeLengths.size()/2;
+    }
+
+    inline unsigned GetLengthOfEdge( const EdgeID edgeReference ) const {
+        assert( edgeReference < _edgeLengths.size() );
+        return _edgeLengths[edgeReference];
+    }
+
+    //length of the part of the phantom's segment that lies before the phantom when entering it through node
+    inline int GetLengthBeforePhantom( const PhantomNode & phantom, const NodeID node ) const {
+        const int nodeLength = (phantom.edgeBasedNode < _nodeLengths.size() ? _nodeLengths[phantom.edgeBasedNode] : 0);
+        const int lengthBefore = nodeLength*phantom.ratio;
+        return (node == phantom.edgeBasedNode ? lengthBefore : nodeLength - lengthBefore);
+    }
+
+private:
+    template<class GraphT>
+    static unsigned ComputeLengthOfEdge( const GraphT & graph, const std::vector<ShortcutUnpackingIndex::_StrEdgeHalves> & halves, const std::vector<unsigned> & nodeLengths, const std::vector<NodeID> & sourceOfEdge, const EdgeID edgeReference, std::vector<unsigned> & edgeLengths ) {
+        if(SPECIAL_EDGEID == edgeReference) {
+            return 0;
+        }
+        if(UINT_MAX != edgeLengths[edgeReference]) {
+            return edgeLengths[edgeReference];
+        }
+        const EdgeID edge = ShortcutUnpackingIndex::GetEdgeID(edgeReference);
+        unsigned length = 0;
+        if(graph.GetEdgeData(edge).shortcut) {
+            length  = ComputeLengthOfEdge(graph, halves, nodeLengths, sourceOfEdge, halves[edgeReference].first, edgeLengths);
+            length += ComputeLengthOfEdge(graph, halves, nodeLengths, sourceOfEdge, halves[edgeReference].second, edgeLengths);
+        } else {
+            //a reversed edge leaves its target
+            const NodeID from = (edgeReference & 1) ? graph.GetTarget(edge) : sourceOfEdge[edge];
+            length = (from < nodeLengths.size() ? nodeLengths[from] : 0);
+        }
+        edgeLengths[edgeReference] = length;
+        return length;
+    }
+
+    std::vector<unsigned> _nodeLengths;
+    std::vector<unsigned> _edgeLengths;
+};
+
+#endif /* EDGELENGTHTABLE_H_ */
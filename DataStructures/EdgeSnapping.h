@@ -0,0 +1,173 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef EDGESNAPPING_H_
+#define EDGESNAPPING_H_
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include <boost/foreach.hpp>
+
+#include "../Algorithms/SegmentDistance.h"
+#include "Coordinate.h"
+#include "GridEdge.h"
+#include "PhantomNodes.h"
+#include "Util.h"
+
+/*
+ * Snapping of a coordinate to the nearest of a set of candidate edges, shared
+ * by the nearest neighbour indexes. Edges and the input point are given in
+ * Mercator projected coordinates, i.e. with lat2y() applied to the latitude.
+ */
+
+//distances that differ by less than this are the same, e.g. for both directions of a street
+inline bool SnappingEpsilonCompare(const double d1, const double d2) {
+    return (std::fabs(d1 - d2) < 0.0001);
+}
+
+inline _Coordinate ProjectCoordinate(const _Coordinate & location) {
+    return _Coordinate(100000*(lat2y(static_cast<double>(location.lat)/100000.)), location.lon);
+}
+
+//distances of the projected point to all candidates in one batch
+inline void ComputeDistancesToCandidates(const _Coordinate & startCoord, const std::vector<_GridEdge> & candidates, std::vector<double> & distances, std::vector<double> & ratios) {
+    distances.resize(candidates.size());
+    ratios.resize(candidates.size());
+    if(candidates.empty()) {
+        return;
+    }
+    _SegmentArrays segments;
+    BOOST_FOREACH(const _GridEdge & candidate, candidates) {
+        segments.Append(candidate.startCoord, candidate.targetCoord);
+    }
+    ComputeSquaredDistancesToSegments(startCoord, segments, &distances[0], &ratios[0]);
+}
+
+//Picks the nearest candidate that is not used yet, the opposite direction of the same street gives the second
+//weight. Candidates at the same distance are taken in the given order. Both edges are marked as used.
+inline bool SelectNearestUnusedCandidate(const _Coordinate & location, const std::vector<_GridEdge> & candidates, const std::vector<double> & distances, const std::vector<double> & ratios, const bool ignoreTinyComponents, std::vector<bool> & used, PhantomNode & resultNode) {
+    bool foundNode = false;
+    unsigned smallestEdge = 0;
+    unsigned oppositeEdge = UINT_MAX;
+    double dist = std::numeric_limits<double>::max();
+
+    for(unsigned i = 0; i < candidates.size(); ++i) {
+        const _GridEdge & candidate = candidates[i];
+        if(used[i] || (candidate.belongsToTinyComponent && ignoreTinyComponents))
+            continue;
+        if(distances[i] < dist && !SnappingEpsilonCompare(dist, distances[i])) {
+            dist = distances[i];
+            resultNode.edgeBasedNode = candidate.edgeBasedNode;
+            resultNode.nodeBasedEdgeNameID = candidate.nameID;
+            resultNode.weight1 = candidate.weight;
+            resultNode.weight2 = INT_MAX;
+            resultNode.location = GetPointOnSegment(candidate.startCoord, candidate.targetCoord, ratios[i]);
+            foundNode = true;
+            smallestEdge = i;
+            oppositeEdge = UINT_MAX;
+        } else if(SnappingEpsilonCompare(dist, distances[i]) && 1 == std::abs((int)candidate.edgeBasedNode-(int)resultNode.edgeBasedNode)) {
+            resultNode.weight2 = candidate.weight;
+            oppositeEdge = i;
+        }
+    }
+    if(foundNode) {
+        used[smallestEdge] = true;
+        if(UINT_MAX != oppositeEdge) {
+            used[oppositeEdge] = true;
+        }
+    }
+
+    double ratio = (foundNode ? std::min(1., ApproximateDistance(candidates[smallestEdge].startCoord, resultNode.location)/ApproximateDistance(candidates[smallestEdge].startCoord, candidates[smallestEdge].targetCoord)) : 0);
+    resultNode.location.lat = round(100000.*(y2lat(static_cast<double>(resultNode.location.lat)/100000.)));
+    //Hack to fix rounding errors and wandering via nodes.
+    if(std::abs(location.lon - resultNode.location.lon) == 1)
+        resultNode.location.lon = location.lon;
+    if(std::abs(location.lat - resultNode.location.lat) == 1)
+        resultNode.location.lat = location.lat;
+
+    resultNode.weight1 *= ratio;
+    if(INT_MAX != resultNode.weight2) {
+        resultNode.weight2 -= resultNode.weight1;
+    }
+    resultNode.ratio = ratio;
+    return foundNode;
+}
+
+inline bool SelectPhantomNode(const _Coordinate & location, const std::vector<_GridEdge> & candidates, const bool ignoreTinyComponents, PhantomNode & resultNode) {
+    std::vector<double> distances;
+    std::vector<double> ratios;
+    ComputeDistancesToCandidates(ProjectCoordinate(location), candidates, distances, ratios);
+    std::vector<bool> used(candidates.size(), false);
+    return SelectNearestUnusedCandidate(location, candidates, distances, ratios, ignoreTinyComponents, used, resultNode);
+}
+
+//Ranks the candidates as phantom nodes, one per street, up to the given number and distance in meters.
+//The first one is the phantom node that SelectPhantomNode() picks.
+inline void SelectPhantomNodes(const _Coordinate & location, const std::vector<_GridEdge> & candidates, const bool ignoreTinyComponents, const unsigned maxNumberOfResults, const double maxDistance, std::vector<PhantomNodeCandidate> & result) {
+    result.clear();
+    std::vector<double> distances;
+    std::vector<double> ratios;
+    ComputeDistancesToCandidates(ProjectCoordinate(location), candidates, distances, ratios);
+    std::vector<bool> used(candidates.size(), false);
+    PhantomNode phantomNode;
+    while(result.size() < maxNumberOfResults && SelectNearestUnusedCandidate(location, candidates, distances, ratios, ignoreTinyComponents, used, phantomNode)) {
+        const double distance = ApproximateDistance(location, phantomNode.location);
+        //candidates come nearest first, so all that follow are even farther away
+        if(distance > maxDistance) {
+            break;
+        }
+        result.push_back(PhantomNodeCandidate(phantomNode, distance));
+        phantomNode.Reset();
+    }
+}
+
+//Squared distance in projected coordinates that covers at least the given number of meters around a location.
+//Mercator stretches both axes by the same factor, the margin covers the error of ApproximateDistance().
+inline double GetSquaredProjectedRadius(const _Coordinate & location, const double meters) {
+    if(meters >= std::numeric_limits<double>::max()) {
+        return std::numeric_limits<double>::max();
+    }
+    const double unitsPerMeter = 100000./(111319.49*std::max(std::cos(location.lat/100000.*M_PI/180.), 0.01));
+    const double radius = 1.1*meters*unitsPerMeter;
+    return radius*radius;
+}
+
+//nearest point on any of the candidates, the output is left as is if there are none
+inline void SelectNearestPoint(const _Coordinate & inputCoordinate, const std::vector<_GridEdge> & candidates, _Coordinate & outputCoordinate) {
+    const _Coordinate startCoord = ProjectCoordinate(inputCoordinate);
+    std::vector<double> distances;
+    std::vector<double> ratios;
+    ComputeDistancesToCandidates(startCoord, candidates, distances, ratios);
+    double dist = (std::numeric_limits<double>::max)();
+    for(unsigned i = 0; i < candidates.size(); ++i) {
+        if(distances[i] < dist) {
+            dist = distances[i];
+            const _Coordinate nearest = GetPointOnSegment(candidates[i].startCoord, candidates[i].targetCoord, ratios[i]);
+            outputCoordinate.lat = round(100000*(y2lat(static_cast<double>(nearest.lat)/100000.)));
+            outputCoordinate.lon = nearest.lon;
+        }
+    }
+}
+
+#endif /* EDGESNAPPING_H_ */
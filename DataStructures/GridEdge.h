@@ -21,11 +21,23 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef GRIDEDGE_H_
 #define GRIDEDGE_H_
 
+#include <climits>
+#include <cstring>
+
 #include "Coordinate.h"
 
 struct _GridEdge {
     _GridEdge(NodeID n, NodeID na, int w, _Coordinate sc, _Coordinate tc, bool bttc) : edgeBasedNode(n), nameID(na), weight(w), startCoord(sc), targetCoord(tc), belongsToTinyComponent(bttc) {}
-    _GridEdge() : edgeBasedNode(UINT_MAX), nameID(UINT_MAX), weight(INT_MAX), belongsToTinyComponent(false) {}
+    //the padding is zeroed as well, so that files of edges do not depend on uninitialized memory
+    _GridEdge() {
+        memset(static_cast<void *>(this), 0, sizeof(_GridEdge));
+        edgeBasedNode = UINT_MAX;
+        nameID = UINT_MAX;
+        weight = INT_MAX;
+        startCoord = _Coordinate();
+        targetCoord = _Coordinate();
+        belongsToTinyComponent = false;
+    }
     NodeID edgeBasedNode;
     NodeID nameID;
     int weight;
@@ -55,9 +67,16 @@ struct GridEntry {
     }
 };
 
+//orders the entries of a cell by file bucket and the entries of a bucket by edge
 struct CompareGridEdgeDataByFileIndex {
     bool operator ()  (const GridEntry & a, const GridEntry & b) const {
-        return a.fileIndex < b.fileIndex;
+        return a.fileIndex < b.fileIndex || (a.fileIndex == b.fileIndex && a.edge.edgeBasedNode < b.edge.edgeBasedNode);
+    }
+};
+
+struct EqualGridEdgeDataInFileBucket {
+    bool operator ()  (const GridEntry & a, const GridEntry & b) const {
+        return a.fileIndex == b.fileIndex && a.edge.edgeBasedNode == b.edge.edgeBasedNode;
     }
 };
 
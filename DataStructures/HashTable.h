@@ -48,7 +48,7 @@ public:
         return table.find(key)->second;
     }
 
-    bool Holds(const keyT& key) {
+    bool Holds(const keyT& key) const {
         if(table.find(key) == table.end())
             return false;
         return true;
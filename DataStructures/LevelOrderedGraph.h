@@ -0,0 +1,118 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef LEVELORDEREDGRAPH_H_
+#define LEVELORDEREDGRAPH_H_
+
+#include <cassert>
+#include <climits>
+#include <vector>
+
+#include "Coordinate.h"
+#include "../typedefs.h"
+
+/*
+ * Downward edges of the contraction hierarchy with the nodes renumbered by
+ * descending level. Each node stores its incoming downward edges, whose
+ * sources all have a smaller position, so that a single linear sweep over
+ * the nodes settles all of them.
+ */
+class LevelOrderedGraph {
+public:
+    typedef NodeID NodeIterator;
+    typedef NodeID EdgeIterator;
+
+    struct _StrNode {
+        //index of the first incoming edge
+        EdgeIterator firstEdge;
+    };
+
+    struct _StrEdge {
+        //position of the higher ranked node this edge comes from
+        NodeIterator source;
+        int distance;
+    };
+
+    LevelOrderedGraph(std::vector<NodeID> & originalNodeIDs, std::vector<_Coordinate> & coordinates, std::vector<_StrNode> & nodes, std::vector<_StrEdge> & edges) {
+        assert(originalNodeIDs.size() + 1 == nodes.size());
+        _numNodes = originalNodeIDs.size();
+        _originalNodeIDs.swap(originalNodeIDs);
+        _coordinates.swap(coordinates);
+        _nodes.swap(nodes);
+        _edges.swap(edges);
+
+        NodeID maxNodeID = 0;
+        for(NodeIterator position = 0; position < _numNodes; ++position) {
+            if(_originalNodeIDs[position] > maxNodeID)
+                maxNodeID = _originalNodeIDs[position];
+        }
+        _positions.resize(maxNodeID+1, UINT_MAX);
+        for(NodeIterator position = 0; position < _numNodes; ++position) {
+            _positions[_originalNodeIDs[position]] = position;
+        }
+    }
+
+    inline unsigned GetNumberOfNodes() const {
+        return _numNodes;
+    }
+
+    inline unsigned GetNumberOfEdges() const {
+        return _edges.size();
+    }
+
+    inline EdgeIterator BeginEdges( const NodeIterator position ) const {
+        return _nodes[position].firstEdge;
+    }
+
+    inline EdgeIterator EndEdges( const NodeIterator position ) const {
+        return _nodes[position+1].firstEdge;
+    }
+
+    inline NodeIterator GetSource( const EdgeIterator e ) const {
+        return _edges[e].source;
+    }
+
+    inline int GetDistance( const EdgeIterator e ) const {
+        return _edges[e].distance;
+    }
+
+    //position in the sweep order of a node of the query graph
+    inline NodeIterator GetPosition( const NodeID node ) const {
+        return (node < _positions.size() ? _positions[node] : UINT_MAX);
+    }
+
+    inline NodeID GetOriginalNodeID( const NodeIterator position ) const {
+        return _originalNodeIDs[position];
+    }
+
+    inline const _Coordinate & GetCoordinate( const NodeIterator position ) const {
+        return _coordinates[position];
+    }
+
+private:
+    NodeIterator _numNodes;
+    std::vector<NodeID> _originalNodeIDs;
+    std::vector<NodeIterator> _positions;
+    std::vector<_Coordinate> _coordinates;
+    std::vector<_StrNode> _nodes;
+    std::vector<_StrEdge> _edges;
+};
+
+#endif /* LEVELORDEREDGRAPH_H_ */
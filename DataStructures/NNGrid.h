@@ -24,7 +24,9 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <limits>
 #include <vector>
 
@@ -36,11 +38,16 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <math.h>
 #endif
 
-#include <boost/thread.hpp>
 #include <boost/foreach.hpp>
-#include <boost/unordered_map.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
+#include "ConcurrentLRUCache.h"
+#include "ContainerFile.h"
 #include "DeallocatingVector.h"
+#include "EdgeSnapping.h"
 //#include "ExtractorStructs.h"
 #include "GridEdge.h"
 #include "Percent.h"
@@ -48,113 +55,179 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "Util.h"
 #include "StaticGraph.h"
 #include "../Algorithms/Bresenham.h"
+#include "../Util/OpenMPWrapper.h"
+#include "../Util/ResidencyPolicy.h"
 
 namespace NNGrid{
 
-static boost::thread_specific_ptr<std::ifstream> localStream;
-
 template<bool WriteAccess = false>
 class NNGrid {
+    //decoded contents of file buckets, shared by all threads
+    typedef ConcurrentLRUCache<unsigned, boost::shared_ptr<const std::vector<_GridEdge> > > BucketCache;
 public:
-    NNGrid() /*: cellCache(500), fileCache(500)*/ {
+    //for sorting the grid entries, the same as STXXL used to get
+    static const std::size_t DEFAULT_MEMORY_FOR_SORTING = 1024*1024*1024;
+
+    NNGrid() : fileIndexInMemory(NULL), sizeOfFileIndex(0) {
         ramIndexTable.resize((1024*1024), ULONG_MAX);
     }
 
-    NNGrid(const char* rif, const char* _i) {
+    NNGrid(const char* _r, const char* _i) : fileIndexInMemory(NULL), sizeOfFileIndex(0) {
         if(WriteAccess) {
             ERR("Not available in Write mode");
         }
+        rif = std::string(_r);
         iif = std::string(_i);
         ramIndexTable.resize((1024*1024), ULONG_MAX);
-        ramInFile.open(rif, std::ios::in | std::ios::binary);
     }
 
-    ~NNGrid() {
-        if(ramInFile.is_open()) ramInFile.close();
+    //uses the contents of both index files from memory that outlives the grid, e.g. shared memory
+    NNGrid(const unsigned long * ramIndex, const char * fileIndex, const std::size_t size) : fileIndexInMemory(fileIndex), sizeOfFileIndex(size) {
+        if(WriteAccess) {
+            ERR("Not available in Write mode");
+        }
+        ramIndexTable.assign(ramIndex, ramIndex + 1024*1024);
+    }
 
+    ~NNGrid() {
 #ifndef ROUTED
         if (WriteAccess) {
             entries.clear();
         }
 #endif
-        if(localStream.get() && localStream->is_open()) {
-            localStream->close();
+        if(bucketCache) {
+            INFO("grid bucket cache: " << bucketCache->GetNumberOfHits() << " hits, " << bucketCache->GetNumberOfMisses() << " misses, " << bucketCache->GetCost() << " bytes");
         }
     }
 
+    //throws std::runtime_error if an index file is damaged or of another kind
     void OpenIndexFiles() {
-        assert(ramInFile.is_open());
-        ramInFile.read((char*)&ramIndexTable[0], sizeof(unsigned long)*1024*1024);
-        ramInFile.close();
+        if(ContainerFile::IsContainerFile(rif.c_str())) {
+            ContainerFile ramIndexFile(rif.c_str(), ContainerFormat::RAM_INDEX_FILE);
+            ramIndexFile.VerifySection(ContainerFormat::RAM_INDEX_SECTION);
+            if(ramIndexTable.size()*sizeof(unsigned long) != ramIndexFile.GetSectionSize(ContainerFormat::RAM_INDEX_SECTION)) {
+                throw std::runtime_error(rif + " has an unexpected size");
+            }
+            memcpy(&ramIndexTable[0], ramIndexFile.GetSection(ContainerFormat::RAM_INDEX_SECTION), ramIndexTable.size()*sizeof(unsigned long));
+        } else {
+            INFO(rif << " is in the old format, rerun osrm-prepare");
+            std::ifstream ramInFile(rif.c_str(), std::ios::in | std::ios::binary);
+            ramInFile.read((char*)&ramIndexTable[0], sizeof(unsigned long)*1024*1024);
+            ramInFile.close();
+        }
+        //The cells are mapped and paged in on demand, so the checksum of the file index is not verified here.
+        //Threads read them without any locks or system calls.
+        boost::interprocess::file_mapping mapping(iif.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+        fileIndexRegion.swap(region);
+        fileIndexInMemory = static_cast<const char *>(fileIndexRegion.get_address());
+        sizeOfFileIndex = fileIndexRegion.get_size();
+        if(ContainerFile::IsContainerFile(iif.c_str())) {
+            ContainerFile fileIndexFile(fileIndexInMemory, sizeOfFileIndex, ContainerFormat::FILE_INDEX_FILE, iif);
+            fileIndexInMemory = fileIndexFile.GetSection(ContainerFormat::FILE_INDEX_SECTION);
+            sizeOfFileIndex = fileIndexFile.GetSectionSize(ContainerFormat::FILE_INDEX_SECTION);
+        }
     }
 
+    //keeps decoded file buckets up to the given number of bytes, so that cells near popular places are not decoded again
+    void EnableBucketCache(const std::size_t budgetInBytes) {
+        bucketCache.reset(new BucketCache(budgetInBytes));
+    }
+
+    //only the first level, cells are read from the file index on demand
+    void ApplyResidencyPolicy(const ResidencyPolicy & policy) const {
+        policy.Apply(&ramIndexTable[0], ramIndexTable.size()*sizeof(unsigned long), "grid index");
+    }
+
+    //Rasterizes the edges in parallel and writes both index files. The grid entries are sorted in memory
+    //if two copies of them fit into the given number of bytes, and by STXXL otherwise.
     template<typename EdgeT>
-    inline void ConstructGrid(DeallocatingVector<EdgeT> & edgeList, char * ramIndexOut, char * fileIndexOut) {
-    	//TODO: Implement this using STXXL-Streams
+    inline void ConstructGrid(DeallocatingVector<EdgeT> & edgeList, char * ramIndexOut, char * fileIndexOut, const std::size_t memoryForSorting = DEFAULT_MEMORY_FOR_SORTING) {
 #ifndef ROUTED
+        double timestamp = get_timestamp();
+        std::vector<GridEntry> entriesInMemory;
+        bool entriesFitIntoMemory = true;
+        std::size_t numberOfEntries = 0;
         Percent p(edgeList.size());
-        BOOST_FOREACH(EdgeT & edge, edgeList) {
-            p.printIncrement();
-            if(edge.ignoreInGrid)
-                continue;
-            int slat = 100000*lat2y(edge.lat1/100000.);
-            int slon = edge.lon1;
-            int tlat = 100000*lat2y(edge.lat2/100000.);
-            int tlon = edge.lon2;
-            AddEdge( _GridEdge( edge.id, edge.nameID, edge.weight, _Coordinate(slat, slon), _Coordinate(tlat, tlon), edge.belongsToTinyComponent ) );
+        //the edges are rasterized in blocks, so that the entries move to STXXL before they exceed the memory
+        std::vector<GridEntry> blockEntries;
+        for(unsigned blockBegin = 0; blockBegin < edgeList.size(); blockBegin += EDGES_PER_BLOCK) {
+            const unsigned blockEnd = std::min(blockBegin + EDGES_PER_BLOCK, (unsigned)edgeList.size());
+            blockEntries.clear();
+            RasterizeEdges(edgeList, blockBegin, blockEnd, p, blockEntries);
+            numberOfEntries += blockEntries.size();
+            if(entriesFitIntoMemory && 2*numberOfEntries*sizeof(GridEntry) > memoryForSorting) {
+                INFO("grid entries exceed " << (memoryForSorting >> 20) << " MB of memory, sorting them with STXXL");
+                entriesFitIntoMemory = false;
+                BOOST_FOREACH(const GridEntry & gridEntry, entriesInMemory) {
+                    entries.push_back(gridEntry);
+                }
+                std::vector<GridEntry>().swap(entriesInMemory);
+            }
+            if(entriesFitIntoMemory) {
+                entriesInMemory.insert(entriesInMemory.end(), blockEntries.begin(), blockEntries.end());
+            } else {
+                BOOST_FOREACH(const GridEntry & gridEntry, blockEntries) {
+                    entries.push_back(gridEntry);
+                }
+            }
         }
-        double timestamp = get_timestamp();
+        std::vector<GridEntry>().swap(blockEntries);
+        INFO("rasterized " << edgeList.size() << " edges into " << numberOfEntries << " grid entries in " << (get_timestamp() - timestamp) << "s");
+
+        timestamp = get_timestamp();
         //create index file on disk, old one is over written
-        indexOutFile.open(fileIndexOut, std::ios::out | std::ios::binary | std::ios::trunc);
-        INFO("sorting grid data consisting of " << entries.size() << " edges...");
-        //sort entries
-        stxxl::sort(entries.begin(), entries.end(), CompareGridEdgeDataByRamIndex(), 1024*1024*1024);
-        INFO("finished sorting after " << (get_timestamp() - timestamp) << "s");
-        std::vector<GridEntry> entriesInFileWithRAMSameIndex;
-        unsigned indexInRamTable = entries.begin()->ramIndex;
-        unsigned long lastPositionInIndexFile = 0;
-        cout << "writing data ..." << flush;
-        p.reinit(entries.size());
-        boost::unordered_map< unsigned, unsigned > cellMap(1024);
-        BOOST_FOREACH(GridEntry & gridEntry, entries) {
-            p.printIncrement();
-            if(gridEntry.ramIndex != indexInRamTable) {
-                cellMap.clear();
-                BuildCellIndexToFileIndexMap(indexInRamTable, cellMap);
-
-                unsigned numberOfBytesInCell = FillCell(entriesInFileWithRAMSameIndex, lastPositionInIndexFile, cellMap);
-                ramIndexTable[indexInRamTable] = lastPositionInIndexFile;
-                lastPositionInIndexFile += numberOfBytesInCell;
-                entriesInFileWithRAMSameIndex.clear();
-                indexInRamTable = gridEntry.ramIndex;
+        indexWriter.reset(new ContainerFileWriter(fileIndexOut, ContainerFormat::FILE_INDEX_FILE, 1));
+        indexWriter->BeginSection(ContainerFormat::FILE_INDEX_SECTION);
+        unsigned long positionInIndexFile = 0;
+        if(entriesFitIntoMemory) {
+            std::vector<GridEntry> sortedEntries;
+            SortByRAMIndex(entriesInMemory, sortedEntries);
+            std::vector<GridEntry>().swap(entriesInMemory);
+            INFO("sorted grid entries in memory after " << (get_timestamp() - timestamp) << "s");
+            std::size_t batchBegin = 0;
+            while(batchBegin < sortedEntries.size()) {
+                std::size_t batchEnd = std::min(batchBegin + ENTRIES_PER_BATCH, sortedEntries.size());
+                //cells are not split between batches
+                while(batchEnd < sortedEntries.size() && sortedEntries[batchEnd].ramIndex == sortedEntries[batchEnd-1].ramIndex) {
+                    ++batchEnd;
+                }
+                WriteCells(&sortedEntries[0] + batchBegin, &sortedEntries[0] + batchEnd, positionInIndexFile);
+                batchBegin = batchEnd;
+            }
+        } else {
+            stxxl::sort(entries.begin(), entries.end(), CompareGridEdgeDataByRamIndex(), memoryForSorting);
+            INFO("sorted grid entries with STXXL after " << (get_timestamp() - timestamp) << "s");
+            std::vector<GridEntry> batch;
+            BOOST_FOREACH(const GridEntry & gridEntry, entries) {
+                if(batch.size() >= ENTRIES_PER_BATCH && gridEntry.ramIndex != batch.back().ramIndex) {
+                    WriteCells(&batch[0], &batch[0] + batch.size(), positionInIndexFile);
+                    batch.clear();
+                }
+                batch.push_back(gridEntry);
+            }
+            if(!batch.empty()) {
+                WriteCells(&batch[0], &batch[0] + batch.size(), positionInIndexFile);
             }
-            entriesInFileWithRAMSameIndex.push_back(gridEntry);
-        }
-        cellMap.clear();
-        BuildCellIndexToFileIndexMap(indexInRamTable, cellMap);
-        /*unsigned numberOfBytesInCell = */FillCell(entriesInFileWithRAMSameIndex, lastPositionInIndexFile, cellMap);
-        ramIndexTable[indexInRamTable] = lastPositionInIndexFile;
-        entriesInFileWithRAMSameIndex.clear();
-        std::vector<GridEntry>().swap(entriesInFileWithRAMSameIndex);
-        assert(entriesInFileWithRAMSameIndex.size() == 0);
+            entries.clear();
+        }
         //close index file
-        indexOutFile.close();
+        indexWriter->EndSection();
+        indexWriter->Close();
+        indexWriter.reset();
+        INFO("wrote " << positionInIndexFile << " bytes of grid cells after " << (get_timestamp() - timestamp) << "s");
 
         //Serialize RAM Index
-        ofstream ramFile(ramIndexOut, std::ios::out | std::ios::binary | std::ios::trunc);
-        //write 4 MB of index Table in RAM
-        ramFile.write((char *)&ramIndexTable[0], sizeof(unsigned long)*1024*1024 );
-        //close ram index file
-        ramFile.close();
+        ContainerFileWriter ramWriter(ramIndexOut, ContainerFormat::RAM_INDEX_FILE, 1);
+        //write 8 MB of index Table in RAM
+        ramWriter.WriteSection(ContainerFormat::RAM_INDEX_SECTION, (char *)&ramIndexTable[0], sizeof(unsigned long)*1024*1024);
+        ramWriter.Close();
 #endif
     }
 
     bool FindPhantomNodeForCoordinate( const _Coordinate & location, PhantomNode & resultNode, const unsigned zoomLevel) {
         bool ignoreTinyComponents = (zoomLevel <= 14);
-//        INFO("ZoomLevel: " << zoomLevel << ", ignoring tinyComponentents: " << (ignoreTinyComponents ? "yes" : "no"));
-//        double time1 = get_timestamp();
-        bool foundNode = false;
-        _Coordinate startCoord(100000*(lat2y(static_cast<double>(location.lat)/100000.)), location.lon);
+        _Coordinate startCoord = ProjectCoordinate(location);
         /** search for point on edge close to source */
         const unsigned fileIndex = GetFileIndexForLatLon(startCoord.lat, startCoord.lon);
         std::vector<_GridEdge> candidates;
@@ -164,64 +237,22 @@ public:
                 GetContentsOfFileBucketEnumerated(fileIndex+i+j, candidates);
             }
         }
-        _GridEdge smallestEdge;
-        _Coordinate tmp;
-        double dist = numeric_limits<double>::max();
-        double r, tmpDist;
-
-        BOOST_FOREACH(_GridEdge candidate, candidates) {
-            if(candidate.belongsToTinyComponent && ignoreTinyComponents)
-                continue;
-            r = 0.;
-            tmpDist = ComputeDistance(startCoord, candidate.startCoord, candidate.targetCoord, tmp, &r);
-            if(tmpDist < dist && !DoubleEpsilonCompare(dist, tmpDist)) {
-//                INFO("a) " << candidate.edgeBasedNode << ", dist: " << tmpDist << ", tinyCC: " << (candidate.belongsToTinyComponent ? "yes" : "no"));
-                dist = tmpDist;
-                resultNode.edgeBasedNode = candidate.edgeBasedNode;
-                resultNode.nodeBasedEdgeNameID = candidate.nameID;
-                resultNode.weight1 = candidate.weight;
-                resultNode.weight2 = INT_MAX;
-                resultNode.location.lat = tmp.lat;
-                resultNode.location.lon = tmp.lon;
-                foundNode = true;
-                smallestEdge = candidate;
-                //}  else if(tmpDist < dist) {
-                //INFO("a) ignored " << candidate.edgeBasedNode << " at distance " << std::fabs(dist - tmpDist));
-            } else if(DoubleEpsilonCompare(dist, tmpDist) && 1 == std::abs((int)candidate.edgeBasedNode-(int)resultNode.edgeBasedNode)) {
-                resultNode.weight2 = candidate.weight;
-                //INFO("b) " << candidate.edgeBasedNode << ", dist: " << tmpDist);
-            }
+        if(SelectPhantomNode(location, candidates, ignoreTinyComponents, resultNode)) {
+            return true;
         }
+        //nothing in the neighbourhood, e.g. in rural areas
+        FindNearestEdges(startCoord, ignoreTinyComponents, 1, std::numeric_limits<double>::max(), candidates);
+        resultNode.Reset();
+        return SelectPhantomNode(location, candidates, ignoreTinyComponents, resultNode);
+    }
 
-        //        INFO("startcoord: " << smallestEdge.startCoord << ", tgtcoord" <<  smallestEdge.targetCoord << "result: " << newEndpoint);
-        //        INFO("length of old edge: " << ApproximateDistance(smallestEdge.startCoord, smallestEdge.targetCoord));
-        //        INFO("Length of new edge: " << ApproximateDistance(smallestEdge.startCoord, newEndpoint));
-        //        assert(!resultNode.isBidirected() || (resultNode.weight1 == resultNode.weight2));
-        //        if(resultNode.weight1 != resultNode.weight2) {
-        //            INFO("-> Weight1: " << resultNode.weight1 << ", weight2: " << resultNode.weight2);
-        //            INFO("-> node: " << resultNode.edgeBasedNode << ", bidir: " << (resultNode.isBidirected() ? "yes" : "no"));
-        //        }
-
-//        INFO("startCoord: " << smallestEdge.startCoord << "; targetCoord: " << smallestEdge.targetCoord << "; newEndpoint: " << resultNode.location);
-        double ratio = (foundNode ? std::min(1., ApproximateDistance(smallestEdge.startCoord, resultNode.location)/ApproximateDistance(smallestEdge.startCoord, smallestEdge.targetCoord)) : 0);
-        resultNode.location.lat = round(100000.*(y2lat(static_cast<double>(resultNode.location.lat)/100000.)));
-//        INFO("Length of vector: " << ApproximateDistance(smallestEdge.startCoord, resultNode.location)/ApproximateDistance(smallestEdge.startCoord, smallestEdge.targetCoord));
-        //Hack to fix rounding errors and wandering via nodes.
-        if(std::abs(location.lon - resultNode.location.lon) == 1)
-            resultNode.location.lon = location.lon;
-        if(std::abs(location.lat - resultNode.location.lat) == 1)
-            resultNode.location.lat = location.lat;
-
-        resultNode.weight1 *= ratio;
-        if(INT_MAX != resultNode.weight2) {
-            resultNode.weight2 -= resultNode.weight1;
-        }
-        resultNode.ratio = ratio;
-        //        INFO("New weight1: " << resultNode.weight1 << ", new weight2: " << resultNode.weight2 << ", ratio: " << ratio);
-//        INFO("selected node: " << resultNode.edgeBasedNode << ", bidirected: " << (resultNode.isBidirected() ? "yes" : "no") <<  "\n--");
-//        double time2 = get_timestamp();
-//        INFO("NN-Lookup in " << 1000*(time2-time1) << "ms");
-        return foundNode;
+    //up to maxNumberOfResults phantom nodes within maxDistance meters, nearest first
+    void FindNearestPhantomNodes(const _Coordinate & location, const unsigned maxNumberOfResults, const double maxDistance, const unsigned zoomLevel, std::vector<PhantomNodeCandidate> & result) {
+        const bool ignoreTinyComponents = (zoomLevel <= 14);
+        std::vector<_GridEdge> candidates;
+        //both directions of a street are separate edges
+        FindNearestEdges(ProjectCoordinate(location), ignoreTinyComponents, 2*maxNumberOfResults, GetSquaredProjectedRadius(location, maxDistance), candidates);
+        SelectPhantomNodes(location, candidates, ignoreTinyComponents, maxNumberOfResults, maxDistance, result);
     }
 
     bool FindRoutingStarts(const _Coordinate& start, const _Coordinate& target, PhantomNodes & routingStarts, unsigned zoomLevel) {
@@ -238,264 +269,290 @@ public:
     }
 
     void FindNearestPointOnEdge(const _Coordinate& inputCoordinate, _Coordinate& outputCoordinate) {
-        _Coordinate startCoord(100000*(lat2y(static_cast<double>(inputCoordinate.lat)/100000.)), inputCoordinate.lon);
+        _Coordinate startCoord = ProjectCoordinate(inputCoordinate);
         unsigned fileIndex = GetFileIndexForLatLon(startCoord.lat, startCoord.lon);
 
         std::vector<_GridEdge> candidates;
-        boost::unordered_map< unsigned, unsigned > cellMap;
         for(int j = -32768; j < (32768+1); j+=32768) {
             for(int i = -1; i < 2; ++i) {
-                GetContentsOfFileBucket(fileIndex+i+j, candidates, cellMap);
-            }
-        }
-        _Coordinate tmp;
-        double dist = (std::numeric_limits<double>::max)();
-        BOOST_FOREACH(_GridEdge candidate, candidates) {
-            double r = 0.;
-            double tmpDist = ComputeDistance(startCoord, candidate.startCoord, candidate.targetCoord, tmp, &r);
-            if(tmpDist < dist) {
-                dist = tmpDist;
-                outputCoordinate.lat = round(100000*(y2lat(static_cast<double>(tmp.lat)/100000.)));
-                outputCoordinate.lon = tmp.lon;
+                GetContentsOfFileBucketEnumerated(fileIndex+i+j, candidates);
             }
         }
+        SelectNearestPoint(inputCoordinate, candidates, outputCoordinate);
     }
 
 
 private:
-    inline unsigned GetCellIndexFromRAMAndFileIndex(const unsigned ramIndex, const unsigned fileIndex) const {
-        unsigned lineBase = ramIndex/1024;
-        lineBase = lineBase*32*32768;
-        unsigned columnBase = ramIndex%1024;
-        columnBase=columnBase*32;
-        for (int i = 0;i < 32;++i) {
-            for (int j = 0;j < 32;++j) {
-                const unsigned localFileIndex = lineBase + i * 32768 + columnBase + j;
-                if(localFileIndex == fileIndex) {
-                    unsigned cellIndex = i * 32 + j;
-                    return cellIndex;
+    //Edges of the cells in rings around the projected point, until at least minimumNumberOfEdges of them are
+    //certainly among the nearest ones or the rings cover the squared distance. Each ring only adds the edges
+    //that the inner rings did not hold. After MAX_NUMBER_OF_RINGS rings only the edges that are certainly
+    //nearer than all others are returned, i.e. none far out at sea. The result is ordered by edge-based node.
+    void FindNearestEdges(const _Coordinate & startCoord, const bool ignoreTinyComponents, const unsigned minimumNumberOfEdges, const double maxSquaredDistance, std::vector<_GridEdge> & result) {
+        result.clear();
+        const unsigned fileIndex = GetFileIndexForLatLon(startCoord.lat, startCoord.lon);
+        if(UINT_MAX == fileIndex) {
+            return;
+        }
+        const int row = fileIndex / 32768;
+        const int column = fileIndex % 32768;
+        std::vector<_GridEdge> ringEdges;
+        std::vector<_GridEdge> newEdges;
+        std::vector<double> distances;
+        std::vector<double> ratios;
+        //ascending, of the edges found so far that a point may be snapped to
+        std::vector<double> squaredDistances;
+        double reach = 0.;
+        for(int ring = 0; ring <= MAX_NUMBER_OF_RINGS; ++ring) {
+            ringEdges.clear();
+            for(int i = -ring; i <= ring; ++i) {
+                //inner rows of the ring only have cells at both ends
+                const int step = ((ring == std::abs(i) || 0 == ring) ? 1 : 2*ring);
+                for(int j = -ring; j <= ring; j += step) {
+                    if(row+i < 0 || row+i >= 32768 || column+j < 0 || column+j >= 32768)
+                        continue;
+                    GetContentsOfFileBucketEnumerated((row+i)*32768 + column+j, ringEdges);
+                }
+            }
+            std::sort(ringEdges.begin(), ringEdges.end());
+            ringEdges.erase(std::unique(ringEdges.begin(), ringEdges.end()), ringEdges.end());
+            //edges that cross several cells may have been found in an inner ring already
+            newEdges.clear();
+            std::set_difference(ringEdges.begin(), ringEdges.end(), result.begin(), result.end(), std::back_inserter(newEdges));
+
+            ComputeDistancesToCandidates(startCoord, newEdges, distances, ratios);
+            const std::size_t numberOfKnownDistances = squaredDistances.size();
+            for(unsigned k = 0; k < newEdges.size(); ++k) {
+                if(!(newEdges[k].belongsToTinyComponent && ignoreTinyComponents)) {
+                    squaredDistances.push_back(distances[k]);
                 }
             }
+            std::sort(squaredDistances.begin() + numberOfKnownDistances, squaredDistances.end());
+            std::inplace_merge(squaredDistances.begin(), squaredDistances.begin() + numberOfKnownDistances, squaredDistances.end());
+            const std::size_t numberOfKnownEdges = result.size();
+            result.insert(result.end(), newEdges.begin(), newEdges.end());
+            std::inplace_merge(result.begin(), result.begin() + numberOfKnownEdges, result.end());
+
+            //an edge that passes this close runs through one of the cells so far, i.e. this is the distance to the
+            //border of the rings less one cell for the position of the point in its cell and for rounding of the rows
+            reach = std::max(0, ring-1)*GRID_CELL_SIZE;
+            if(reach*reach >= maxSquaredDistance) {
+                return;
+            }
+            const std::size_t numberOfEdgesInReach = std::upper_bound(squaredDistances.begin(), squaredDistances.end(), reach*reach) - squaredDistances.begin();
+            if(numberOfEdgesInReach >= minimumNumberOfEdges) {
+                return;
+            }
         }
-        return UINT_MAX;
-    }
-
-
-    inline void BuildCellIndexToFileIndexMap(const unsigned ramIndex, boost::unordered_map<unsigned, unsigned >& cellMap){
-        unsigned lineBase = ramIndex/1024;
-        lineBase = lineBase*32*32768;
-        unsigned columnBase = ramIndex%1024;
-        columnBase=columnBase*32;
-        std::vector<std::pair<unsigned, unsigned> >insertionVector(1024);
-        for (int i = 0;i < 32;++i) {
-            for (int j = 0;j < 32;++j) {
-                unsigned fileIndex = lineBase + i * 32768 + columnBase + j;
-                unsigned cellIndex = i * 32 + j;
-                insertionVector[i * 32 + j] = std::make_pair(fileIndex, cellIndex);
+        //edges beyond the reach of the last ring may be farther away than edges in the cells that were not searched
+        ComputeDistancesToCandidates(startCoord, result, distances, ratios);
+        std::vector<_GridEdge>::iterator last = result.begin();
+        for(unsigned k = 0; k < result.size(); ++k) {
+            if(distances[k] <= reach*reach) {
+                *last++ = result[k];
             }
         }
-        cellMap.insert(insertionVector.begin(), insertionVector.end());
+        result.erase(last, result.end());
     }
 
-    inline bool DoubleEpsilonCompare(const double d1, const double d2) {
-        return (std::fabs(d1 - d2) < 0.0001);
+    //position of a file bucket among the 32x32 buckets of its cell, i.e. of GetRAMIndexFromFileIndex(fileIndex)
+    inline unsigned GetCellIndexFromFileIndex(const unsigned fileIndex) const {
+        const unsigned i = (fileIndex / 32768) % 32;
+        const unsigned j = (fileIndex % 32768) % 32;
+        return i * 32 + j;
     }
 
-    inline unsigned FillCell(std::vector<GridEntry>& entriesWithSameRAMIndex, const unsigned long fileOffset, boost::unordered_map< unsigned, unsigned > & cellMap ) {
-        std::vector<char> tmpBuffer(32*32*4096,0);
-        unsigned long indexIntoTmpBuffer = 0;
-        unsigned numberOfWrittenBytes = 0;
-        assert(indexOutFile.is_open());
-
-        std::vector<unsigned long> cellIndex(32*32,ULONG_MAX);
 
-        for(unsigned i = 0; i < entriesWithSameRAMIndex.size() -1; ++i) {
-            assert(entriesWithSameRAMIndex[i].ramIndex== entriesWithSameRAMIndex[i+1].ramIndex);
+#ifndef ROUTED
+    //grid entries of the edges in [begin, end), each thread rasterizes into a buffer of its own
+    template<typename EdgeT>
+    inline void RasterizeEdges(const DeallocatingVector<EdgeT> & edgeList, const unsigned begin, const unsigned end, Percent & p, std::vector<GridEntry> & result) const {
+#pragma omp parallel
+        {
+            std::vector<BresenhamPixel> indexList;
+            std::vector<GridEntry> localEntries;
+#pragma omp for schedule ( guided ) nowait
+            for(int i = begin; i < (int)end; ++i) {
+                p.printIncrement();
+                const EdgeT & edge = edgeList[i];
+                if(edge.ignoreInGrid)
+                    continue;
+                int slat = 100000*lat2y(edge.lat1/100000.);
+                int slon = edge.lon1;
+                int tlat = 100000*lat2y(edge.lat2/100000.);
+                int tlon = edge.lon2;
+                const _GridEdge gridEdge(edge.id, edge.nameID, edge.weight, _Coordinate(slat, slon), _Coordinate(tlat, tlon), edge.belongsToTinyComponent);
+                indexList.clear();
+                GetListOfIndexesForEdgeAndGridSize(gridEdge.startCoord, gridEdge.targetCoord, indexList);
+                for(unsigned j = 0; j < indexList.size(); ++j) {
+                    localEntries.push_back(GridEntry(gridEdge, indexList[j].first, indexList[j].second));
+                }
+            }
+#pragma omp critical
+            result.insert(result.end(), localEntries.begin(), localEntries.end());
         }
+    }
 
-        //sort & unique
-        std::sort(entriesWithSameRAMIndex.begin(), entriesWithSameRAMIndex.end(), CompareGridEdgeDataByFileIndex());
-        entriesWithSameRAMIndex.erase(std::unique(entriesWithSameRAMIndex.begin(), entriesWithSameRAMIndex.end()), entriesWithSameRAMIndex.end());
-
-        //traverse each file bucket and write its contents to disk
-        std::vector<GridEntry> entriesWithSameFileIndex;
-        unsigned fileIndex = entriesWithSameRAMIndex.begin()->fileIndex;
-
-        BOOST_FOREACH(GridEntry & gridEntry, entriesWithSameRAMIndex) {
-            assert(cellMap.find(gridEntry.fileIndex) != cellMap.end() ); //asserting that file index belongs to cell index
-            if(gridEntry.fileIndex != fileIndex) {
-                // start in cellIndex vermerken
-                int localFileIndex = entriesWithSameFileIndex.begin()->fileIndex;
-                int localCellIndex = cellMap.find(localFileIndex)->second;
-                assert(cellMap.find(entriesWithSameFileIndex.begin()->fileIndex) != cellMap.end());
-
-                cellIndex[localCellIndex] = indexIntoTmpBuffer + fileOffset;
-                indexIntoTmpBuffer += FlushEntriesWithSameFileIndexToBuffer(entriesWithSameFileIndex, tmpBuffer, indexIntoTmpBuffer);
-                fileIndex = gridEntry.fileIndex;
+    //Stable counting sort by ram index. Every thread counts and moves the entries of the same static range,
+    //the prefix sums give each thread its own positions in every cell.
+    inline void SortByRAMIndex(const std::vector<GridEntry> & input, std::vector<GridEntry> & output) const {
+        output.resize(input.size());
+        std::vector<std::vector<unsigned> > positions(omp_get_max_threads());
+#pragma omp parallel
+        {
+            std::vector<unsigned> & position = positions[omp_get_thread_num()];
+            position.assign(1024*1024, 0);
+#pragma omp for schedule ( static )
+            for(int i = 0; i < (int)input.size(); ++i) {
+                ++position[input[i].ramIndex];
+            }
+#pragma omp single
+            {
+                const int numberOfThreads = omp_get_num_threads();
+                unsigned sum = 0;
+                for(unsigned ramIndex = 0; ramIndex < 1024*1024; ++ramIndex) {
+                    for(int t = 0; t < numberOfThreads; ++t) {
+                        const unsigned count = positions[t][ramIndex];
+                        positions[t][ramIndex] = sum;
+                        sum += count;
+                    }
+                }
+            }
+#pragma omp for schedule ( static )
+            for(int i = 0; i < (int)input.size(); ++i) {
+                output[position[input[i].ramIndex]++] = input[i];
             }
-            entriesWithSameFileIndex.push_back(gridEntry);
         }
-        assert(cellMap.find(entriesWithSameFileIndex.begin()->fileIndex) != cellMap.end());
-        int localFileIndex = entriesWithSameFileIndex.begin()->fileIndex;
-        int localCellIndex = cellMap.find(localFileIndex)->second;
-
-        cellIndex[localCellIndex] = indexIntoTmpBuffer + fileOffset;
-        indexIntoTmpBuffer += FlushEntriesWithSameFileIndexToBuffer(entriesWithSameFileIndex, tmpBuffer, indexIntoTmpBuffer);
-
-        assert(entriesWithSameFileIndex.size() == 0);
-        indexOutFile.write((char *)&cellIndex[0],32*32*sizeof(unsigned long));
-        numberOfWrittenBytes += 32*32*sizeof(unsigned long);
-
-        //write contents of tmpbuffer to disk
-        indexOutFile.write(&tmpBuffer[0], indexIntoTmpBuffer*sizeof(char));
-        numberOfWrittenBytes += indexIntoTmpBuffer*sizeof(char);
-
-        return numberOfWrittenBytes;
     }
 
-    inline unsigned FlushEntriesWithSameFileIndexToBuffer( std::vector<GridEntry> &vectorWithSameFileIndex, std::vector<char> & tmpBuffer, const unsigned long index) const {
-        sort( vectorWithSameFileIndex.begin(), vectorWithSameFileIndex.end() );
-        vectorWithSameFileIndex.erase(unique(vectorWithSameFileIndex.begin(), vectorWithSameFileIndex.end()), vectorWithSameFileIndex.end());
-        const unsigned lengthOfBucket = vectorWithSameFileIndex.size();
-        tmpBuffer.resize(tmpBuffer.size()+(sizeof(_GridEdge)*lengthOfBucket) + sizeof(unsigned) );
-        unsigned counter = 0;
-
-        for(unsigned i = 0; i < vectorWithSameFileIndex.size()-1; ++i) {
-            assert( vectorWithSameFileIndex[i].fileIndex == vectorWithSameFileIndex[i+1].fileIndex );
-            assert( vectorWithSameFileIndex[i].ramIndex == vectorWithSameFileIndex[i+1].ramIndex );
+    //Writes the cells of entries that are sorted by ram index. Each cell is sorted and serialized by a thread
+    //of its own into a buffer of the precomputed size, the buffers are written in order.
+    inline void WriteCells(GridEntry * begin, GridEntry * end, unsigned long & positionInIndexFile) {
+        assert(indexWriter);
+        std::vector<GridEntry *> cellBegin;
+        for(GridEntry * gridEntry = begin; gridEntry != end; ++gridEntry) {
+            if(gridEntry == begin || gridEntry->ramIndex != (gridEntry-1)->ramIndex) {
+                cellBegin.push_back(gridEntry);
+            }
         }
-
-        //write length of bucket
-        memcpy((char*)&(tmpBuffer[index+counter]), (char *)&lengthOfBucket, sizeof(lengthOfBucket));
-        counter += sizeof(lengthOfBucket);
-
-        BOOST_FOREACH(const GridEntry & entry, vectorWithSameFileIndex) {
-            char * data = (char *)&(entry.edge);
-            memcpy((char*)&(tmpBuffer[index+counter]), data, sizeof(entry.edge));
-            counter += sizeof(entry.edge);
+        cellBegin.push_back(end);
+        const int numberOfCells = cellBegin.size() - 1;
+        std::vector<GridEntry *> cellEnd(numberOfCells);
+        std::vector<unsigned long> cellSize(numberOfCells);
+#pragma omp parallel for schedule ( guided )
+        for(int c = 0; c < numberOfCells; ++c) {
+            std::sort(cellBegin[c], cellBegin[c+1], CompareGridEdgeDataByFileIndex());
+            cellEnd[c] = std::unique(cellBegin[c], cellBegin[c+1], EqualGridEdgeDataInFileBucket());
+            cellSize[c] = GetSizeOfCell(cellBegin[c], cellEnd[c]);
+        }
+        std::vector<unsigned long> cellPosition(numberOfCells);
+        for(int c = 0; c < numberOfCells; ++c) {
+            cellPosition[c] = positionInIndexFile;
+            ramIndexTable[cellBegin[c]->ramIndex] = positionInIndexFile;
+            positionInIndexFile += cellSize[c];
+        }
+        std::vector<std::vector<char> > buffers(numberOfCells);
+#pragma omp parallel for schedule ( guided )
+        for(int c = 0; c < numberOfCells; ++c) {
+            buffers[c].resize(cellSize[c]);
+            SerializeCell(cellBegin[c], cellEnd[c], cellPosition[c], buffers[c]);
+        }
+        for(int c = 0; c < numberOfCells; ++c) {
+            indexWriter->Write(&buffers[c][0], buffers[c].size());
         }
-        //Freeing data
-        vectorWithSameFileIndex.clear();
-        return counter;
     }
 
-    inline void GetContentsOfFileBucketEnumerated(const unsigned fileIndex, std::vector<_GridEdge>& result) const {
-        unsigned ramIndex = GetRAMIndexFromFileIndex(fileIndex);
-        unsigned long startIndexInFile = ramIndexTable[ramIndex];
-        if(startIndexInFile == ULONG_MAX) {
-            return;
+    //a cell is the table of its 32x32 file buckets followed by the length and the edges of each bucket
+    inline unsigned long GetSizeOfCell(const GridEntry * begin, const GridEntry * end) const {
+        unsigned long size = 32*32*sizeof(unsigned long);
+        for(const GridEntry * gridEntry = begin; gridEntry != end; ++gridEntry) {
+            if(gridEntry == begin || gridEntry->fileIndex != (gridEntry-1)->fileIndex) {
+                size += sizeof(unsigned);
+            }
+            size += sizeof(_GridEdge);
         }
-        unsigned enumeratedIndex = GetCellIndexFromRAMAndFileIndex(ramIndex, fileIndex);
+        return size;
+    }
 
-        if(!localStream.get() || !localStream->is_open()) {
-            localStream.reset(new std::ifstream(iif.c_str(), std::ios::in | std::ios::binary));
-        }
-        if(!localStream->good()) {
-            localStream->clear(std::ios::goodbit);
-            DEBUG("Resetting stale filestream");
+    //the table holds the positions of the buckets relative to the end of the table, plus the position of the cell
+    inline void SerializeCell(const GridEntry * begin, const GridEntry * end, const unsigned long cellPosition, std::vector<char> & buffer) const {
+        const unsigned long sizeOfTable = 32*32*sizeof(unsigned long);
+        std::vector<unsigned long> cellIndex(32*32, ULONG_MAX);
+        unsigned long indexIntoBuffer = sizeOfTable;
+        const GridEntry * bucketBegin = begin;
+        while(bucketBegin != end) {
+            const GridEntry * bucketEnd = bucketBegin;
+            while(bucketEnd != end && bucketEnd->fileIndex == bucketBegin->fileIndex) {
+                ++bucketEnd;
+            }
+            cellIndex[GetCellIndexFromFileIndex(bucketBegin->fileIndex)] = cellPosition + indexIntoBuffer - sizeOfTable;
+            const unsigned lengthOfBucket = bucketEnd - bucketBegin;
+            memcpy(&buffer[indexIntoBuffer], (char *)&lengthOfBucket, sizeof(unsigned));
+            indexIntoBuffer += sizeof(unsigned);
+            for(const GridEntry * gridEntry = bucketBegin; gridEntry != bucketEnd; ++gridEntry) {
+                memcpy(&buffer[indexIntoBuffer], (char *)&(gridEntry->edge), sizeof(_GridEdge));
+                indexIntoBuffer += sizeof(_GridEdge);
+            }
+            bucketBegin = bucketEnd;
         }
+        assert(indexIntoBuffer == buffer.size());
+        memcpy(&buffer[0], (char *)&cellIndex[0], sizeOfTable);
+    }
+#endif
 
-        //only read the single necessary cell index
-        localStream->seekg(startIndexInFile+(enumeratedIndex*sizeof(unsigned long)));
-        unsigned long fetchedIndex = 0;
-        localStream->read((char*) &fetchedIndex, sizeof(unsigned long));
-
-        if(fetchedIndex == ULONG_MAX) {
+    inline void GetContentsOfFileBucketEnumerated(const unsigned fileIndex, std::vector<_GridEdge>& result) const {
+        if(!bucketCache) {
+            ReadFileBucket(fileIndex, result);
             return;
         }
-        const unsigned long position = fetchedIndex + 32*32*sizeof(unsigned long) ;
-
-        unsigned lengthOfBucket;
-        unsigned currentSizeOfResult = result.size();
-        localStream->seekg(position);
-        localStream->read((char *)&(lengthOfBucket), sizeof(unsigned));
-        result.resize(currentSizeOfResult+lengthOfBucket);
-        localStream->read((char *)&result[currentSizeOfResult], lengthOfBucket*sizeof(_GridEdge));
+        boost::shared_ptr<const std::vector<_GridEdge> > bucket;
+        if(!bucketCache->Fetch(fileIndex, bucket)) {
+            //empty buckets are cached as well, most lookups far from any road find nothing
+            boost::shared_ptr<std::vector<_GridEdge> > decodedBucket(new std::vector<_GridEdge>());
+            ReadFileBucket(fileIndex, *decodedBucket);
+            bucketCache->Insert(fileIndex, decodedBucket, sizeof(std::vector<_GridEdge>) + decodedBucket->size()*sizeof(_GridEdge));
+            bucket = decodedBucket;
+        }
+        result.insert(result.end(), bucket->begin(), bucket->end());
     }
 
-
-    inline void GetContentsOfFileBucket(const unsigned fileIndex, std::vector<_GridEdge>& result, boost::unordered_map< unsigned, unsigned> & cellMap) {
+    //appends the edges of a file bucket, buckets outside of a damaged file index are empty
+    inline void ReadFileBucket(const unsigned fileIndex, std::vector<_GridEdge>& result) const {
         unsigned ramIndex = GetRAMIndexFromFileIndex(fileIndex);
         unsigned long startIndexInFile = ramIndexTable[ramIndex];
         if(startIndexInFile == ULONG_MAX) {
             return;
         }
+        unsigned enumeratedIndex = GetCellIndexFromFileIndex(fileIndex);
 
-        unsigned long cellIndex[32*32];
-
-        cellMap.clear();
-        BuildCellIndexToFileIndexMap(ramIndex,  cellMap);
-        if(!localStream.get() || !localStream->is_open()) {
-            localStream.reset(new std::ifstream(iif.c_str(), std::ios::in | std::ios::binary));
-        }
-        if(!localStream->good()) {
-            localStream->clear(std::ios::goodbit);
-            DEBUG("Resetting stale filestream");
+        //only read the single necessary cell index
+        unsigned long fetchedIndex = 0;
+        if(!ReadFromFileIndex(startIndexInFile+(enumeratedIndex*sizeof(unsigned long)), (char*) &fetchedIndex, sizeof(unsigned long))) {
+            return;
         }
 
-        localStream->seekg(startIndexInFile);
-        localStream->read((char*) cellIndex, 32*32*sizeof(unsigned long));
-        assert(cellMap.find(fileIndex) != cellMap.end());
-        if(cellIndex[cellMap[fileIndex]] == ULONG_MAX) {
+        if(fetchedIndex == ULONG_MAX) {
             return;
         }
-        const unsigned long position = cellIndex[cellMap[fileIndex]] + 32*32*sizeof(unsigned long) ;
+        const unsigned long position = fetchedIndex + 32*32*sizeof(unsigned long) ;
 
-        unsigned lengthOfBucket;
+        unsigned lengthOfBucket = 0;
         unsigned currentSizeOfResult = result.size();
-        localStream->seekg(position);
-        localStream->read((char *)&(lengthOfBucket), sizeof(unsigned));
+        if(!ReadFromFileIndex(position, (char *)&(lengthOfBucket), sizeof(unsigned)) || (sizeOfFileIndex - position - sizeof(unsigned))/sizeof(_GridEdge) < lengthOfBucket) {
+            return;
+        }
         result.resize(currentSizeOfResult+lengthOfBucket);
-        localStream->read((char *)&result[currentSizeOfResult], lengthOfBucket*sizeof(_GridEdge));
-    }
-
-    inline void AddEdge(const _GridEdge & edge) {
-#ifndef ROUTED
-        std::vector<BresenhamPixel> indexList;
-        GetListOfIndexesForEdgeAndGridSize(edge.startCoord, edge.targetCoord, indexList);
-        for(unsigned i = 0; i < indexList.size(); ++i) {
-            entries.push_back(GridEntry(edge, indexList[i].first, indexList[i].second));
+        if(lengthOfBucket) {
+            ReadFromFileIndex(position+sizeof(unsigned), (char *)&result[currentSizeOfResult], lengthOfBucket*sizeof(_GridEdge));
         }
-#endif
     }
 
-    inline double ComputeDistance(const _Coordinate& inputPoint, const _Coordinate& source, const _Coordinate& target, _Coordinate& nearest, double *r) {
-
-        const double x = (double)inputPoint.lat;
-        const double y = (double)inputPoint.lon;
-        const double a = (double)source.lat;
-        const double b = (double)source.lon;
-        const double c = (double)target.lat;
-        const double d = (double)target.lon;
-        double p,q,mX,nY;
-        if(c != a){
-            const double m = (d-b)/(c-a); // slope
-            // Projection of (x,y) on line joining (a,b) and (c,d)
-            p = ((x + (m*y)) + (m*m*a - m*b))/(1. + m*m);
-            q = b + m*(p - a);
-        }
-        else{
-            p = c;
-            q = y;
-        }
-        nY = (d*p - c*q)/(a*d - b*c);
-        mX = (p - nY*a)/c;// These values are actually n/m+n and m/m+n , we neednot calculate the values of m an n as we are just interested in the ratio
-        *r = mX;
-        if(*r<=0){
-            nearest.lat = source.lat;
-            nearest.lon = source.lon;
-            return ((b - y)*(b - y) + (a - x)*(a - x));
-        }
-        else if(*r >= 1){
-            nearest.lat = target.lat;
-            nearest.lon = target.lon;
-            return ((d - y)*(d - y) + (c - x)*(c - x));
-
-        }
-        // point lies in between
-        nearest.lat = p;
-        nearest.lon = q;
-        return (p-x)*(p-x) + (q-y)*(q-y);
+    //copies from the mapped file index or from its contents in memory, false if the range is outside of it
+    inline bool ReadFromFileIndex(const unsigned long position, char * destination, const std::size_t size) const {
+        if(position > sizeOfFileIndex || size > sizeOfFileIndex - position) {
+            return false;
+        }
+        memcpy(destination, fileIndexInMemory + position, size);
+        return true;
     }
 
     inline void GetListOfIndexesForEdgeAndGridSize(const _Coordinate& start, const _Coordinate& target, std::vector<BresenhamPixel> &indexList) const {
@@ -552,16 +609,27 @@ private:
     }
 
     const static unsigned long END_OF_BUCKET_DELIMITER = UINT_MAX;
-
-    std::ofstream indexOutFile;
-    std::ifstream ramInFile;
+    const static unsigned EDGES_PER_BLOCK = 1024*1024;
+    //about 40 MB of entries that are serialized at once
+    const static std::size_t ENTRIES_PER_BATCH = 1024*1024;
+    //width and height of a file bucket in projected coordinates, 360 degrees in 32768 buckets
+    const static int GRID_CELL_SIZE = 1099;
+    //range of the ring search, at most 17x17 file buckets. Edges up to 7 cells away are found, i.e. about 7.7km
+    //at the equator and 4.7km at 52 degrees of latitude, where the r-tree has to be used to snap points farther out.
+    const static int MAX_NUMBER_OF_RINGS = 8;
+
+    boost::scoped_ptr<ContainerFileWriter> indexWriter;
 #ifndef ROUTED
     stxxl::vector<GridEntry> entries;
 #endif
     std::vector<unsigned long> ramIndexTable; //8 MB for first level index in RAM
+    std::string rif;
     std::string iif;
-    //    LRUCache<int,std::vector<unsigned> > cellCache;
-    //    LRUCache<int,std::vector<_Edge> > fileCache;
+    //positions in the file index are relative to its section
+    const char * fileIndexInMemory;
+    std::size_t sizeOfFileIndex;
+    boost::interprocess::mapped_region fileIndexRegion;
+    boost::scoped_ptr<BucketCache> bucketCache;
 };
 }
 
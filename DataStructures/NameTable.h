@@ -0,0 +1,170 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef NAMETABLE_H_
+#define NAMETABLE_H_
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "../typedefs.h"
+#include "../Util/ResidencyPolicy.h"
+#include "ContainerFile.h"
+
+/*
+ * Street names, stored as one block of characters and an array of offsets
+ * into it: name i consists of the characters in [offsets[i], offsets[i+1]).
+ * A .names file holds both arrays as sections of a container and is mapped
+ * and used in place. Files in the old layout, which stores the length of each
+ * name in front of its characters, are converted while they are read.
+ */
+class NameTable : private boost::noncopyable {
+public:
+    //maps the file if it is a container, otherwise its contents are converted.
+    //Throws std::runtime_error if the file is damaged or of another kind.
+    explicit NameTable( const char * fileName ) : _offsets(NULL), _characters(NULL), _numberOfNames(0) {
+        if(ContainerFile::IsContainerFile(fileName)) {
+            _container.reset(new ContainerFile(fileName, ContainerFormat::NAMES_FILE));
+            _container->VerifyAllSections();
+            UseContainer();
+            return;
+        }
+        INFO(fileName << " is in the old format and is converted, rerun osrm-extract for faster startup");
+        std::ifstream in(fileName, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        ConvertOldLayout(data.data(), data.size());
+    }
+
+    //uses a container in memory that outlives the table, e.g. shared memory
+    NameTable( const char * memory, const std::size_t size ) : _offsets(NULL), _characters(NULL), _numberOfNames(0) {
+        _container.reset(new ContainerFile(memory, size, ContainerFormat::NAMES_FILE, "names data"));
+        UseContainer();
+    }
+
+    template<class IteratorT>
+    static void Write( const char * fileName, IteratorT begin, const IteratorT end ) {
+        std::vector<unsigned> offsets(1, 0);
+        for(IteratorT it = begin; it != end; ++it) {
+            const unsigned long long offset = (unsigned long long) offsets.back() + it->length();
+            if(UINT_MAX < offset) {
+                ERR("street names do not fit into a name table");
+            }
+            offsets.push_back(offset);
+        }
+        ContainerFileWriter writer(fileName, ContainerFormat::NAMES_FILE, NUMBER_OF_SECTIONS);
+        writer.WriteSection(OFFSETS_SECTION, (char *) &offsets[0], offsets.size()*sizeof(unsigned));
+        writer.BeginSection(CHARACTERS_SECTION);
+        for(IteratorT it = begin; it != end; ++it) {
+            writer.Write(it->data(), it->length());
+        }
+        writer.EndSection();
+        writer.Close();
+    }
+
+    inline unsigned GetNumberOfNames() const {
+        return _numberOfNames;
+    }
+
+    //characters of a name, they are not terminated
+    inline const char * GetNameData( const unsigned nameID ) const {
+        return (nameID < _numberOfNames ? _characters + _offsets[nameID] : _characters);
+    }
+
+    //0 for names that do not exist
+    inline unsigned GetNameLength( const unsigned nameID ) const {
+        return (nameID < _numberOfNames ? _offsets[nameID+1] - _offsets[nameID] : 0);
+    }
+
+    inline std::string GetName( const unsigned nameID ) const {
+        return std::string(GetNameData(nameID), GetNameLength(nameID));
+    }
+
+    void ApplyResidencyPolicy( const ResidencyPolicy & policy ) const {
+        policy.Apply(_offsets, (std::size_t) (_numberOfNames+1)*sizeof(unsigned), "name offsets");
+        policy.Apply(_characters, _offsets[_numberOfNames], "name characters");
+    }
+
+private:
+    enum SectionID {
+        OFFSETS_SECTION = 0,
+        CHARACTERS_SECTION,
+        NUMBER_OF_SECTIONS
+    };
+
+    void UseContainer() {
+        const unsigned long long sizeOfOffsets = _container->GetSectionSize(OFFSETS_SECTION);
+        if(0 == sizeOfOffsets || 0 != sizeOfOffsets%sizeof(unsigned)) {
+            throw std::runtime_error("offsets of the name table have an unexpected size");
+        }
+        _offsets = reinterpret_cast<const unsigned *>(_container->GetSection(OFFSETS_SECTION));
+        _numberOfNames = sizeOfOffsets/sizeof(unsigned) - 1;
+        if(_offsets[_numberOfNames] > _container->GetSectionSize(CHARACTERS_SECTION)) {
+            throw std::runtime_error("offsets of the name table point past its characters");
+        }
+        _characters = _container->GetSection(CHARACTERS_SECTION);
+    }
+
+    //the old layout is the number of names, followed by the length and the characters of each name
+    void ConvertOldLayout( const char * data, const std::size_t size ) {
+        unsigned numberOfNames = 0;
+        std::size_t position = 0;
+        if(size >= sizeof(unsigned)) {
+            memcpy(&numberOfNames, data, sizeof(unsigned));
+            position += sizeof(unsigned);
+        }
+        _offsetStorage.reserve(std::min<std::size_t>(numberOfNames, size/sizeof(unsigned)) + 1);
+        _characterStorage.reserve(size + 1);
+        _offsetStorage.push_back(0);
+        for(unsigned i = 0; i < numberOfNames && position + sizeof(unsigned) <= size; ++i) {
+            unsigned sizeOfString = 0;
+            memcpy(&sizeOfString, data + position, sizeof(unsigned));
+            position += sizeof(unsigned);
+            sizeOfString = std::min<std::size_t>(sizeOfString, size - position);
+            _characterStorage.insert(_characterStorage.end(), data + position, data + position + sizeOfString);
+            _offsetStorage.push_back(_characterStorage.size());
+            position += sizeOfString;
+        }
+        //never empty, so that the pointers below are valid
+        _characterStorage.push_back(0);
+        _numberOfNames = _offsetStorage.size() - 1;
+        _offsets = &_offsetStorage[0];
+        _characters = &_characterStorage[0];
+    }
+
+    //point either into the storage vectors or into the container
+    const unsigned * _offsets;
+    const char * _characters;
+    unsigned _numberOfNames;
+
+    std::vector<unsigned> _offsetStorage;
+    std::vector<char> _characterStorage;
+    boost::scoped_ptr<ContainerFile> _container;
+};
+
+#endif /* NAMETABLE_H_ */
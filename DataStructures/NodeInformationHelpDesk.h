@@ -21,91 +21,197 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef NODEINFORMATIONHELPDESK_H_
 #define NODEINFORMATIONHELPDESK_H_
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include <boost/functional/hash.hpp>
+
 #include "../typedefs.h"
 #include "../DataStructures/QueryEdge.h"
+#include "ConcurrentLRUCache.h"
+#include "ContainerFile.h"
 #include "NNGrid.h"
+#include "OriginalEdgeTable.h"
 #include "PhantomNodes.h"
 #include "NodeCoords.h"
+#include "StaticRTree.h"
 
 class NodeInformationHelpDesk{
+    //coordinate quantized to the grid of the snapping cache
+    struct _SnappingKey {
+        _SnappingKey(const int la, const int lo, const bool i, const unsigned c) : lat(la), lon(lo), ignoreTinyComponents(i), checkSum(c) {}
+        int lat;
+        int lon;
+        bool ignoreTinyComponents;
+        unsigned checkSum;
+        bool operator==(const _SnappingKey & other) const {
+            return lat == other.lat && lon == other.lon && ignoreTinyComponents == other.ignoreTinyComponents && checkSum == other.checkSum;
+        }
+        friend std::size_t hash_value(const _SnappingKey & key) {
+            std::size_t seed = 0;
+            boost::hash_combine(seed, key.lat);
+            boost::hash_combine(seed, key.lon);
+            boost::hash_combine(seed, key.ignoreTinyComponents);
+            boost::hash_combine(seed, key.checkSum);
+            return seed;
+        }
+    };
+    typedef ConcurrentLRUCache<_SnappingKey, std::pair<bool, PhantomNode> > SnappingCache;
 public:
-    NodeInformationHelpDesk(const char* ramIndexInput, const char* fileIndexInput, const unsigned _numberOfNodes, const unsigned crc) : numberOfNodes(_numberOfNodes), checkSum(crc) {
-        readOnlyGrid = new ReadOnlyGrid(ramIndexInput,fileIndexInput);
-        assert(0 == coordinateVector.size());
+    //the nearest neighbor index is the r-tree if a file is given, the grid otherwise
+    NodeInformationHelpDesk(const std::string & rtreeInput, const char* ramIndexInput, const char* fileIndexInput, const unsigned _numberOfNodes, const unsigned crc) : originalEdgeTable(NULL), readOnlyGrid(NULL), rtree(NULL), rtreeFileName(rtreeInput), snappingCache(NULL), snappingGridSize(1), numberOfNodes(_numberOfNodes), checkSum(crc) {
+        if(rtreeFileName.empty()) {
+            readOnlyGrid = new ReadOnlyGrid(ramIndexInput,fileIndexInput);
+        }
     }
 
-    //Todo: Shared memory mechanism
-//    NodeInformationHelpDesk(const char* ramIndexInput, const char* fileIndexInput, const unsigned crc) : checkSum(crc) {
-//        readOnlyGrid = new ReadOnlyGrid(ramIndexInput,fileIndexInput);
-//    }
+    //uses data that is already in memory and outlives the help desk, e.g. in shared memory. The grid is used if there is no r-tree.
+    NodeInformationHelpDesk(const char * edges, const std::size_t sizeOfEdges, const char * rtreeData, const std::size_t sizeOfRTree, const unsigned long * ramIndex, const char * fileIndex, const std::size_t sizeOfFileIndex, const unsigned _numberOfNodes, const unsigned crc) : readOnlyGrid(NULL), rtree(NULL), snappingCache(NULL), snappingGridSize(1), numberOfNodes(_numberOfNodes), checkSum(crc) {
+        originalEdgeTable = new OriginalEdgeTable(edges, sizeOfEdges);
+        if(0 != sizeOfRTree) {
+            rtree = new StaticRTree(rtreeData, sizeOfRTree);
+        } else {
+            readOnlyGrid = new ReadOnlyGrid(ramIndex, fileIndex, sizeOfFileIndex);
+        }
+    }
 
 	~NodeInformationHelpDesk() {
 		delete readOnlyGrid;
+		delete rtree;
+		delete snappingCache;
+		delete originalEdgeTable;
 	}
-	void initNNGrid(std::ifstream& nodesInstream, std::ifstream& edgesInStream) {
-	    DEBUG("Loading node data");
-		NodeInfo b;
-	    while(!nodesInstream.eof()) {
-			nodesInstream.read((char *)&b, sizeof(NodeInfo));
-			coordinateVector.push_back(_Coordinate(b.lat, b.lon));
-		}
-	    std::vector<_Coordinate>(coordinateVector).swap(coordinateVector);
-	    nodesInstream.close();
 
-        DEBUG("Loading edge data");
-        unsigned numberOfOrigEdges(0);
-        edgesInStream.read((char*)&numberOfOrigEdges, sizeof(unsigned));
-        origEdgeData.resize(numberOfOrigEdges);
-        edgesInStream.read((char*)&(origEdgeData[0]), numberOfOrigEdges*sizeof(OriginalEdgeData));
-        edgesInStream.close();
-        DEBUG("Loaded " << numberOfOrigEdges << " orig edges");
-	    DEBUG("Opening NN indices");
-	    readOnlyGrid->OpenIndexFiles();
+	//Coordinates that fall into the same cell of a grid with the given size are snapped only once.
+	//The grid size is given in 1e-5 degrees, i.e. a grid size of 1 caches exact coordinates.
+	void EnableSnappingCache(const unsigned numberOfEntries, const int gridSize) {
+	    delete snappingCache;
+	    snappingCache = new SnappingCache(numberOfEntries);
+	    snappingGridSize = std::max(gridSize, 1);
+	}
+	//maps the original edges. Files of earlier versions are compressed while they are read, which
+	//needs the coordinates of the nodes. Throws std::runtime_error if a file is damaged or of another kind.
+	void LoadOriginalEdges(const char * edgesFileName, const char * nodesFileName) {
+	    if(ContainerFile::IsContainerFile(edgesFileName) && ContainerFile(edgesFileName, ContainerFormat::EDGES_FILE).HasSection(ContainerFormat::EDGE_LINES_SECTION)) {
+	        originalEdgeTable = new OriginalEdgeTable(edgesFileName);
+	        DEBUG("Mapped " << originalEdgeTable->GetNumberOfEdges() << " orig edges");
+	        return;
+	    }
+	    INFO(edgesFileName << " is in an old format and is compressed while loading, rerun osrm-prepare for faster startup");
+	    std::vector<_Coordinate> coordinates;
+	    std::vector<OriginalEdgeData> originalEdges;
+	    ReadCoordinates(nodesFileName, coordinates);
+	    ReadOriginalEdges(edgesFileName, originalEdges);
+	    originalEdgeTable = new OriginalEdgeTable(coordinates, originalEdges);
+	    DEBUG("Compressed " << originalEdgeTable->GetNumberOfEdges() << " orig edges");
 	}
 
+	//maps the r-tree or opens the files of the grid, throws std::runtime_error if the r-tree is damaged
 	void initNNGrid() {
-	    readOnlyGrid->OpenIndexFiles();
+	    if(NULL != readOnlyGrid) {
+	        readOnlyGrid->OpenIndexFiles();
+	    } else {
+	        rtree = new StaticRTree(rtreeFileName.c_str());
+	    }
+	}
+
+	//true for data without an r-tree, which is searched with the grid
+	inline bool UsesGrid() const {
+	    return NULL != readOnlyGrid;
+	}
+
+	//decoded cells of the grid are kept up to the given number of bytes, the r-tree needs no cache
+	void EnableGridCache(const std::size_t budgetInBytes) {
+	    if(NULL != readOnlyGrid) {
+	        readOnlyGrid->EnableBucketCache(budgetInBytes);
+	    }
+	}
+
+	void ApplyResidencyPolicies(const ResidencyPolicy & originalEdgesPolicy, const ResidencyPolicy & indexPolicy) const {
+	    originalEdgeTable->ApplyResidencyPolicy(originalEdgesPolicy);
+	    if(NULL != rtree) {
+	        rtree->ApplyResidencyPolicy(indexPolicy);
+	    } else {
+	        readOnlyGrid->ApplyResidencyPolicy(indexPolicy);
+	    }
 	}
 
 	inline int getLatitudeOfNode(const unsigned id) const {
-	    const NodeID node = origEdgeData.at(id).viaNode;
-	    return coordinateVector.at(node).lat;
+	    _Coordinate result;
+	    originalEdgeTable->GetCoordinate(id, result);
+	    return result.lat;
 	}
 
 	inline int getLongitudeOfNode(const unsigned id) const {
-        const NodeID node = origEdgeData.at(id).viaNode;
-	    return coordinateVector.at(node).lon;
+	    _Coordinate result;
+	    originalEdgeTable->GetCoordinate(id, result);
+	    return result.lon;
+	}
+
+	//coordinate of the node that an original edge passes
+	inline void GetCoordinateOfEdge(const unsigned id, _Coordinate & result) const {
+	    originalEdgeTable->GetCoordinate(id, result);
 	}
 
 	inline unsigned getNameIndexFromEdgeID(const unsigned id) const {
-	    return origEdgeData.at(id).nameID;
+	    return originalEdgeTable->GetNameID(id);
 	}
 
     inline short getTurnInstructionFromEdgeID(const unsigned id) const {
-        return origEdgeData.at(id).turnInstruction;
+        return originalEdgeTable->GetTurnInstruction(id);
     }
 
     inline NodeID getNumberOfNodes() const { return numberOfNodes; }
-	inline NodeID getNumberOfNodes2() const { return coordinateVector.size(); }
 
 	inline bool FindNearestNodeCoordForLatLon(const _Coordinate& coord, _Coordinate& result) const {
+		if(NULL != rtree) {
+		    return rtree->FindNearestCoordinateOnEdgeInNodeBasedGraph(coord, result);
+		}
 		return readOnlyGrid->FindNearestCoordinateOnEdgeInNodeBasedGraph(coord, result);
 	}
 
 	inline bool FindPhantomNodeForCoordinate( const _Coordinate & location, PhantomNode & resultNode, const unsigned zoomLevel) const {
-	    return readOnlyGrid->FindPhantomNodeForCoordinate(location, resultNode, zoomLevel);
+	    if(NULL == snappingCache) {
+	        return SnapToIndex(location, resultNode, zoomLevel);
+	    }
+	    //same flag as in the indexes
+	    const _SnappingKey key(QuantizeToSnappingGrid(location.lat), QuantizeToSnappingGrid(location.lon), (zoomLevel <= 14), checkSum);
+	    std::pair<bool, PhantomNode> cachedResult;
+	    if(!snappingCache->Fetch(key, cachedResult)) {
+	        cachedResult.first = SnapToIndex(location, cachedResult.second, zoomLevel);
+	        snappingCache->Insert(key, cachedResult);
+	    }
+	    resultNode = cachedResult.second;
+	    return cachedResult.first;
+	}
+
+	//ranked candidates around a location in one search of the index, the snapping cache only holds single results
+	inline void FindNearestPhantomNodes(const _Coordinate & location, const unsigned maxNumberOfResults, const double maxDistance, const unsigned zoomLevel, std::vector<PhantomNodeCandidate> & result) const {
+	    if(NULL != rtree) {
+	        rtree->FindNearestPhantomNodes(location, maxNumberOfResults, maxDistance, zoomLevel, result);
+	    } else {
+	        readOnlyGrid->FindNearestPhantomNodes(location, maxNumberOfResults, maxDistance, zoomLevel, result);
+	    }
 	}
 
 	inline void FindRoutingStarts(const _Coordinate &start, const _Coordinate &target, PhantomNodes & phantomNodes, const unsigned zoomLevel) const {
-		readOnlyGrid->FindRoutingStarts(start, target, phantomNodes, zoomLevel);
+		if(NULL != rtree) {
+		    rtree->FindRoutingStarts(start, target, phantomNodes, zoomLevel);
+		} else {
+		    readOnlyGrid->FindRoutingStarts(start, target, phantomNodes, zoomLevel);
+		}
 	}
 
 	inline void FindNearestPointOnEdge(const _Coordinate & input, _Coordinate& output){
-	    readOnlyGrid->FindNearestPointOnEdge(input, output);
+	    if(NULL != rtree) {
+	        rtree->FindNearestPointOnEdge(input, output);
+	    } else {
+	        readOnlyGrid->FindNearestPointOnEdge(input, output);
+	    }
 	}
 
 	inline unsigned GetCheckSum() const {
@@ -113,10 +219,77 @@ public:
 	}
 
 private:
-	std::vector<_Coordinate> coordinateVector;
-    std::vector<OriginalEdgeData> origEdgeData;
+	static const unsigned NODES_PER_READ = 65536;
+
+	inline bool SnapToIndex(const _Coordinate & location, PhantomNode & resultNode, const unsigned zoomLevel) const {
+	    if(NULL != rtree) {
+	        return rtree->FindPhantomNodeForCoordinate(location, resultNode, zoomLevel);
+	    }
+	    return readOnlyGrid->FindPhantomNodeForCoordinate(location, resultNode, zoomLevel);
+	}
+
+	inline int QuantizeToSnappingGrid(const int value) const {
+	    return (value >= 0 ? value/snappingGridSize : (value - snappingGridSize + 1)/snappingGridSize);
+	}
+
+	//only the coordinates of the nodes are kept, old files are read in large chunks
+	static void ReadCoordinates(const char * nodesFileName, std::vector<_Coordinate> & coordinates) {
+	    if(ContainerFile::IsContainerFile(nodesFileName)) {
+	        ContainerFile nodesFile(nodesFileName, ContainerFormat::NODES_FILE);
+	        nodesFile.VerifySection(ContainerFormat::COORDINATES_SECTION);
+	        const _Coordinate * begin = reinterpret_cast<const _Coordinate *>(nodesFile.GetSection(ContainerFormat::COORDINATES_SECTION));
+	        coordinates.assign(begin, begin + nodesFile.GetSectionSize(ContainerFormat::COORDINATES_SECTION)/sizeof(_Coordinate));
+	        return;
+	    }
+	    DEBUG("Loading node data");
+	    std::ifstream nodesInStream(nodesFileName, std::ios::binary);
+	    nodesInStream.seekg(0, std::ios::end);
+	    const std::streamoff sizeOfFile = nodesInStream.tellg();
+	    nodesInStream.seekg(0, std::ios::beg);
+	    const unsigned numberOfNodeInfos = (0 < sizeOfFile ? sizeOfFile/sizeof(NodeInfo) : 0);
+	    coordinates.resize(numberOfNodeInfos);
+	    std::vector<NodeInfo> buffer(std::min(numberOfNodeInfos, (unsigned) NODES_PER_READ));
+	    for(unsigned i = 0; i < numberOfNodeInfos; i += buffer.size()) {
+	        const unsigned numberOfNodesInChunk = std::min<unsigned>(buffer.size(), numberOfNodeInfos - i);
+	        nodesInStream.read((char *)&buffer[0], numberOfNodesInChunk*sizeof(NodeInfo));
+	        for(unsigned j = 0; j < numberOfNodesInChunk; ++j) {
+	            coordinates[i+j] = _Coordinate(buffer[j].lat, buffer[j].lon);
+	        }
+	    }
+	    nodesInStream.close();
+	}
+
+	static void ReadOriginalEdges(const char * edgesFileName, std::vector<OriginalEdgeData> & originalEdges) {
+	    if(ContainerFile::IsContainerFile(edgesFileName)) {
+	        ContainerFile edgesFile(edgesFileName, ContainerFormat::EDGES_FILE);
+	        edgesFile.VerifySection(ContainerFormat::ORIGINAL_EDGES_SECTION);
+	        const OriginalEdgeData * begin = reinterpret_cast<const OriginalEdgeData *>(edgesFile.GetSection(ContainerFormat::ORIGINAL_EDGES_SECTION));
+	        originalEdges.assign(begin, begin + edgesFile.GetSectionSize(ContainerFormat::ORIGINAL_EDGES_SECTION)/sizeof(OriginalEdgeData));
+	        return;
+	    }
+        DEBUG("Loading edge data");
+        std::ifstream edgesInStream(edgesFileName, std::ios::binary);
+        unsigned numberOfOrigEdges(0);
+        edgesInStream.read((char*)&numberOfOrigEdges, sizeof(unsigned));
+        //the header may count more entries than the file holds
+        const std::streamoff positionOfEdges = edgesInStream.tellg();
+        edgesInStream.seekg(0, std::ios::end);
+        const std::streamoff sizeOfFile = edgesInStream.tellg();
+        edgesInStream.seekg(positionOfEdges);
+        numberOfOrigEdges = (0 < positionOfEdges ? std::min<std::streamoff>(numberOfOrigEdges, (sizeOfFile - positionOfEdges)/sizeof(OriginalEdgeData)) : 0);
+        originalEdges.resize(numberOfOrigEdges);
+        if(numberOfOrigEdges) {
+            edgesInStream.read((char*)&(originalEdges[0]), numberOfOrigEdges*sizeof(OriginalEdgeData));
+        }
+        edgesInStream.close();
+	}
 
+	OriginalEdgeTable * originalEdgeTable;
 	ReadOnlyGrid * readOnlyGrid;
+	StaticRTree * rtree;
+	std::string rtreeFileName;
+	SnappingCache * snappingCache;
+	int snappingGridSize;
 	const unsigned numberOfNodes;
 	const unsigned checkSum;
 };
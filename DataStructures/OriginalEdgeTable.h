@@ -0,0 +1,241 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef ORIGINALEDGETABLE_H_
+#define ORIGINALEDGETABLE_H_
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/static_assert.hpp>
+
+#include "../typedefs.h"
+#include "../Util/ResidencyPolicy.h"
+#include "ContainerFile.h"
+#include "Coordinate.h"
+#include "QueryEdge.h"
+
+/*
+ * What the description of a route needs of each original edge: the
+ * coordinate of the node that it passes, the id of its street name and its
+ * turn instruction. The coordinate is stored with the edge, so that no node
+ * array is needed. The edges are grouped into lines of one cache line each,
+ * which hold the coordinate of their first edge, 16 bit deltas to the other
+ * coordinates and the name id of each edge packed with its turn instruction.
+ * All data of an edge is read with a single cache access. Edges that do not
+ * fit, e.g. long ferry edges, are kept in a side array sorted by edge id.
+ */
+class OriginalEdgeTable : private boost::noncopyable {
+public:
+    static const unsigned EDGES_PER_LINE = 7;
+
+    struct _StrLine {
+        int lat;
+        int lon;
+        short latDelta[EDGES_PER_LINE];
+        short lonDelta[EDGES_PER_LINE];
+        //name id in the upper 24 bits, turn instruction in the lower 8 bits
+        unsigned nameAndTurn[EDGES_PER_LINE];
+    };
+    BOOST_STATIC_ASSERT(64 == sizeof(_StrLine));
+
+    struct _StrException {
+        unsigned edge;
+        int lat;
+        int lon;
+        unsigned nameID;
+        int turnInstruction;
+        bool operator<(const _StrException & other) const {
+            return edge < other.edge;
+        }
+    };
+
+    //streams the table into a .edges file while the edges are generated
+    class Writer : private boost::noncopyable {
+    public:
+        explicit Writer( const char * fileName ) : _writer(fileName, ContainerFormat::EDGES_FILE, 3), _numberOfEdges(0) {
+            _writer.BeginSection(ContainerFormat::EDGE_LINES_SECTION);
+        }
+
+        void Add( const _Coordinate & location, const unsigned nameID, const short turnInstruction ) {
+            AddEdge(_numberOfEdges, location, nameID, turnInstruction, _line, _exceptions);
+            if(0 == ++_numberOfEdges%EDGES_PER_LINE) {
+                _writer.Write((char *) &_line, sizeof(_StrLine));
+            }
+        }
+
+        void Close() {
+            if(0 != _numberOfEdges%EDGES_PER_LINE) {
+                _writer.Write((char *) &_line, sizeof(_StrLine));
+            }
+            _writer.EndSection();
+            _writer.WriteSection(ContainerFormat::EDGE_EXCEPTIONS_SECTION, (char *) (_exceptions.empty() ? NULL : &_exceptions[0]), _exceptions.size()*sizeof(_StrException));
+            _writer.WriteSection(ContainerFormat::EDGE_COUNT_SECTION, (char *) &_numberOfEdges, sizeof(unsigned));
+            _writer.Close();
+            INFO("wrote " << _numberOfEdges << " original edges, " << _exceptions.size() << " of them uncompressed");
+        }
+
+    private:
+        ContainerFileWriter _writer;
+        _StrLine _line;
+        std::vector<_StrException> _exceptions;
+        unsigned _numberOfEdges;
+    };
+
+    //maps a .edges file and verifies its checksums
+    explicit OriginalEdgeTable( const char * fileName ) {
+        _container.reset(new ContainerFile(fileName, ContainerFormat::EDGES_FILE));
+        _container->VerifyAllSections();
+        UseContainer();
+    }
+
+    //uses a .edges file that is already in memory and outlives the table, e.g. in shared memory
+    OriginalEdgeTable( const char * memory, const std::size_t size ) {
+        _container.reset(new ContainerFile(memory, size, ContainerFormat::EDGES_FILE, "original edge data"));
+        UseContainer();
+    }
+
+    //compresses the original edges of files in older formats, coordinates are indexed by node
+    OriginalEdgeTable( const std::vector<_Coordinate> & coordinates, const std::vector<OriginalEdgeData> & originalEdges ) {
+        _numberOfEdges = originalEdges.size();
+        const unsigned numberOfLines = (_numberOfEdges + EDGES_PER_LINE - 1)/EDGES_PER_LINE;
+        //one spare line to align the lines to a cache line
+        _lineStorage.resize(numberOfLines + 1);
+        _lines = reinterpret_cast<const _StrLine *>(((std::size_t) &_lineStorage[0] + sizeof(_StrLine) - 1)/sizeof(_StrLine)*sizeof(_StrLine));
+        _StrLine * lines = const_cast<_StrLine *>(_lines);
+        for(unsigned i = 0; i < _numberOfEdges; ++i) {
+            const NodeID node = originalEdges[i].viaNode;
+            const _Coordinate location = (node < coordinates.size() ? coordinates[node] : _Coordinate());
+            AddEdge(i, location, originalEdges[i].nameID, originalEdges[i].turnInstruction, lines[i/EDGES_PER_LINE], _exceptionStorage);
+        }
+        _exceptions = (_exceptionStorage.empty() ? NULL : &_exceptionStorage[0]);
+        _numberOfExceptions = _exceptionStorage.size();
+    }
+
+    inline unsigned GetNumberOfEdges() const {
+        return _numberOfEdges;
+    }
+
+    //bounds checked like std::vector::at()
+    inline void GetCoordinate( const unsigned edge, _Coordinate & result ) const {
+        const _StrLine & line = GetLine(edge);
+        const unsigned slot = edge%EDGES_PER_LINE;
+        if(EXCEPTION == line.nameAndTurn[slot]) {
+            const _StrException & exception = GetException(edge);
+            result.lat = exception.lat;
+            result.lon = exception.lon;
+            return;
+        }
+        result.lat = line.lat + line.latDelta[slot];
+        result.lon = line.lon + line.lonDelta[slot];
+    }
+
+    inline unsigned GetNameID( const unsigned edge ) const {
+        const unsigned nameAndTurn = GetLine(edge).nameAndTurn[edge%EDGES_PER_LINE];
+        return (EXCEPTION == nameAndTurn ? GetException(edge).nameID : nameAndTurn >> 8);
+    }
+
+    inline short GetTurnInstruction( const unsigned edge ) const {
+        const unsigned nameAndTurn = GetLine(edge).nameAndTurn[edge%EDGES_PER_LINE];
+        return (EXCEPTION == nameAndTurn ? GetException(edge).turnInstruction : nameAndTurn & 0xff);
+    }
+
+    void ApplyResidencyPolicy( const ResidencyPolicy & policy ) const {
+        policy.Apply(_lines, (std::size_t) (_numberOfEdges + EDGES_PER_LINE - 1)/EDGES_PER_LINE*sizeof(_StrLine), "original edges");
+        policy.Apply(_exceptions, (std::size_t) _numberOfExceptions*sizeof(_StrException), "uncompressed original edges");
+    }
+
+private:
+    //marks an edge that is kept in the side array, no name id or turn instruction that fits packs to it
+    static const unsigned EXCEPTION = UINT_MAX;
+    static const unsigned MAX_PACKED_NAME_ID = 0xfffffe;
+
+    static void AddEdge( const unsigned edge, const _Coordinate & location, const unsigned nameID, const short turnInstruction, _StrLine & line, std::vector<_StrException> & exceptions ) {
+        const unsigned slot = edge%EDGES_PER_LINE;
+        if(0 == slot) {
+            memset(&line, 0, sizeof(_StrLine));
+            line.lat = location.lat;
+            line.lon = location.lon;
+        }
+        const long long latDelta = (long long) location.lat - line.lat;
+        const long long lonDelta = (long long) location.lon - line.lon;
+        if(-SHRT_MAX > latDelta || SHRT_MAX < latDelta || -SHRT_MAX > lonDelta || SHRT_MAX < lonDelta || MAX_PACKED_NAME_ID < nameID || 0 > turnInstruction || 0xff < turnInstruction) {
+            _StrException exception;
+            exception.edge = edge;
+            exception.lat = location.lat;
+            exception.lon = location.lon;
+            exception.nameID = nameID;
+            exception.turnInstruction = turnInstruction;
+            exceptions.push_back(exception);
+            line.nameAndTurn[slot] = EXCEPTION;
+            return;
+        }
+        line.latDelta[slot] = latDelta;
+        line.lonDelta[slot] = lonDelta;
+        line.nameAndTurn[slot] = (nameID << 8) | turnInstruction;
+    }
+
+    void UseContainer() {
+        if(sizeof(unsigned) != _container->GetSectionSize(ContainerFormat::EDGE_COUNT_SECTION)) {
+            throw std::runtime_error("number of original edges has an unexpected size");
+        }
+        memcpy(&_numberOfEdges, _container->GetSection(ContainerFormat::EDGE_COUNT_SECTION), sizeof(unsigned));
+        const unsigned long long numberOfLines = ((unsigned long long) _numberOfEdges + EDGES_PER_LINE - 1)/EDGES_PER_LINE;
+        if(numberOfLines*sizeof(_StrLine) != _container->GetSectionSize(ContainerFormat::EDGE_LINES_SECTION) ||
+                0 != _container->GetSectionSize(ContainerFormat::EDGE_EXCEPTIONS_SECTION)%sizeof(_StrException)) {
+            throw std::runtime_error("sections of the original edge data do not match their number");
+        }
+        _lines = reinterpret_cast<const _StrLine *>(_container->GetSection(ContainerFormat::EDGE_LINES_SECTION));
+        _exceptions = reinterpret_cast<const _StrException *>(_container->GetSection(ContainerFormat::EDGE_EXCEPTIONS_SECTION));
+        _numberOfExceptions = _container->GetSectionSize(ContainerFormat::EDGE_EXCEPTIONS_SECTION)/sizeof(_StrException);
+    }
+
+    inline const _StrLine & GetLine( const unsigned edge ) const {
+        if(edge >= _numberOfEdges)
+            throw std::out_of_range("edge id out of range");
+        return _lines[edge/EDGES_PER_LINE];
+    }
+
+    inline const _StrException & GetException( const unsigned edge ) const {
+        _StrException key;
+        key.edge = edge;
+        const _StrException * exception = std::lower_bound(_exceptions, _exceptions + _numberOfExceptions, key);
+        if(exception == _exceptions + _numberOfExceptions || edge != exception->edge)
+            throw std::runtime_error("original edge data is damaged");
+        return *exception;
+    }
+
+    //point either into the storage vectors or into the container
+    const _StrLine * _lines;
+    const _StrException * _exceptions;
+    unsigned _numberOfEdges;
+    unsigned _numberOfExceptions;
+
+    std::vector<_StrLine> _lineStorage;
+    std::vector<_StrException> _exceptionStorage;
+    boost::scoped_ptr<ContainerFile> _container;
+};
+
+#endif /* ORIGINALEDGETABLE_H_ */
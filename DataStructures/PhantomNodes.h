@@ -77,6 +77,13 @@ inline std::ostream& operator<<(std::ostream &out, const PhantomNode & pn){
     return out;
 }
 
+//result of a nearest neighbor query, the distance is in meters from the queried coordinate
+struct PhantomNodeCandidate {
+    PhantomNodeCandidate(const PhantomNode & n, const double d) : phantomNode(n), distance(d) {}
+    PhantomNode phantomNode;
+    double distance;
+};
+
 struct NodesOfEdge {
     NodeID edgeBasedNode;
     double ratio;
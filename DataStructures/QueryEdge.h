@@ -64,6 +64,17 @@ struct QueryEdge {
         return left.data.distance < right.data.distance;
     }
 
+    //sorts the edges of each source as forward only, bidirectional, backward only, see SplitStaticGraph
+    static bool CompareBySourceAndDirection( const QueryEdge& left, const QueryEdge& right ) {
+        if ( left.source != right.source )
+            return left.source < right.source;
+        int l = ( left.data.forward ? ( left.data.backward ? 1 : 0 ) : 2 );
+        int r = ( right.data.forward ? ( right.data.backward ? 1 : 0 ) : 2 );
+        if ( l != r )
+            return l < r;
+        return left.target < right.target;
+    }
+
     bool operator== ( const QueryEdge& right ) const {
         return ( source == right.source && target == right.target && data.distance == right.data.distance &&
                 data.shortcut == right.data.shortcut && data.forward == right.data.forward && data.backward == right.data.backward
@@ -28,10 +28,14 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <boost/thread.hpp>
 
 #include "BinaryHeap.h"
+#include "EdgeLengthTable.h"
+#include "NameTable.h"
 #include "NodeInformationHelpDesk.h"
 #include "PhantomNodes.h"
+#include "ShortcutUnpackingIndex.h"
 #include "../RoutingAlgorithms/AlternativePathRouting.h"
 #include "../RoutingAlgorithms/BasicRoutingInterface.h"
+#include "../RoutingAlgorithms/ManyToManyRouting.h"
 #include "../RoutingAlgorithms/ShortestPathRouting.h"
 
 #include "../Util/StringUtil.h"
@@ -42,16 +46,22 @@ struct _HeapData {
 	_HeapData( NodeID p ) : parent(p) { }
 };
 
-typedef boost::thread_specific_ptr<BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> > > SearchEngineHeapPtr;
+//typedef BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> > QueryHeapType;
+typedef BinaryHeap< NodeID, NodeID, int, _HeapData, TimestampedArrayStorage<NodeID, NodeID> > QueryHeapType;
+typedef boost::thread_specific_ptr<QueryHeapType> SearchEngineHeapPtr;
 
 template<class EdgeData, class GraphT>
 struct SearchEngineData {
     typedef SearchEngineHeapPtr HeapPtr;
     typedef GraphT Graph;
-    SearchEngineData(GraphT * g, NodeInformationHelpDesk * nh, std::vector<string> & n) :graph(g), nodeHelpDesk(nh), names(n) {}
+    SearchEngineData(GraphT * g, NodeInformationHelpDesk * nh, const NameTable & n, const ShortcutUnpackingIndex * ui = NULL, const EdgeLengthTable * elt = NULL) :graph(g), nodeHelpDesk(nh), names(n), unpackingIndex(ui), edgeLengthTable(elt) {}
     const GraphT * graph;
     NodeInformationHelpDesk * nodeHelpDesk;
-    std::vector<string> & names;
+    const NameTable & names;
+    //optional, shortcuts are unpacked by searching the adjacency of their end points without it
+    const ShortcutUnpackingIndex * unpackingIndex;
+    //optional, routes are unpacked to compute their length without it
+    const EdgeLengthTable * edgeLengthTable;
     static HeapPtr forwardHeap;
     static HeapPtr backwardHeap;
     static HeapPtr forwardHeap2;
@@ -60,45 +70,28 @@ struct SearchEngineData {
     static HeapPtr backwardHeap3;
 
     inline void InitializeOrClearFirstThreadLocalStorage() {
-        if(!forwardHeap.get()) {
-            forwardHeap.reset(new BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> >(nodeHelpDesk->getNumberOfNodes()));
-        }
-        else
-            forwardHeap->Clear();
-
-        if(!backwardHeap.get()) {
-            backwardHeap.reset(new BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> >(nodeHelpDesk->getNumberOfNodes()));
-        }
-        else
-            backwardHeap->Clear();
+        InitializeOrClearHeap(forwardHeap);
+        InitializeOrClearHeap(backwardHeap);
     }
 
     inline void InitializeOrClearSecondThreadLocalStorage() {
-        if(!forwardHeap2.get()) {
-            forwardHeap2.reset(new BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> >(nodeHelpDesk->getNumberOfNodes()));
-        }
-        else
-            forwardHeap2->Clear();
-
-        if(!backwardHeap2.get()) {
-            backwardHeap2.reset(new BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> >(nodeHelpDesk->getNumberOfNodes()));
-        }
-        else
-            backwardHeap2->Clear();
+        InitializeOrClearHeap(forwardHeap2);
+        InitializeOrClearHeap(backwardHeap2);
     }
 
     inline void InitializeOrClearThirdThreadLocalStorage() {
-        if(!forwardHeap3.get()) {
-            forwardHeap3.reset(new BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> >(nodeHelpDesk->getNumberOfNodes()));
-        }
-        else
-            forwardHeap3->Clear();
+        InitializeOrClearHeap(forwardHeap3);
+        InitializeOrClearHeap(backwardHeap3);
+    }
 
-        if(!backwardHeap3.get()) {
-            backwardHeap3.reset(new BinaryHeap< NodeID, NodeID, int, _HeapData, UnorderedMapStorage<NodeID, int> >(nodeHelpDesk->getNumberOfNodes()));
+private:
+    //the heaps are shared by all search engines of a thread and may have been built for a smaller dataset
+    inline void InitializeOrClearHeap(HeapPtr & heap) {
+        if(!heap.get() || heap->GetMaxID() < nodeHelpDesk->getNumberOfNodes()) {
+            heap.reset(new QueryHeapType(nodeHelpDesk->getNumberOfNodes()));
         }
         else
-            backwardHeap3->Clear();
+            heap->Clear();
     }
 };
 
@@ -112,17 +105,18 @@ private:
 public:
     ShortestPathRouting<SearchEngineDataT> shortestPath;
     AlternativeRouting<SearchEngineDataT> alternativePaths;
+    ManyToManyRouting<SearchEngineDataT> distanceTable;
 
-    SearchEngine(GraphT * g, NodeInformationHelpDesk * nh, std::vector<string> & n) :
-	    _queryData(g, nh, n),
+    SearchEngine(GraphT * g, NodeInformationHelpDesk * nh, const NameTable & n, const ShortcutUnpackingIndex * ui = NULL, const EdgeLengthTable * elt = NULL) :
+	    _queryData(g, nh, n, ui, elt),
 	    shortestPath(_queryData),
-	    alternativePaths(_queryData)
+	    alternativePaths(_queryData),
+	    distanceTable(_queryData)
 	{}
 	~SearchEngine() {}
 
 	inline const void GetCoordinatesForNodeID(NodeID id, _Coordinate& result) const {
-		result.lat = _queryData.nodeHelpDesk->getLatitudeOfNode(id);
-		result.lon = _queryData.nodeHelpDesk->getLongitudeOfNode(id);
+		_queryData.nodeHelpDesk->GetCoordinateOfEdge(id, result);
 	}
 
 	inline void FindRoutingStarts(const _Coordinate & start, const _Coordinate & target, PhantomNodes & routingStarts) const {
@@ -149,7 +143,12 @@ public:
 	}
 
 	inline std::string GetEscapedNameForNameID(const unsigned nameID) const {
-	    return ((nameID >= _queryData.names.size() || nameID == 0) ? std::string("") : HTMLEntitize(_queryData.names.at(nameID)));
+	    std::string result;
+	    if(0 != nameID) {
+	        const char * name = _queryData.names.GetNameData(nameID);
+	        HTMLEntitize(name, name + _queryData.names.GetNameLength(nameID), result);
+	    }
+	    return result;
 	}
 
 	inline std::string GetEscapedNameForEdgeBasedEdgeID(const unsigned edgeID) const {
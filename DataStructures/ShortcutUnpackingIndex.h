@@ -0,0 +1,119 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SHORTCUTUNPACKINGINDEX_H_
+#define SHORTCUTUNPACKINGINDEX_H_
+
+#include <cassert>
+#include <climits>
+#include <vector>
+
+#include "../Util/OpenMPWrapper.h"
+#include "../typedefs.h"
+
+/*
+ * Stores for each shortcut the two edges that it unpacks to, once for each
+ * direction in which the shortcut can be used. Unpacking a path then follows
+ * edge ids instead of scanning the adjacency of both end points on every level.
+ *
+ * Edges are referenced as (edge id << 1 | reversed), where reversed means that
+ * the edge is used from its target to the node it is stored at. This value is
+ * also the index of the halves of that edge in the index.
+ */
+class ShortcutUnpackingIndex {
+public:
+    struct _StrEdgeHalves {
+        EdgeID first;
+        EdgeID second;
+    };
+
+    static inline EdgeID GetEdgeID( const EdgeID edgeReference ) {
+        return edgeReference >> 1;
+    }
+
+    //finds the edge that is unpacked for the path segment (from,to), prefers edges stored at from
+    template<class GraphT>
+    static EdgeID FindPathEdge( const GraphT & graph, const NodeID from, const NodeID to ) {
+        EdgeID smallestEdge = SPECIAL_EDGEID;
+        int smallestWeight = INT_MAX;
+        for(typename GraphT::EdgeIterator eit = graph.BeginEdges(from); eit < graph.EndEdges(from); ++eit) {
+            const int weight = graph.GetEdgeData(eit).distance;
+            if(graph.GetTarget(eit) == to && weight < smallestWeight && graph.GetEdgeData(eit).forward) {
+                smallestEdge = eit << 1;
+                smallestWeight = weight;
+            }
+        }
+        if(SPECIAL_EDGEID == smallestEdge) {
+            for(typename GraphT::EdgeIterator eit = graph.BeginEdges(to); eit < graph.EndEdges(to); ++eit) {
+                const int weight = graph.GetEdgeData(eit).distance;
+                if(graph.GetTarget(eit) == from && weight < smallestWeight && graph.GetEdgeData(eit).backward) {
+                    smallestEdge = (eit << 1) | 1;
+                    smallestWeight = weight;
+                }
+            }
+        }
+        return smallestEdge;
+    }
+
+    template<class GraphT>
+    static void Build( const GraphT & graph, std::vector<_StrEdgeHalves> & halves ) {
+        _StrEdgeHalves noHalves;
+        noHalves.first = noHalves.second = SPECIAL_EDGEID;
+        halves.clear();
+        halves.resize(2*graph.GetNumberOfEdges(), noHalves);
+#pragma omp parallel for schedule ( guided )
+        for(int u = 0; u < (int)graph.GetNumberOfNodes(); ++u) {
+            for(typename GraphT::EdgeIterator eit = graph.BeginEdges(u); eit < graph.EndEdges(u); ++eit) {
+                const typename GraphT::EdgeData & data = graph.GetEdgeData(eit);
+                if(!data.shortcut) {
+                    continue;
+                }
+                const NodeID middle = data.id;
+                const NodeID v = graph.GetTarget(eit);
+                if(data.forward) {
+                    halves[eit << 1].first  = FindPathEdge(graph, u, middle);
+                    halves[eit << 1].second = FindPathEdge(graph, middle, v);
+                }
+                if(data.backward) {
+                    halves[(eit << 1) | 1].first  = FindPathEdge(graph, v, middle);
+                    halves[(eit << 1) | 1].second = FindPathEdge(graph, middle, u);
+                }
+            }
+        }
+    }
+
+    ShortcutUnpackingIndex( std::vector<_StrEdgeHalves> & halves ) {
+        _halves.swap(halves);
+    }
+
+    inline unsigned GetNumberOfEdges() const {
+        return _halves.size()/2;
+    }
+
+    inline const _StrEdgeHalves & GetHalves( const EdgeID edgeReference ) const {
+        assert( edgeReference < _halves.size() );
+        return _halves[edgeReference];
+    }
+
+private:
+    std::vector<_StrEdgeHalves> _halves;
+};
+
+#endif /* SHORTCUTUNPACKINGINDEX_H_ */
@@ -0,0 +1,326 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SPLITSTATICGRAPH_H_
+#define SPLITSTATICGRAPH_H_
+
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "ContainerFile.h"
+#include "../Util/ResidencyPolicy.h"
+#include "../typedefs.h"
+
+/*
+ * Query graph with the same interface as StaticGraph, but with the edges of each
+ * node ordered as [forward only][bidirectional][backward only] and with targets,
+ * weights and remaining edge data in separate arrays. The edges that are usable
+ * in one search direction form a contiguous range, so the search reads only
+ * targets and weights and never branches on the direction flags.
+ *
+ * osrm-prepare writes the edges in this order. Other input is reordered on
+ * construction, which changes edge ids (see EdgesWereReordered()).
+ *
+ * The arrays can also be written as sections of a container file (see
+ * WriteContainer()). A graph in this form is not copied at all, but used
+ * directly from the read-only mapped file, so that its pages are shared with
+ * the page cache and with other processes.
+ */
+template< typename EdgeDataT>
+class SplitStaticGraph {
+public:
+    typedef NodeID NodeIterator;
+    typedef NodeID EdgeIterator;
+    typedef EdgeDataT EdgeData;
+    class InputEdge {
+    public:
+        EdgeDataT data;
+        NodeIterator source;
+        NodeIterator target;
+        bool operator<( const InputEdge& right ) const {
+            if ( source != right.source )
+                return source < right.source;
+            return target < right.target;
+        }
+    };
+
+    //serialized format, same as StaticGraph
+    struct _StrNode {
+        //index of the first edge
+        EdgeIterator firstEdge;
+    };
+
+    struct _StrEdge {
+        NodeID target;
+        EdgeDataT data;
+    };
+
+    SplitStaticGraph( std::vector<_StrNode> & nodes, std::vector<_StrEdge> & edges) : _edgesWereReordered(false) {
+        _numNodes = nodes.size();
+        _numEdges = edges.size();
+
+        _nodeStorage.resize(_numNodes+1);
+        _targetStorage.resize(_numEdges);
+        _weightStorage.resize(_numEdges);
+        _edgeDataStorage.resize(_numEdges);
+
+        EdgeIterator position = 0;
+        for(NodeIterator node = 0; node < _numNodes; ++node) {
+            const EdgeIterator begin = nodes[node].firstEdge;
+            //the last node of the serialized format may point before its predecessor
+            const EdgeIterator end = (node+1 < _numNodes && nodes[node+1].firstEdge > begin ? nodes[node+1].firstEdge : begin);
+
+            _nodeStorage[node].firstEdge = position;
+            for(unsigned directionClass = 0; directionClass < 3; ++directionClass) {
+                if(1 == directionClass)
+                    _nodeStorage[node].firstBidirectionalEdge = position;
+                if(2 == directionClass)
+                    _nodeStorage[node].firstBackwardOnlyEdge = position;
+                for(EdgeIterator edge = begin; edge < end; ++edge) {
+                    const EdgeDataT & data = edges[edge].data;
+                    assert(data.forward || data.backward);
+                    if(GetDirectionClass(data) != directionClass)
+                        continue;
+                    _edgesWereReordered |= (edge != position - _nodeStorage[node].firstEdge + begin);
+                    _targetStorage[position] = edges[edge].target;
+                    _weightStorage[position] = data.distance;
+                    _edgeDataStorage[position] = data;
+                    ++position;
+                }
+            }
+        }
+        assert(position == _numEdges);
+        _nodeStorage[_numNodes].firstEdge = _nodeStorage[_numNodes].firstBidirectionalEdge = _nodeStorage[_numNodes].firstBackwardOnlyEdge = position;
+
+        _nodes = &_nodeStorage[0];
+        _targets = (_numEdges ? &_targetStorage[0] : NULL);
+        _weights = (_numEdges ? &_weightStorage[0] : NULL);
+        _edgeData = (_numEdges ? &_edgeDataStorage[0] : NULL);
+
+        std::vector<_StrNode>().swap(nodes);
+        std::vector<_StrEdge>().swap(edges);
+    }
+
+    //maps a file that was written by WriteContainer() and verifies its checksums
+    SplitStaticGraph( const char * fileName, unsigned * checkSum ) {
+        _container.reset(new ContainerFile(fileName, ContainerFormat::GRAPH_FILE));
+        _container->VerifyAllSections();
+        UseContainer(checkSum);
+    }
+
+    //uses a container that is already in memory and outlives the graph, e.g. in shared memory
+    SplitStaticGraph( const char * memory, const std::size_t size, unsigned * checkSum ) {
+        _container.reset(new ContainerFile(memory, size, ContainerFormat::GRAPH_FILE, "graph data"));
+        UseContainer(checkSum);
+    }
+
+    //writes the arrays as they are in memory, each one into a section of its own
+    void WriteContainer( const char * fileName, const unsigned checkSum ) const {
+        _StrGraphProperties properties;
+        properties.checkSum = checkSum;
+        properties.numberOfNodes = _numNodes;
+        properties.numberOfEdges = _numEdges;
+        properties.sizeOfEdgeData = sizeof(EdgeDataT);
+        properties.edgesWereReordered = _edgesWereReordered;
+
+        ContainerFileWriter writer(fileName, ContainerFormat::GRAPH_FILE, NUMBER_OF_SECTIONS);
+        writer.WriteSection(PROPERTIES_SECTION, (const char *) &properties, sizeof(_StrGraphProperties));
+        writer.WriteSection(NODES_SECTION, (const char *) _nodes, (_numNodes+1)*sizeof(_StrSplitNode));
+        writer.WriteSection(TARGETS_SECTION, (const char *) _targets, _numEdges*sizeof(NodeID));
+        writer.WriteSection(WEIGHTS_SECTION, (const char *) _weights, _numEdges*sizeof(int));
+        writer.WriteSection(EDGE_DATA_SECTION, (const char *) _edgeData, _numEdges*sizeof(EdgeDataT));
+        writer.Close();
+    }
+
+    unsigned GetNumberOfNodes() const {
+        return _numNodes;
+    }
+
+    unsigned GetNumberOfEdges() const {
+        return _numEdges;
+    }
+
+    unsigned GetOutDegree( const NodeIterator &n ) const {
+        return EndEdges(n)-BeginEdges(n);
+    }
+
+    inline NodeIterator GetTarget( const EdgeIterator &e ) const {
+        return _targets[e];
+    }
+
+    inline int GetWeight( const EdgeIterator &e ) const {
+        return _weights[e];
+    }
+
+    inline const EdgeDataT &GetEdgeData( const EdgeIterator &e ) const {
+        return _edgeData[e];
+    }
+
+    inline EdgeIterator BeginEdges( const NodeIterator &n ) const {
+        return _nodes[n].firstEdge;
+    }
+
+    inline EdgeIterator EndEdges( const NodeIterator &n ) const {
+        return _nodes[n+1].firstEdge;
+    }
+
+    //edges that are usable in the forward search
+    inline EdgeIterator BeginForwardEdges( const NodeIterator &n ) const {
+        return _nodes[n].firstEdge;
+    }
+
+    inline EdgeIterator EndForwardEdges( const NodeIterator &n ) const {
+        return _nodes[n].firstBackwardOnlyEdge;
+    }
+
+    //edges that are usable in the backward search
+    inline EdgeIterator BeginBackwardEdges( const NodeIterator &n ) const {
+        return _nodes[n].firstBidirectionalEdge;
+    }
+
+    inline EdgeIterator EndBackwardEdges( const NodeIterator &n ) const {
+        return _nodes[n+1].firstEdge;
+    }
+
+    //fetches the adjacency of a node into the cache ahead of its relaxation
+    inline void PrefetchEdges( const NodeIterator &n ) const {
+#ifdef __GNUC__
+        const EdgeIterator e = _nodes[n].firstEdge;
+        __builtin_prefetch(_targets + e);
+        __builtin_prefetch(_weights + e);
+#endif
+    }
+
+    //searches for a specific edge
+    EdgeIterator FindEdge( const NodeIterator &from, const NodeIterator &to ) const {
+        EdgeIterator smallestEdge = SPECIAL_EDGEID;
+        EdgeWeight smallestWeight = UINT_MAX;
+        for ( EdgeIterator edge = BeginEdges( from ); edge < EndEdges(from); edge++ ) {
+            const NodeID target = GetTarget(edge);
+            const EdgeWeight weight = GetWeight(edge);
+            if(target == to && weight < smallestWeight) {
+                smallestEdge = edge; smallestWeight = weight;
+            }
+        }
+        return smallestEdge;
+    }
+
+    EdgeIterator FindEdgeInEitherDirection( const NodeIterator &from, const NodeIterator &to ) const {
+        EdgeIterator tmp =  FindEdge( from, to );
+        return (UINT_MAX != tmp ? tmp : FindEdge( to, from ));
+    }
+
+    EdgeIterator FindEdgeIndicateIfReverse( const NodeIterator &from, const NodeIterator &to, bool & result ) const {
+        EdgeIterator tmp =  FindEdge( from, to );
+        if(UINT_MAX == tmp) {
+            tmp =  FindEdge( to, from );
+            if(UINT_MAX != tmp)
+                result = true;
+        }
+        return tmp;
+    }
+
+    //true if the input was not in split order and edge ids differ from the serialized ones
+    bool EdgesWereReordered() const {
+        return _edgesWereReordered;
+    }
+
+    void ApplyResidencyPolicy(const ResidencyPolicy & policy) const {
+        policy.Apply(_nodes, (std::size_t) (_numNodes+1)*sizeof(_StrSplitNode), "graph nodes");
+        policy.Apply(_targets, (std::size_t) _numEdges*sizeof(NodeID), "edge targets");
+        policy.Apply(_weights, (std::size_t) _numEdges*sizeof(int), "edge weights");
+        policy.Apply(_edgeData, (std::size_t) _numEdges*sizeof(EdgeDataT), "edge data");
+    }
+
+private:
+    struct _StrSplitNode {
+        EdgeIterator firstEdge;
+        EdgeIterator firstBidirectionalEdge;
+        EdgeIterator firstBackwardOnlyEdge;
+    };
+
+    struct _StrGraphProperties {
+        unsigned checkSum;
+        unsigned numberOfNodes;
+        unsigned numberOfEdges;
+        unsigned sizeOfEdgeData;
+        unsigned edgesWereReordered;
+    };
+
+    enum SectionID {
+        PROPERTIES_SECTION = 0,
+        NODES_SECTION,
+        TARGETS_SECTION,
+        WEIGHTS_SECTION,
+        EDGE_DATA_SECTION,
+        NUMBER_OF_SECTIONS
+    };
+
+    static inline unsigned GetDirectionClass( const EdgeDataT & data ) {
+        return (data.forward ? (data.backward ? 1 : 0) : 2);
+    }
+
+    void UseContainer( unsigned * checkSum ) {
+        if(sizeof(_StrGraphProperties) != _container->GetSectionSize(PROPERTIES_SECTION)) {
+            throw std::runtime_error("graph properties have an unexpected size");
+        }
+        _StrGraphProperties properties;
+        memcpy(&properties, _container->GetSection(PROPERTIES_SECTION), sizeof(_StrGraphProperties));
+        _numNodes = properties.numberOfNodes;
+        _numEdges = properties.numberOfEdges;
+        _edgesWereReordered = properties.edgesWereReordered;
+        *checkSum = properties.checkSum;
+        if(sizeof(EdgeDataT) != properties.sizeOfEdgeData ||
+                (unsigned long long) (_numNodes+1)*sizeof(_StrSplitNode) != _container->GetSectionSize(NODES_SECTION) ||
+                (unsigned long long) _numEdges*sizeof(NodeID) != _container->GetSectionSize(TARGETS_SECTION) ||
+                (unsigned long long) _numEdges*sizeof(int) != _container->GetSectionSize(WEIGHTS_SECTION) ||
+                (unsigned long long) _numEdges*sizeof(EdgeDataT) != _container->GetSectionSize(EDGE_DATA_SECTION)) {
+            throw std::runtime_error("sections of the graph do not match its properties");
+        }
+
+        _nodes = reinterpret_cast<const _StrSplitNode *>(_container->GetSection(NODES_SECTION));
+        _targets = reinterpret_cast<const NodeID *>(_container->GetSection(TARGETS_SECTION));
+        _weights = reinterpret_cast<const int *>(_container->GetSection(WEIGHTS_SECTION));
+        _edgeData = reinterpret_cast<const EdgeDataT *>(_container->GetSection(EDGE_DATA_SECTION));
+    }
+
+    NodeIterator _numNodes;
+    EdgeIterator _numEdges;
+    bool _edgesWereReordered;
+
+    //point either into the storage vectors or into the container
+    const _StrSplitNode * _nodes;
+    const NodeID * _targets;
+    const int * _weights;
+    const EdgeDataT * _edgeData;
+
+    std::vector< _StrSplitNode > _nodeStorage;
+    std::vector< NodeID > _targetStorage;
+    std::vector< int > _weightStorage;
+    std::vector< EdgeDataT > _edgeDataStorage;
+    boost::scoped_ptr<ContainerFile> _container;
+};
+
+#endif /* SPLITSTATICGRAPH_H_ */
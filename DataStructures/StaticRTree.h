@@ -0,0 +1,386 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef STATICRTREE_H_
+#define STATICRTREE_H_
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "../typedefs.h"
+#include "../Util/ResidencyPolicy.h"
+#include "ContainerFile.h"
+#include "DeallocatingVector.h"
+#include "EdgeSnapping.h"
+#include "GridEdge.h"
+#include "PhantomNodes.h"
+
+/*
+ * Nearest neighbour index over the edge-based nodes, a packed R-tree that
+ * osrm-prepare bulk loads once. The edges are sorted along a Hilbert curve
+ * by their midpoints and cut into leaves of a fixed number of edges, and
+ * each level above groups a fixed number of consecutive nodes. The nodes are
+ * stored level by level from the root, so that a .rtree file is mapped and
+ * searched in place without any I/O at query time. Searches are best-first
+ * branch and bound on the distance to the bounding boxes, so they find the
+ * nearest edge no matter how far away it is.
+ */
+class StaticRTree : private boost::noncopyable {
+public:
+    static const unsigned DEFAULT_LEAF_SIZE = 32;
+    static const unsigned BRANCHING_FACTOR = 16;
+
+    //bounding box in projected coordinates
+    struct _StrRectangle {
+        int minLat;
+        int maxLat;
+        int minLon;
+        int maxLon;
+
+        void Reset() {
+            minLat = minLon = INT_MAX;
+            maxLat = maxLon = INT_MIN;
+        }
+
+        void Extend(const _Coordinate & c) {
+            minLat = std::min(minLat, c.lat);
+            maxLat = std::max(maxLat, c.lat);
+            minLon = std::min(minLon, c.lon);
+            maxLon = std::max(maxLon, c.lon);
+        }
+
+        void Extend(const _StrRectangle & other) {
+            minLat = std::min(minLat, other.minLat);
+            maxLat = std::max(maxLat, other.maxLat);
+            minLon = std::min(minLon, other.minLon);
+            maxLon = std::max(maxLon, other.maxLon);
+        }
+
+        //lower bound of the squared distance of the point to anything inside, the metric of ComputeSquaredDistanceToSegment()
+        inline double GetMinimumDistance(const _Coordinate & c) const {
+            const double dLat = (c.lat < minLat ? (double) minLat - c.lat : (c.lat > maxLat ? (double) c.lat - maxLat : 0.));
+            const double dLon = (c.lon < minLon ? (double) minLon - c.lon : (c.lon > maxLon ? (double) c.lon - maxLon : 0.));
+            return dLat*dLat + dLon*dLon;
+        }
+    };
+
+    //children are nodes, or edges for the nodes from firstLeafNode on
+    struct _StrTreeNode {
+        _StrRectangle mbr;
+        unsigned firstChild;
+        unsigned numberOfChildren;
+    };
+
+    struct _StrTreeProperties {
+        unsigned numberOfNodes;
+        unsigned numberOfEdges;
+        unsigned firstLeafNode;
+        unsigned leafSize;
+        unsigned branchingFactor;
+    };
+
+    //maps a .rtree file and verifies its checksums
+    explicit StaticRTree(const char * fileName) {
+        _container.reset(new ContainerFile(fileName, ContainerFormat::RTREE_FILE));
+        _container->VerifyAllSections();
+        UseContainer();
+    }
+
+    //uses a .rtree file that is already in memory and outlives the tree, e.g. in shared memory
+    StaticRTree(const char * memory, const std::size_t size) {
+        _container.reset(new ContainerFile(memory, size, ContainerFormat::RTREE_FILE, "r-tree data"));
+        UseContainer();
+    }
+
+    template<typename EdgeT>
+    static void Build(DeallocatingVector<EdgeT> & edgeList, const char * fileName, const unsigned leafSize) {
+        if(0 == leafSize) {
+            ERR("leaf size of the r-tree must be positive");
+        }
+        double startTime = get_timestamp();
+        //the constructor zeroes the padding, so that the file does not depend on uninitialized memory
+        std::vector<_GridEdge> inputEdges;
+        std::vector<std::pair<unsigned long long, unsigned> > order;
+        _GridEdge gridEdge;
+        BOOST_FOREACH(EdgeT & edge, edgeList) {
+            if(edge.ignoreInGrid)
+                continue;
+            gridEdge.edgeBasedNode = edge.id;
+            gridEdge.nameID = edge.nameID;
+            gridEdge.weight = edge.weight;
+            gridEdge.startCoord = ProjectCoordinate(_Coordinate(edge.lat1, edge.lon1));
+            gridEdge.targetCoord = ProjectCoordinate(_Coordinate(edge.lat2, edge.lon2));
+            gridEdge.belongsToTinyComponent = edge.belongsToTinyComponent;
+            const _Coordinate midpoint(((long long) gridEdge.startCoord.lat + gridEdge.targetCoord.lat)/2, ((long long) gridEdge.startCoord.lon + gridEdge.targetCoord.lon)/2);
+            order.push_back(std::make_pair(GetHilbertValue(midpoint), inputEdges.size()));
+            inputEdges.push_back(gridEdge);
+        }
+        //ties are broken by the input order, which keeps the file deterministic
+        std::sort(order.begin(), order.end());
+        std::vector<_GridEdge> edges(inputEdges.size());
+        for(unsigned i = 0; i < order.size(); ++i) {
+            edges[i] = inputEdges[order[i].second];
+        }
+        std::vector<_GridEdge>().swap(inputEdges);
+        std::vector<std::pair<unsigned long long, unsigned> >().swap(order);
+
+        //levels from the leaves upwards, children are indexed within the level below
+        std::vector<std::vector<_StrTreeNode> > levels(1);
+        for(unsigned first = 0; first < edges.size(); first += leafSize) {
+            _StrTreeNode node;
+            node.firstChild = first;
+            node.numberOfChildren = std::min<std::size_t>(leafSize, edges.size() - first);
+            node.mbr.Reset();
+            for(unsigned i = first; i < first + node.numberOfChildren; ++i) {
+                node.mbr.Extend(edges[i].startCoord);
+                node.mbr.Extend(edges[i].targetCoord);
+            }
+            levels.back().push_back(node);
+        }
+        while(1 < levels.back().size()) {
+            const std::vector<_StrTreeNode> & lowerLevel = levels.back();
+            std::vector<_StrTreeNode> level;
+            for(unsigned first = 0; first < lowerLevel.size(); first += BRANCHING_FACTOR) {
+                _StrTreeNode node;
+                node.firstChild = first;
+                node.numberOfChildren = std::min<std::size_t>(BRANCHING_FACTOR, lowerLevel.size() - first);
+                node.mbr.Reset();
+                for(unsigned i = first; i < first + node.numberOfChildren; ++i) {
+                    node.mbr.Extend(lowerLevel[i].mbr);
+                }
+                level.push_back(node);
+            }
+            levels.push_back(level);
+        }
+
+        //root first, child indexes become absolute
+        std::vector<_StrTreeNode> nodes;
+        for(int l = levels.size()-1; l >= 0; --l) {
+            const unsigned offsetOfLowerLevel = nodes.size() + levels[l].size();
+            for(unsigned i = 0; i < levels[l].size(); ++i) {
+                nodes.push_back(levels[l][i]);
+                if(0 != l) {
+                    nodes.back().firstChild += offsetOfLowerLevel;
+                }
+            }
+        }
+        _StrTreeProperties properties;
+        memset(&properties, 0, sizeof(_StrTreeProperties));
+        properties.numberOfNodes = nodes.size();
+        properties.numberOfEdges = edges.size();
+        properties.firstLeafNode = nodes.size() - levels[0].size();
+        properties.leafSize = leafSize;
+        properties.branchingFactor = BRANCHING_FACTOR;
+
+        //the coordinates once more as separate arrays, so that the edges of a leaf are measured in one batch
+        _SegmentArrays segments;
+        for(unsigned i = 0; i < edges.size(); ++i) {
+            segments.Append(edges[i].startCoord, edges[i].targetCoord);
+        }
+
+        ContainerFileWriter writer(fileName, ContainerFormat::RTREE_FILE, 4);
+        writer.WriteSection(ContainerFormat::RTREE_PROPERTIES_SECTION, (char *) &properties, sizeof(_StrTreeProperties));
+        writer.WriteSection(ContainerFormat::RTREE_NODES_SECTION, (char *) (nodes.empty() ? NULL : &nodes[0]), nodes.size()*sizeof(_StrTreeNode));
+        writer.WriteSection(ContainerFormat::RTREE_EDGES_SECTION, (char *) (edges.empty() ? NULL : &edges[0]), edges.size()*sizeof(_GridEdge));
+        writer.BeginSection(ContainerFormat::RTREE_SEGMENTS_SECTION);
+        if(!edges.empty()) {
+            writer.Write((char *) &segments.sourceLat[0], edges.size()*sizeof(int));
+            writer.Write((char *) &segments.sourceLon[0], edges.size()*sizeof(int));
+            writer.Write((char *) &segments.targetLat[0], edges.size()*sizeof(int));
+            writer.Write((char *) &segments.targetLon[0], edges.size()*sizeof(int));
+        }
+        writer.EndSection();
+        writer.Close();
+        INFO("built r-tree of " << edges.size() << " edges in " << nodes.size() << " nodes and " << levels.size() << " levels in " << get_timestamp() - startTime << "s");
+    }
+
+    bool FindPhantomNodeForCoordinate( const _Coordinate & location, PhantomNode & resultNode, const unsigned zoomLevel) const {
+        const bool ignoreTinyComponents = (zoomLevel <= 14);
+        std::vector<_GridEdge> candidates;
+        FindNearestEdges(ProjectCoordinate(location), ignoreTinyComponents, 1, std::numeric_limits<double>::max(), candidates);
+        return SelectPhantomNode(location, candidates, ignoreTinyComponents, resultNode);
+    }
+
+    //up to maxNumberOfResults phantom nodes within maxDistance meters, nearest first
+    void FindNearestPhantomNodes(const _Coordinate & location, const unsigned maxNumberOfResults, const double maxDistance, const unsigned zoomLevel, std::vector<PhantomNodeCandidate> & result) const {
+        const bool ignoreTinyComponents = (zoomLevel <= 14);
+        std::vector<_GridEdge> candidates;
+        //both directions of a street are separate edges
+        FindNearestEdges(ProjectCoordinate(location), ignoreTinyComponents, 2*maxNumberOfResults, GetSquaredProjectedRadius(location, maxDistance), candidates);
+        SelectPhantomNodes(location, candidates, ignoreTinyComponents, maxNumberOfResults, maxDistance, result);
+    }
+
+    bool FindRoutingStarts(const _Coordinate& start, const _Coordinate& target, PhantomNodes & routingStarts, unsigned zoomLevel) const {
+        routingStarts.Reset();
+        return (FindPhantomNodeForCoordinate( start, routingStarts.startPhantom, zoomLevel) &&
+                FindPhantomNodeForCoordinate( target, routingStarts.targetPhantom, zoomLevel) );
+    }
+
+    bool FindNearestCoordinateOnEdgeInNodeBasedGraph(const _Coordinate& inputCoordinate, _Coordinate& outputCoordinate, unsigned zoomLevel = 18) const {
+        PhantomNode resultNode;
+        bool foundNode = FindPhantomNodeForCoordinate(inputCoordinate, resultNode, zoomLevel);
+        outputCoordinate = resultNode.location;
+        return foundNode;
+    }
+
+    void FindNearestPointOnEdge(const _Coordinate& inputCoordinate, _Coordinate& outputCoordinate) const {
+        std::vector<_GridEdge> candidates;
+        FindNearestEdges(ProjectCoordinate(inputCoordinate), false, 1, std::numeric_limits<double>::max(), candidates);
+        SelectNearestPoint(inputCoordinate, candidates, outputCoordinate);
+    }
+
+    void ApplyResidencyPolicy(const ResidencyPolicy & policy) const {
+        policy.Apply(_nodes, (std::size_t) _properties.numberOfNodes*sizeof(_StrTreeNode), "r-tree nodes");
+        policy.Apply(_edges, (std::size_t) _properties.numberOfEdges*sizeof(_GridEdge), "r-tree edges");
+        policy.Apply(_sourceLat, (std::size_t) _properties.numberOfEdges*4*sizeof(int), "r-tree segments");
+    }
+
+private:
+    //nodes and edges share the queue, edges are numbered after the nodes
+    typedef std::pair<double, unsigned> QueueEntry;
+
+    //At least minimumNumberOfEdges edges in the order of their distance from the projected point, and all
+    //further edges at the same distance as the last one, so that both directions of a street are found
+    //together. Edges beyond the squared distance are left out, as may be tiny components. The result is
+    //ordered by edge-based node.
+    void FindNearestEdges(const _Coordinate & startCoord, const bool ignoreTinyComponents, const unsigned minimumNumberOfEdges, const double maxSquaredDistance, std::vector<_GridEdge> & result) const {
+        result.clear();
+        if(0 == _properties.numberOfNodes || 0 == minimumNumberOfEdges) {
+            return;
+        }
+        std::vector<double> distances;
+        double lastDistance = 0.;
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+        queue.push(std::make_pair(_nodes[0].mbr.GetMinimumDistance(startCoord), 0));
+        while(!queue.empty()) {
+            const QueueEntry entry = queue.top();
+            if(!IsWithinReach(entry.first, maxSquaredDistance))
+                break;
+            if(result.size() >= minimumNumberOfEdges && !IsWithinReach(entry.first, lastDistance))
+                break;
+            queue.pop();
+            if(entry.second >= _properties.numberOfNodes) {
+                result.push_back(_edges[entry.second - _properties.numberOfNodes]);
+                if(result.size() <= minimumNumberOfEdges) {
+                    lastDistance = entry.first;
+                }
+                continue;
+            }
+            const _StrTreeNode & node = _nodes[entry.second];
+            if(entry.second >= _properties.firstLeafNode) {
+                if(0 == node.numberOfChildren)
+                    continue;
+                const unsigned first = node.firstChild;
+                distances.resize(node.numberOfChildren);
+                ComputeSquaredDistancesToSegments(startCoord, _sourceLat+first, _sourceLon+first, _targetLat+first, _targetLon+first, node.numberOfChildren, &distances[0], NULL);
+                for(unsigned i = 0; i < node.numberOfChildren; ++i) {
+                    if(_edges[first+i].belongsToTinyComponent && ignoreTinyComponents)
+                        continue;
+                    queue.push(std::make_pair(distances[i], _properties.numberOfNodes + first + i));
+                }
+                continue;
+            }
+            for(unsigned i = node.firstChild; i < node.firstChild + node.numberOfChildren; ++i) {
+                queue.push(std::make_pair(_nodes[i].mbr.GetMinimumDistance(startCoord), i));
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+
+    static inline bool IsWithinReach(const double distance, const double bestDistance) {
+        return distance <= bestDistance || SnappingEpsilonCompare(distance, bestDistance);
+    }
+
+    //position of the point on a Hilbert curve of order 31 over the projected world
+    static unsigned long long GetHilbertValue(const _Coordinate & c) {
+        const unsigned long long n = 1ULL << 31;
+        const double lat = std::min(std::max((double) c.lat, -18000000.), 18000000.);
+        const double lon = std::min(std::max((double) c.lon, -18000000.), 18000000.);
+        unsigned long long x = (lon + 18000000.)/36000000.*(n-1);
+        unsigned long long y = (lat + 18000000.)/36000000.*(n-1);
+        unsigned long long d = 0;
+        for(unsigned long long s = n/2; s > 0; s /= 2) {
+            const unsigned long long rx = (0 != (x & s));
+            const unsigned long long ry = (0 != (y & s));
+            d += s * s * ((3 * rx) ^ ry);
+            if(0 == ry) {
+                if(1 == rx) {
+                    x = n-1 - x;
+                    y = n-1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    void UseContainer() {
+        if(sizeof(_StrTreeProperties) != _container->GetSectionSize(ContainerFormat::RTREE_PROPERTIES_SECTION)) {
+            throw std::runtime_error("properties of the r-tree have an unexpected size");
+        }
+        memcpy(&_properties, _container->GetSection(ContainerFormat::RTREE_PROPERTIES_SECTION), sizeof(_StrTreeProperties));
+        if(!_container->HasSection(ContainerFormat::RTREE_SEGMENTS_SECTION)) {
+            throw std::runtime_error("r-tree is in an old format, rerun osrm-prepare");
+        }
+        if((unsigned long long) _properties.numberOfNodes*sizeof(_StrTreeNode) != _container->GetSectionSize(ContainerFormat::RTREE_NODES_SECTION) ||
+                (unsigned long long) _properties.numberOfEdges*sizeof(_GridEdge) != _container->GetSectionSize(ContainerFormat::RTREE_EDGES_SECTION) ||
+                (unsigned long long) _properties.numberOfEdges*4*sizeof(int) != _container->GetSectionSize(ContainerFormat::RTREE_SEGMENTS_SECTION) ||
+                _properties.firstLeafNode > _properties.numberOfNodes) {
+            throw std::runtime_error("sections of the r-tree do not match its properties");
+        }
+        _nodes = reinterpret_cast<const _StrTreeNode *>(_container->GetSection(ContainerFormat::RTREE_NODES_SECTION));
+        _edges = reinterpret_cast<const _GridEdge *>(_container->GetSection(ContainerFormat::RTREE_EDGES_SECTION));
+        _sourceLat = reinterpret_cast<const int *>(_container->GetSection(ContainerFormat::RTREE_SEGMENTS_SECTION));
+        _sourceLon = _sourceLat + _properties.numberOfEdges;
+        _targetLat = _sourceLon + _properties.numberOfEdges;
+        _targetLon = _targetLat + _properties.numberOfEdges;
+        //a damaged file must not lead the search out of bounds
+        for(unsigned i = 0; i < _properties.numberOfNodes; ++i) {
+            const unsigned long long end = (unsigned long long) _nodes[i].firstChild + _nodes[i].numberOfChildren;
+            if(end > (i < _properties.firstLeafNode ? _properties.numberOfNodes : _properties.numberOfEdges) || (i < _properties.firstLeafNode && _nodes[i].firstChild <= i)) {
+                throw std::runtime_error("r-tree node " + boost::lexical_cast<std::string>(i) + " points out of the tree");
+            }
+        }
+    }
+
+    _StrTreeProperties _properties;
+    const _StrTreeNode * _nodes;
+    const _GridEdge * _edges;
+    //coordinates of the edges in the layout of ComputeSquaredDistancesToSegments()
+    const int * _sourceLat;
+    const int * _sourceLon;
+    const int * _targetLat;
+    const int * _targetLon;
+    boost::scoped_ptr<ContainerFile> _container;
+};
+
+#endif /* STATICRTREE_H_ */
@@ -30,6 +30,7 @@
 #include "../DataStructures/QueryEdge.h"
 #include "../DataStructures/SearchEngine.h"
 #include "../DataStructures/SegmentInformation.h"
+#include "../DataStructures/SplitStaticGraph.h"
 #include "../DataStructures/TurnInstructions.h"
 
 /* This class is fed with all way segments in consecutive order
@@ -40,7 +41,7 @@ class DescriptionFactory {
     PolylineCompressor pc;
     PhantomNode startPhantom, targetPhantom;
 
-    typedef SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> > SearchEngineT;
+    typedef SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > SearchEngineT;
 
     double DegreeToRadian(const double degree) const;
     double RadianToDegree(const double degree) const;
@@ -0,0 +1,116 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SUMMARY_DESCRIPTOR_H_
+#define SUMMARY_DESCRIPTOR_H_
+
+#include <boost/foreach.hpp>
+
+#include "BaseDescriptor.h"
+#include "DescriptionFactory.h"
+#include "../Algorithms/ObjectToBase64.h"
+#include "../DataStructures/Coordinate.h"
+
+/*
+ * Writes only the route summary. The route is not unpacked if its length was
+ * computed during the search, otherwise the length is summed up along the
+ * unpacked path.
+ */
+template<class SearchEngineT>
+class SummaryDescriptor : public BaseDescriptor<SearchEngineT>{
+private:
+    _DescriptorConfig config;
+    _Coordinate current;
+public:
+    void SetConfig(const _DescriptorConfig & c) { config = c; }
+
+    void Run(http::Reply & reply, const RawRouteData &rawRoute, PhantomNodes &phantomNodes, SearchEngineT &sEngine) {
+        reply.content += "{"
+                "\"version\": 0.3,"
+                "\"status\":";
+        DescriptionFactory::_RouteSummary summary;
+        if(rawRoute.lengthOfShortestPath != INT_MAX) {
+            reply.content += "0,"
+                    "\"status_message\": \"Found route between points\",";
+            summary.startName = phantomNodes.startPhantom.nodeBasedEdgeNameID;
+            summary.destName = phantomNodes.targetPhantom.nodeBasedEdgeNameID;
+            summary.BuildDurationAndLengthStrings(GetDistance(rawRoute, phantomNodes, sEngine), rawRoute.lengthOfShortestPath);
+        } else {
+            reply.content += "207,"
+                    "\"status_message\": \"Cannot find route between points\",";
+        }
+
+        reply.content += "\"route_summary\":";
+        reply.content += "{";
+        reply.content += "\"total_distance\":";
+        reply.content += summary.lengthString;
+        reply.content += ","
+                "\"total_time\":";
+        reply.content += summary.durationString;
+        reply.content += ","
+                "\"start_point\":\"";
+        reply.content += sEngine.GetEscapedNameForNameID(summary.startName);
+        reply.content += "\","
+                "\"end_point\":\"";
+        reply.content += sEngine.GetEscapedNameForNameID(summary.destName);
+        reply.content += "\"";
+        reply.content += "},";
+
+        std::string tmp;
+        reply.content += "\"hint_data\": {";
+        reply.content += "\"checksum\":";
+        intToString(rawRoute.checkSum, tmp);
+        reply.content += tmp;
+        reply.content += ", \"locations\": [";
+
+        std::string hint;
+        for(unsigned i = 0; i < rawRoute.segmentEndCoordinates.size(); ++i) {
+            reply.content += "\"";
+            EncodeObjectToBase64(rawRoute.segmentEndCoordinates[i].startPhantom, hint);
+            reply.content += hint;
+            reply.content += "\", ";
+        }
+        EncodeObjectToBase64(rawRoute.segmentEndCoordinates.back().targetPhantom, hint);
+        reply.content += "\"";
+        reply.content += hint;
+        reply.content += "\"]";
+        reply.content += "},";
+        reply.content += "\"transactionId\": \"OSRM Routing Engine JSON Summary Descriptor (v0.3)\"";
+        reply.content += "}";
+    }
+
+private:
+    unsigned GetDistance(const RawRouteData &rawRoute, const PhantomNodes &phantomNodes, const SearchEngineT &sEngine) {
+        if(INT_MAX != rawRoute.distanceOfShortestPath) {
+            return rawRoute.distanceOfShortestPath;
+        }
+        unsigned distance = 0;
+        _Coordinate previous = phantomNodes.startPhantom.location;
+        BOOST_FOREACH(const _PathData & pathData, rawRoute.computedShortestPath) {
+            sEngine.GetCoordinatesForNodeID(pathData.node, current);
+            distance += ApproximateDistance(previous, current);
+            previous = current;
+        }
+        distance += ApproximateDistance(previous, phantomNodes.targetPhantom.location);
+        return distance;
+    }
+};
+
+#endif /* SUMMARY_DESCRIPTOR_H_ */
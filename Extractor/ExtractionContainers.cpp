@@ -19,6 +19,7 @@
  */
 
 #include "ExtractionContainers.h"
+#include "../DataStructures/NameTable.h"
 
 void ExtractionContainers::PrepareData(const std::string & outputFileName, const std::string restrictionsFileName, const unsigned amountOfRAM) {
     try {
@@ -281,17 +282,7 @@ void ExtractionContainers::PrepareData(const std::string & outputFileName, const
         time = get_timestamp();
         cout << "[extractor] writing street name index ... " << flush;
         std::string nameOutFileName = (outputFileName + ".names");
-        ofstream nameOutFile(nameOutFileName.c_str(), ios::binary);
-        unsigned sizeOfNameIndex = nameVector.size();
-        nameOutFile.write((char *)&(sizeOfNameIndex), sizeof(unsigned));
-
-        BOOST_FOREACH(string str, nameVector) {
-            unsigned lengthOfRawString = strlen(str.c_str());
-            nameOutFile.write((char *)&(lengthOfRawString), sizeof(unsigned));
-            nameOutFile.write(str.c_str(), lengthOfRawString);
-        }
-
-        nameOutFile.close();
+        NameTable::Write(nameOutFileName.c_str(), nameVector.begin(), nameVector.end());
         cout << "ok, after " << get_timestamp() - time << "s" << endl;
 
         //        time = get_timestamp();
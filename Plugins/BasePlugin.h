@@ -36,6 +36,9 @@ public:
 	virtual std::string GetDescriptor() const = 0;
 	virtual std::string GetVersionString() const = 0 ;
 	virtual void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) = 0;
+	//requests with more loc, src or dst parameters each are answered with 400 Bad Request
+	virtual unsigned GetMaxNumberOfLocations() const { return DEFAULT_MAX_NUMBER_OF_LOCATIONS; }
+	static const unsigned DEFAULT_MAX_NUMBER_OF_LOCATIONS = 26;
 };
 
 #endif /* BASEPLUGIN_H_ */
@@ -0,0 +1,158 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef DISTANCETABLEPLUGIN_H_
+#define DISTANCETABLEPLUGIN_H_
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "BasePlugin.h"
+#include "RouteParameters.h"
+
+#include "../DataStructures/QueryEdge.h"
+#include "../DataStructures/SearchEngine.h"
+#include "../DataStructures/SplitStaticGraph.h"
+
+#include "../Util/StringUtil.h"
+
+#include "../Server/DataStructures/QueryObjectsStorage.h"
+
+/*
+ * This plugin computes the matrix of travel times between a set of sources (src=)
+ * and a set of targets (dst=). If only loc= is given, the locations are used as
+ * both sources and targets.
+ */
+class DistanceTablePlugin : public BasePlugin {
+private:
+    NodeInformationHelpDesk * nodeHelpDesk;
+    const NameTable & names;
+    SplitStaticGraph<QueryEdge::EdgeData> * graph;
+    std::string pluginDescriptorString;
+    SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > * searchEngine;
+    static const unsigned MAX_NUMBER_OF_LOCATIONS = 100;
+public:
+
+    DistanceTablePlugin(QueryObjectsStorage * objects, std::string psd = "table") : names(*objects->names), pluginDescriptorString(psd) {
+        nodeHelpDesk = objects->nodeHelpDesk;
+        graph = objects->graph;
+
+        searchEngine = new SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> >(graph, nodeHelpDesk, names);
+    }
+
+    virtual ~DistanceTablePlugin() {
+        delete searchEngine;
+    }
+
+    std::string GetDescriptor() const { return pluginDescriptorString; }
+    std::string GetVersionString() const { return std::string("0.3 (DL)"); }
+    unsigned GetMaxNumberOfLocations() const { return MAX_NUMBER_OF_LOCATIONS; }
+    void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
+        const std::vector<_Coordinate> & sourcePoints = (routeParameters.sourcePoints.size() ? routeParameters.sourcePoints : routeParameters.viaPoints);
+        const std::vector<_Coordinate> & targetPoints = (routeParameters.targetPoints.size() ? routeParameters.targetPoints : routeParameters.viaPoints);
+        //check number of parameters
+        if( 0 == sourcePoints.size() || 0 == targetPoints.size() || MAX_NUMBER_OF_LOCATIONS < sourcePoints.size() || MAX_NUMBER_OF_LOCATIONS < targetPoints.size() ) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+
+        unsigned zoomLevel = 18;
+        if(routeParameters.options.Find("z") != ""){
+            zoomLevel = atoi(routeParameters.options.Find("z").c_str());
+            if(18 < zoomLevel)
+                zoomLevel = 18;
+        }
+
+        std::vector<PhantomNode> sourcePhantomNodes(sourcePoints.size());
+        std::vector<PhantomNode> targetPhantomNodes(targetPoints.size());
+        if(!FindPhantomNodes(sourcePoints, zoomLevel, sourcePhantomNodes) || !FindPhantomNodes(targetPoints, zoomLevel, targetPhantomNodes)) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+
+        std::vector<int> resultTable;
+        searchEngine->distanceTable(sourcePhantomNodes, targetPhantomNodes, resultTable);
+
+        std::string tmp;
+        std::string JSONParameter = routeParameters.options.Find("jsonp");
+        if("" != JSONParameter) {
+            reply.content += JSONParameter;
+            reply.content += "(";
+        }
+
+        reply.status = http::Reply::ok;
+        reply.content += ("{");
+        reply.content += ("\"version\":0.3,");
+        reply.content += ("\"status\":0,");
+        reply.content += ("\"distance_table\":[");
+        for(unsigned i = 0; i < sourcePhantomNodes.size(); ++i) {
+            if(0 != i)
+                reply.content += ",";
+            reply.content += "[";
+            for(unsigned j = 0; j < targetPhantomNodes.size(); ++j) {
+                if(0 != j)
+                    reply.content += ",";
+                intToString(resultTable[i*targetPhantomNodes.size()+j], tmp);
+                reply.content += tmp;
+            }
+            reply.content += "]";
+        }
+        reply.content += "]";
+        reply.content += ",\"transactionId\":\"OSRM Routing Engine JSON Distance Table (v0.3)\"";
+        reply.content += ("}");
+        reply.headers.resize(3);
+        if("" != JSONParameter) {
+            reply.content += ")";
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "text/javascript";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"table.js\"";
+        } else {
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "application/x-javascript";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"table.json\"";
+        }
+        reply.headers[0].name = "Content-Length";
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+    }
+private:
+    inline bool FindPhantomNodes(const std::vector<_Coordinate> & points, const unsigned zoomLevel, std::vector<PhantomNode> & phantomNodes) {
+        for(unsigned i = 0; i < points.size(); ++i) {
+            const _Coordinate & coordinate = points[i];
+            if(false == checkCoord(coordinate)) {
+                return false;
+            }
+            searchEngine->FindPhantomNodeForCoordinate(coordinate, phantomNodes[i], zoomLevel);
+        }
+        return true;
+    }
+
+    inline bool checkCoord(const _Coordinate & c) {
+        if(c.lat > 90*100000 || c.lat < -90*100000 || c.lon > 180*100000 || c.lon <-180*100000) {
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif /* DISTANCETABLEPLUGIN_H_ */
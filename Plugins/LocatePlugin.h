@@ -45,16 +45,7 @@ public:
             reply = http::Reply::stockReply(http::Reply::badRequest);
             return;
         }
-        std::vector<std::string> textCoord;
-        stringSplit (routeParameters.viaPoints[0], ',', textCoord);
-        if(textCoord.size() != 2) {
-            reply = http::Reply::stockReply(http::Reply::badRequest);
-            return;
-        }
-
-        int lat = 100000.*atof(textCoord[0].c_str());
-        int lon = 100000.*atof(textCoord[1].c_str());
-        _Coordinate myCoordinate(lat, lon);
+        const _Coordinate & myCoordinate = routeParameters.viaPoints[0];
         if(false == checkCoord(myCoordinate)) {
             reply = http::Reply::stockReply(http::Reply::badRequest);
             return;
@@ -21,7 +21,10 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef NearestPlugin_H_
 #define NearestPlugin_H_
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
+#include <vector>
 
 #include "BasePlugin.h"
 #include "RouteParameters.h"
@@ -37,7 +40,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
  */
 class NearestPlugin : public BasePlugin {
 public:
-    NearestPlugin(QueryObjectsStorage * objects) : names(objects->names) {
+    NearestPlugin(QueryObjectsStorage * objects) : names(*objects->names) {
         nodeHelpDesk = objects->nodeHelpDesk;
 
         descriptorTable.Set("", 0); //default descriptor
@@ -51,16 +54,7 @@ public:
             reply = http::Reply::stockReply(http::Reply::badRequest);
             return;
         }
-        std::vector<std::string> textCoord;
-        stringSplit (routeParameters.viaPoints[0], ',', textCoord);
-        if(textCoord.size() != 2) {
-        	reply = http::Reply::stockReply(http::Reply::badRequest);
-        	return;
-        }
-
-        int lat = 100000.*atof(textCoord[0].c_str());
-        int lon = 100000.*atof(textCoord[1].c_str());
-        _Coordinate myCoordinate(lat, lon);
+        const _Coordinate & myCoordinate = routeParameters.viaPoints[0];
         if(false == checkCoord(myCoordinate)) {
             reply = http::Reply::stockReply(http::Reply::badRequest);
             return;
@@ -73,9 +67,30 @@ public:
                 zoomLevel = 18;
         }
 
+        unsigned numberOfResults = 1;
+        if(routeParameters.options.Find("num_results") != "") {
+            numberOfResults = std::max(1, atoi(routeParameters.options.Find("num_results").c_str()));
+            if(MAX_NUMBER_OF_RESULTS < numberOfResults)
+                numberOfResults = MAX_NUMBER_OF_RESULTS;
+        }
+        //in meters, unlimited by default
+        double radius = std::numeric_limits<double>::max();
+        if(routeParameters.options.Find("radius") != "") {
+            radius = std::max(0., atof(routeParameters.options.Find("radius").c_str()));
+        }
+        const bool listCandidates = (1 < numberOfResults || std::numeric_limits<double>::max() != radius);
+
         //query to helpdesk
+        std::vector<PhantomNodeCandidate> candidates;
         PhantomNode result;
-        nodeHelpDesk->FindPhantomNodeForCoordinate(myCoordinate, result, zoomLevel);
+        if(listCandidates) {
+            nodeHelpDesk->FindNearestPhantomNodes(myCoordinate, numberOfResults, radius, zoomLevel, candidates);
+            if(!candidates.empty()) {
+                result = candidates[0].phantomNode;
+            }
+        } else {
+            nodeHelpDesk->FindPhantomNodeForCoordinate(myCoordinate, result, zoomLevel);
+        }
 
         std::string tmp;
         std::string JSONParameter;
@@ -96,19 +111,21 @@ public:
         else
             reply.content += "207,";
         reply.content += ("\"mapped_coordinate\":");
-        reply.content += "[";
-        if(UINT_MAX != result.edgeBasedNode) {
-            convertInternalLatLonToString(result.location.lat, tmp);
-            reply.content += tmp;
-            convertInternalLatLonToString(result.location.lon, tmp);
-            reply.content += ",";
-            reply.content += tmp;
+        appendCandidate(result, tmp, reply.content);
+        if(listCandidates) {
+            reply.content += ",\"candidates\":[";
+            for(unsigned i = 0; i < candidates.size(); ++i) {
+                if(0 != i)
+                    reply.content += ",";
+                reply.content += "{\"mapped_coordinate\":";
+                appendCandidate(candidates[i].phantomNode, tmp, reply.content);
+                reply.content += ",\"distance\":";
+                intToString(candidates[i].distance + 0.5, tmp);
+                reply.content += tmp;
+                reply.content += "}";
+            }
+            reply.content += "]";
         }
-        reply.content += "],";
-        reply.content += "\"name\":\"";
-        if(UINT_MAX != result.edgeBasedNode)
-            reply.content += names[result.nodeBasedEdgeNameID];
-        reply.content += "\"";
         reply.content += ",\"transactionId\":\"OSRM Routing Engine JSON Nearest (v0.3)\"";
         reply.content += ("}");
         reply.headers.resize(3);
@@ -129,6 +146,25 @@ public:
         reply.headers[0].value = tmp;
     }
 private:
+    static const unsigned MAX_NUMBER_OF_RESULTS = 100;
+
+    //coordinate and name of a phantom node, both empty if there is none
+    inline void appendCandidate(const PhantomNode & phantomNode, std::string & tmp, std::string & output) const {
+        output += "[";
+        if(UINT_MAX != phantomNode.edgeBasedNode) {
+            convertInternalLatLonToString(phantomNode.location.lat, tmp);
+            output += tmp;
+            convertInternalLatLonToString(phantomNode.location.lon, tmp);
+            output += ",";
+            output += tmp;
+        }
+        output += "],";
+        output += "\"name\":\"";
+        if(UINT_MAX != phantomNode.edgeBasedNode)
+            output.append(names.GetNameData(phantomNode.nodeBasedEdgeNameID), names.GetNameLength(phantomNode.nodeBasedEdgeNameID));
+        output += "\"";
+    }
+
     inline bool checkCoord(const _Coordinate & c) {
         if(c.lat > 90*100000 || c.lat < -90*100000 || c.lon > 180*100000 || c.lon <-180*100000) {
             return false;
@@ -138,7 +174,7 @@ private:
 
     NodeInformationHelpDesk * nodeHelpDesk;
     HashTable<std::string, unsigned> descriptorTable;
-    std::vector<std::string> & names;
+    const NameTable & names;
 };
 
 #endif /* NearestPlugin_H_ */
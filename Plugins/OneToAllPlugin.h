@@ -0,0 +1,160 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef ONETOALLPLUGIN_H_
+#define ONETOALLPLUGIN_H_
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "BasePlugin.h"
+#include "RouteParameters.h"
+
+#include "../DataStructures/LevelOrderedGraph.h"
+#include "../DataStructures/QueryEdge.h"
+#include "../DataStructures/SearchEngine.h"
+#include "../DataStructures/SplitStaticGraph.h"
+#include "../RoutingAlgorithms/OneToAllRouting.h"
+
+#include "../Util/StringUtil.h"
+
+#include "../Server/DataStructures/QueryObjectsStorage.h"
+
+/*
+ * This plugin computes the travel times from one location (loc=) to every node
+ * of the road network. The optional parameter max= restricts the output to the
+ * nodes that are reachable within the given travel time.
+ */
+class OneToAllPlugin : public BasePlugin {
+private:
+    typedef SearchEngineData<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > SearchEngineDataT;
+    NodeInformationHelpDesk * nodeHelpDesk;
+    const LevelOrderedGraph * levelOrderedGraph;
+    std::string pluginDescriptorString;
+    SearchEngineDataT queryData;
+    OneToAllRouting<SearchEngineDataT> oneToAll;
+public:
+
+    OneToAllPlugin(QueryObjectsStorage * objects, std::string psd = "onetoall") :
+        nodeHelpDesk(objects->nodeHelpDesk),
+        levelOrderedGraph(objects->levelOrderedGraph),
+        pluginDescriptorString(psd),
+        queryData(objects->graph, objects->nodeHelpDesk, *objects->names),
+        oneToAll(queryData, objects->levelOrderedGraph)
+    { }
+
+    virtual ~OneToAllPlugin() { }
+
+    std::string GetDescriptor() const { return pluginDescriptorString; }
+    std::string GetVersionString() const { return std::string("0.3 (DL)"); }
+    void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
+        //check number of parameters
+        if(1 != routeParameters.viaPoints.size()) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+        const _Coordinate & myCoordinate = routeParameters.viaPoints[0];
+        if(false == myCoordinate.isValid()) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+
+        unsigned zoomLevel = 18;
+        if(routeParameters.options.Find("z") != ""){
+            zoomLevel = atoi(routeParameters.options.Find("z").c_str());
+            if(18 < zoomLevel)
+                zoomLevel = 18;
+        }
+
+        int maxDistance = INT_MAX;
+        if(routeParameters.options.Find("max") != "") {
+            maxDistance = atoi(routeParameters.options.Find("max").c_str());
+        }
+
+        PhantomNode source;
+        nodeHelpDesk->FindPhantomNodeForCoordinate(myCoordinate, source, zoomLevel);
+
+        std::vector<int> distances;
+        oneToAll(source, distances);
+
+        std::string tmp;
+        std::string JSONParameter = routeParameters.options.Find("jsonp");
+        if("" != JSONParameter) {
+            reply.content += JSONParameter;
+            reply.content += "(";
+        }
+
+        reply.status = http::Reply::ok;
+        reply.content += ("{");
+        reply.content += ("\"version\":0.3,");
+        reply.content += ("\"status\":");
+        if(UINT_MAX != source.edgeBasedNode)
+            reply.content += "0,";
+        else
+            reply.content += "207,";
+        reply.content += ("\"reachable_nodes\":[");
+        bool isFirstNode = true;
+        for(LevelOrderedGraph::NodeIterator position = 0; position < distances.size(); ++position) {
+            //the start of the source segment lies behind the source
+            const int distance = std::max(0, distances[position]);
+            if(INT_MAX == distance || maxDistance < distance) {
+                continue;
+            }
+            if(!isFirstNode)
+                reply.content += ",";
+            isFirstNode = false;
+            const _Coordinate & location = levelOrderedGraph->GetCoordinate(position);
+            reply.content += "[";
+            convertInternalLatLonToString(location.lat, tmp);
+            reply.content += tmp;
+            reply.content += ",";
+            convertInternalLatLonToString(location.lon, tmp);
+            reply.content += tmp;
+            reply.content += ",";
+            intToString(distance, tmp);
+            reply.content += tmp;
+            reply.content += "]";
+        }
+        reply.content += "]";
+        reply.content += ",\"transactionId\":\"OSRM Routing Engine JSON One To All (v0.3)\"";
+        reply.content += ("}");
+        reply.headers.resize(3);
+        if("" != JSONParameter) {
+            reply.content += ")";
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "text/javascript";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"onetoall.js\"";
+        } else {
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "application/x-javascript";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"onetoall.json\"";
+        }
+        reply.headers[0].name = "Content-Length";
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+    }
+};
+
+#endif /* ONETOALLPLUGIN_H_ */
@@ -39,7 +39,9 @@ struct RawRouteData {
     unsigned checkSum;
     int lengthOfShortestPath;
     int lengthOfAlternativePath;
-    RawRouteData() : checkSum(UINT_MAX), lengthOfShortestPath(INT_MAX), lengthOfAlternativePath(INT_MAX) {}
+    //length in meters, only set if the shortest path was not unpacked
+    int distanceOfShortestPath;
+    RawRouteData() : checkSum(UINT_MAX), lengthOfShortestPath(INT_MAX), lengthOfAlternativePath(INT_MAX), distanceOfShortestPath(INT_MAX) {}
 };
 
 #endif /* RAWROUTEDATA_H_ */
@@ -23,14 +23,28 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include <string>
 #include <vector>
+#include "../DataStructures/Coordinate.h"
 #include "../DataStructures/HashTable.h"
 
 struct RouteParameters {
     std::vector<std::string> hints;
     std::vector<std::string> parameters;
-    std::vector<std::string> viaPoints;
+    //locations that could not be parsed are left unset, i.e. invalid
+    std::vector<_Coordinate> viaPoints;
+    std::vector<_Coordinate> sourcePoints;
+    std::vector<_Coordinate> targetPoints;
     HashTable<std::string, std::string> options;
     typedef HashTable<std::string, std::string>::MyIterator OptionsIterator;
+
+    //keeps the memory of the lists for the next request
+    void Clear() {
+        hints.clear();
+        parameters.clear();
+        viaPoints.clear();
+        sourcePoints.clear();
+        targetPoints.clear();
+        options.EraseAll();
+    }
 };
 
 
@@ -35,11 +35,12 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "../Descriptors/BaseDescriptor.h"
 #include "../Descriptors/GPXDescriptor.h"
 #include "../Descriptors/JSONDescriptor.h"
+#include "../Descriptors/SummaryDescriptor.h"
 
 #include "../DataStructures/HashTable.h"
 #include "../DataStructures/QueryEdge.h"
-#include "../DataStructures/StaticGraph.h"
 #include "../DataStructures/SearchEngine.h"
+#include "../DataStructures/SplitStaticGraph.h"
 
 #include "../Util/StringUtil.h"
 
@@ -48,22 +49,26 @@ or see http://www.gnu.org/licenses/agpl.txt.
 class ViaRoutePlugin : public BasePlugin {
 private:
     NodeInformationHelpDesk * nodeHelpDesk;
-    std::vector<std::string> & names;
-    StaticGraph<QueryEdge::EdgeData> * graph;
+    const NameTable & names;
+    SplitStaticGraph<QueryEdge::EdgeData> * graph;
     HashTable<std::string, unsigned> descriptorTable;
     std::string pluginDescriptorString;
-    SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> > * searchEngine;
+    SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > * searchEngine;
+    unsigned maxNumberOfLocations;
 public:
 
-    ViaRoutePlugin(QueryObjectsStorage * objects, std::string psd = "viaroute") : names(objects->names), pluginDescriptorString(psd) {
+    //the legs of a route are searched by up to threadsPerRoute threads, a route has at most maxNumberOfLocations locations
+    ViaRoutePlugin(QueryObjectsStorage * objects, const unsigned threadsPerRoute = 1, const unsigned maxNumberOfLocations = DEFAULT_MAX_NUMBER_OF_LOCATIONS, std::string psd = "viaroute") : names(*objects->names), pluginDescriptorString(psd), maxNumberOfLocations(maxNumberOfLocations) {
         nodeHelpDesk = objects->nodeHelpDesk;
         graph = objects->graph;
 
-        searchEngine = new SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> >(graph, nodeHelpDesk, names);
+        searchEngine = new SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> >(graph, nodeHelpDesk, names, objects->unpackingIndex, objects->edgeLengthTable);
+        searchEngine->shortestPath.SetMaxNumberOfThreads(threadsPerRoute);
 
         descriptorTable.Set("", 0); //default descriptor
         descriptorTable.Set("json", 0);
         descriptorTable.Set("gpx", 1);
+        descriptorTable.Set("summary", 2);
     }
 
     virtual ~ViaRoutePlugin() {
@@ -72,6 +77,7 @@ public:
 
     std::string GetDescriptor() const { return pluginDescriptorString; }
     std::string GetVersionString() const { return std::string("0.3 (DL)"); }
+    unsigned GetMaxNumberOfLocations() const { return maxNumberOfLocations; }
     void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
         //check number of parameters
         if( 2 > routeParameters.viaPoints.size() ) {
@@ -89,17 +95,8 @@ public:
         RawRouteData rawRoute;
         rawRoute.checkSum = nodeHelpDesk->GetCheckSum();
         bool checksumOK = ((unsigned)atoi(routeParameters.options.Find("checksum").c_str()) == rawRoute.checkSum);
-        std::vector<std::string> textCoord;
         for(unsigned i = 0; i < routeParameters.viaPoints.size(); ++i) {
-            textCoord.resize(0);
-            stringSplit (routeParameters.viaPoints[i], ',', textCoord);
-            if(textCoord.size() != 2) {
-                reply = http::Reply::stockReply(http::Reply::badRequest);
-                return;
-            }
-            int vialat = static_cast<int>(100000.*atof(textCoord[0].c_str()));
-            int vialon = static_cast<int>(100000.*atof(textCoord[1].c_str()));
-            _Coordinate viaCoord(vialat, vialon);
+            const _Coordinate & viaCoord = routeParameters.viaPoints[i];
             if(false == checkCoord(viaCoord)) {
                 reply = http::Reply::stockReply(http::Reply::badRequest);
                 return;
@@ -127,7 +124,11 @@ public:
             segmentPhantomNodes.targetPhantom = phantomNodeVector[i+1];
             rawRoute.segmentEndCoordinates.push_back(segmentPhantomNodes);
         }
-        if(1 == rawRoute.segmentEndCoordinates.size()) {
+        unsigned descriptorType = descriptorTable[routeParameters.options.Find("output")];
+        if(2 == descriptorType) {
+            //the summary needs neither alternatives nor the unpacked route
+            searchEngine->shortestPath(rawRoute.segmentEndCoordinates, rawRoute, false);
+        } else if(1 == rawRoute.segmentEndCoordinates.size()) {
 //            INFO("Checking for alternative paths");
             searchEngine->alternativePaths(rawRoute.segmentEndCoordinates[0],  rawRoute);
 
@@ -157,7 +158,7 @@ public:
         reply.status = http::Reply::ok;
 
         //TODO: Move to member as smart pointer
-        BaseDescriptor<SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> > > * desc;
+        BaseDescriptor<SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > > * desc;
         std::string JSONParameter = routeParameters.options.Find("jsonp");
         if("" != JSONParameter) {
             reply.content += JSONParameter;
@@ -165,7 +166,6 @@ public:
         }
 
         _DescriptorConfig descriptorConfig;
-        unsigned descriptorType = descriptorTable[routeParameters.options.Find("output")];
         descriptorConfig.z = zoomLevel;
         if(routeParameters.options.Find("instructions") == "false") {
             descriptorConfig.instructions = false;
@@ -178,15 +178,19 @@ public:
         }
         switch(descriptorType){
         case 0:
-            desc = new JSONDescriptor<SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> > >();
+            desc = new JSONDescriptor<SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > >();
 
             break;
         case 1:
-            desc = new GPXDescriptor<SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> > >();
+            desc = new GPXDescriptor<SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > >();
+
+            break;
+        case 2:
+            desc = new SummaryDescriptor<SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > >();
 
             break;
         default:
-            desc = new JSONDescriptor<SearchEngine<QueryEdge::EdgeData, StaticGraph<QueryEdge::EdgeData> > >();
+            desc = new JSONDescriptor<SearchEngine<QueryEdge::EdgeData, SplitStaticGraph<QueryEdge::EdgeData> > >();
 
             break;
         }
@@ -307,30 +307,7 @@ private:
             return;
         }
 
-        for ( typename QueryDataT::Graph::EdgeIterator edge = super::_queryData.graph->BeginEdges( node ); edge < super::_queryData.graph->EndEdges(node); edge++ ) {
-            const typename QueryDataT::Graph::EdgeData & data = super::_queryData.graph->GetEdgeData(edge);
-            bool forwardDirectionFlag = (forwardDirection ? data.forward : data.backward );
-            if(forwardDirectionFlag) {
-
-                const NodeID to = super::_queryData.graph->GetTarget(edge);
-                const int edgeWeight = data.distance;
-
-                assert( edgeWeight > 0 );
-                const int toDistance = distance + edgeWeight;
-
-                //New Node discovered -> Add to Heap + Node Info Storage
-                if ( !_forwardHeap->WasInserted( to ) ) {
-                    _forwardHeap->Insert( to, toDistance, node );
-
-                }
-                //Found a shorter Path -> Update distance
-                else if ( toDistance < _forwardHeap->GetKey( to ) ) {
-                    _forwardHeap->GetData( to ).parent = node;
-                    _forwardHeap->DecreaseKey( to, toDistance );
-                    //new parent
-                }
-            }
-        }
+        super::RelaxOutgoingEdges(_forwardHeap, node, distance, forwardDirection);
     }
 
     //conduct T-Test
@@ -25,13 +25,36 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include <cassert>
 #include <climits>
+#include <deque>
+#include <stack>
+#include <vector>
 
+#include "../DataStructures/ShortcutUnpackingIndex.h"
 #include "../Plugins/RawRouteData.h"
 
 template<class QueryDataT>
 class BasicRoutingInterface {
 protected:
     QueryDataT & _queryData;
+private:
+    //path segment (first,second) that is unpacked through the referenced edge
+    struct _UnpackingStep {
+        _UnpackingStep(const NodeID f, const NodeID s, const EdgeID e) : first(f), second(s), edgeReference(e) {}
+        NodeID first;
+        NodeID second;
+        EdgeID edgeReference;
+    };
+
+    inline void PushHalvesOfShortcut(const _UnpackingStep & step, const NodeID middle, std::stack<_UnpackingStep> & recursionStack) const {
+        if(NULL != _queryData.unpackingIndex) {
+            const ShortcutUnpackingIndex::_StrEdgeHalves & halves = _queryData.unpackingIndex->GetHalves(step.edgeReference);
+            recursionStack.push(_UnpackingStep(middle, step.second, halves.second));
+            recursionStack.push(_UnpackingStep(step.first, middle, halves.first));
+        } else {
+            recursionStack.push(_UnpackingStep(middle, step.second, ShortcutUnpackingIndex::FindPathEdge(*_queryData.graph, middle, step.second)));
+            recursionStack.push(_UnpackingStep(step.first, middle, ShortcutUnpackingIndex::FindPathEdge(*_queryData.graph, step.first, middle)));
+        }
+    }
 public:
     BasicRoutingInterface(QueryDataT & qd) : _queryData(qd) { }
     virtual ~BasicRoutingInterface(){ };
@@ -59,47 +82,54 @@ public:
             return;
         }
 
-        for ( typename QueryDataT::Graph::EdgeIterator edge = _queryData.graph->BeginEdges( node ); edge < _queryData.graph->EndEdges(node); edge++ ) {
-            const typename QueryDataT::Graph::EdgeData & data = _queryData.graph->GetEdgeData(edge);
-            bool backwardDirectionFlag = (!forwardDirection) ? data.forward : data.backward;
-            if(backwardDirectionFlag) {
-                const NodeID to = _queryData.graph->GetTarget(edge);
-                const int edgeWeight = data.distance;
+        if(StallAtNode(_forwardHeap, node, distance, forwardDirection)) {
+            return;
+        }
+        RelaxOutgoingEdges(_forwardHeap, node, distance, forwardDirection);
+        //the other direction is searched next, which hides the latency of the prefetch
+        if(_forwardHeap->Size() > 0) {
+            _queryData.graph->PrefetchEdges(_forwardHeap->Min());
+        }
+    }
+
+    //Stall-on-demand: node is reached more cheaply through an incoming edge of an already labeled node
+    inline bool StallAtNode(typename QueryDataT::HeapPtr & _forwardHeap, const NodeID node, const int distance, const bool forwardDirection) const {
+        //incoming edges are the ones usable in the opposite search direction
+        const typename QueryDataT::Graph::EdgeIterator endEdges = (forwardDirection ? _queryData.graph->EndBackwardEdges(node) : _queryData.graph->EndForwardEdges(node));
+        for ( typename QueryDataT::Graph::EdgeIterator edge = (forwardDirection ? _queryData.graph->BeginBackwardEdges(node) : _queryData.graph->BeginForwardEdges(node)); edge < endEdges; ++edge ) {
+            const NodeID to = _queryData.graph->GetTarget(edge);
+            const int edgeWeight = _queryData.graph->GetWeight(edge);
 
-                assert( edgeWeight > 0 );
+            assert( edgeWeight > 0 );
 
-                //Stalling
-                if(_forwardHeap->WasInserted( to )) {
-                    if(_forwardHeap->GetKey( to ) + edgeWeight < distance) {
-                        return;
-                    }
+            //Stalling
+            if(_forwardHeap->WasInserted( to )) {
+                if(_forwardHeap->GetKey( to ) + edgeWeight < distance) {
+                    return true;
                 }
             }
         }
+        return false;
+    }
 
-        for ( typename QueryDataT::Graph::EdgeIterator edge = _queryData.graph->BeginEdges( node ); edge < _queryData.graph->EndEdges(node); edge++ ) {
-            const typename QueryDataT::Graph::EdgeData & data = _queryData.graph->GetEdgeData(edge);
-            bool forwardDirectionFlag = (forwardDirection ? data.forward : data.backward );
-            if(forwardDirectionFlag) {
-
-                const NodeID to = _queryData.graph->GetTarget(edge);
-                const int edgeWeight = data.distance;
+    inline void RelaxOutgoingEdges(typename QueryDataT::HeapPtr & _forwardHeap, const NodeID node, const int distance, const bool forwardDirection) const {
+        const typename QueryDataT::Graph::EdgeIterator endEdges = (forwardDirection ? _queryData.graph->EndForwardEdges(node) : _queryData.graph->EndBackwardEdges(node));
+        for ( typename QueryDataT::Graph::EdgeIterator edge = (forwardDirection ? _queryData.graph->BeginForwardEdges(node) : _queryData.graph->BeginBackwardEdges(node)); edge < endEdges; ++edge ) {
+            const NodeID to = _queryData.graph->GetTarget(edge);
+            const int edgeWeight = _queryData.graph->GetWeight(edge);
 
-                assert( edgeWeight > 0 );
-                const int toDistance = distance + edgeWeight;
+            assert( edgeWeight > 0 );
+            const int toDistance = distance + edgeWeight;
 
-                //New Node discovered -> Add to Heap + Node Info Storage
-                if ( !_forwardHeap->WasInserted( to ) ) {
-                    //                    INFO((forwardDirection ? "[forw]" : "[back]") << " scanning edge (" << node << "," << to << ") with distance " << toDistance << ", edge length: " << data.distance);
-                    _forwardHeap->Insert( to, toDistance, node );
-                }
-                //Found a shorter Path -> Update distance
-                else if ( toDistance < _forwardHeap->GetKey( to ) ) {
-                    //                    INFO((forwardDirection ? "[forw]" : "[back]") << " decrease and scanning edge (" << node << "," << to << ") from " << _forwardHeap->GetKey(to) << "to " << toDistance << ", edge length: " << data.distance);
-                    _forwardHeap->GetData( to ).parent = node;
-                    _forwardHeap->DecreaseKey( to, toDistance );
-                    //new parent
-                }
+            //New Node discovered -> Add to Heap + Node Info Storage
+            if ( !_forwardHeap->WasInserted( to ) ) {
+                _forwardHeap->Insert( to, toDistance, node );
+            }
+            //Found a shorter Path -> Update distance
+            else if ( toDistance < _forwardHeap->GetKey( to ) ) {
+                _forwardHeap->GetData( to ).parent = node;
+                _forwardHeap->DecreaseKey( to, toDistance );
+                //new parent
             }
         }
     }
@@ -107,50 +137,23 @@ public:
     inline void UnpackPath(std::deque<NodeID> & packedPath, std::vector<_PathData> & unpackedPath) const {
 
         const unsigned sizeOfPackedPath = packedPath.size();
-        std::stack<std::pair<NodeID, NodeID> > recursionStack;
+        std::stack<_UnpackingStep> recursionStack;
 
         //We have to push the path in reverse order onto the stack because it's LIFO.
         for(unsigned i = sizeOfPackedPath-1; i > 0; --i){
-            recursionStack.push(std::make_pair(packedPath[i-1], packedPath[i]));
+            recursionStack.push(_UnpackingStep(packedPath[i-1], packedPath[i], ShortcutUnpackingIndex::FindPathEdge(*_queryData.graph, packedPath[i-1], packedPath[i])));
         }
 
-        std::pair<NodeID, NodeID> edge;
         while(!recursionStack.empty()) {
-            edge = recursionStack.top();
+            const _UnpackingStep step = recursionStack.top();
             recursionStack.pop();
-//            INFO("Unpacking edge (" << edge.first << "," << edge.second << ")");
-
-            typename QueryDataT::Graph::EdgeIterator smallestEdge = SPECIAL_EDGEID;
-            int smallestWeight = INT_MAX;
-            for(typename QueryDataT::Graph::EdgeIterator eit = _queryData.graph->BeginEdges(edge.first);eit < _queryData.graph->EndEdges(edge.first);++eit){
-                const int weight = _queryData.graph->GetEdgeData(eit).distance;
-//                INFO("Checking edge (" << edge.first << "/" << _queryData.graph->GetTarget(eit) << ")");
-                if(_queryData.graph->GetTarget(eit) == edge.second && weight < smallestWeight && _queryData.graph->GetEdgeData(eit).forward){
-//                    INFO("1smallest " << eit << ", " << weight);
-                    smallestEdge = eit;
-                    smallestWeight = weight;
-                }
-            }
+//            INFO("Unpacking edge (" << step.first << "," << step.second << ")");
+            assert(SPECIAL_EDGEID != step.edgeReference);
 
-            if(smallestEdge == SPECIAL_EDGEID){
-                for(typename QueryDataT::Graph::EdgeIterator eit = _queryData.graph->BeginEdges(edge.second);eit < _queryData.graph->EndEdges(edge.second);++eit){
-                    const int weight = _queryData.graph->GetEdgeData(eit).distance;
-//                    INFO("Checking edge (" << edge.first << "/" << _queryData.graph->GetTarget(eit) << ")");
-                    if(_queryData.graph->GetTarget(eit) == edge.first && weight < smallestWeight && _queryData.graph->GetEdgeData(eit).backward){
-//                      INFO("2smallest " << eit << ", " << weight);
-                        smallestEdge = eit;
-                        smallestWeight = weight;
-                    }
-                }
-            }
-            assert(smallestWeight != INT_MAX);
-
-            const typename QueryDataT::Graph::EdgeData& ed = _queryData.graph->GetEdgeData(smallestEdge);
+            const typename QueryDataT::Graph::EdgeData& ed = _queryData.graph->GetEdgeData(ShortcutUnpackingIndex::GetEdgeID(step.edgeReference));
             if(ed.shortcut) {//unpack
-                const NodeID middle = ed.id;
                 //again, we need to this in reversed order
-                recursionStack.push(std::make_pair(middle, edge.second));
-                recursionStack.push(std::make_pair(edge.first, middle));
+                PushHalvesOfShortcut(step, ed.id, recursionStack);
             } else {
                 assert(!ed.shortcut);
                 unpackedPath.push_back(_PathData(ed.id, _queryData.nodeHelpDesk->getNameIndexFromEdgeID(ed.id), _queryData.nodeHelpDesk->getTurnInstructionFromEdgeID(ed.id), ed.distance) );
@@ -160,50 +163,42 @@ public:
 
     inline void UnpackEdge(const NodeID s, const NodeID t, std::vector<NodeID> & unpackedPath) const {
 
-        std::stack<std::pair<NodeID, NodeID> > recursionStack;
-        recursionStack.push(std::make_pair(s,t));
+        std::stack<_UnpackingStep> recursionStack;
+        recursionStack.push(_UnpackingStep(s, t, ShortcutUnpackingIndex::FindPathEdge(*_queryData.graph, s, t)));
 
-        std::pair<NodeID, NodeID> edge;
         while(!recursionStack.empty()) {
-            edge = recursionStack.top();
+            const _UnpackingStep step = recursionStack.top();
             recursionStack.pop();
+            assert(SPECIAL_EDGEID != step.edgeReference);
 
-            typename QueryDataT::Graph::EdgeIterator smallestEdge = SPECIAL_EDGEID;
-            int smallestWeight = INT_MAX;
-            for(typename QueryDataT::Graph::EdgeIterator eit = _queryData.graph->BeginEdges(edge.first);eit < _queryData.graph->EndEdges(edge.first);++eit){
-                const int weight = _queryData.graph->GetEdgeData(eit).distance;
-                if(_queryData.graph->GetTarget(eit) == edge.second && weight < smallestWeight && _queryData.graph->GetEdgeData(eit).forward){
-                    smallestEdge = eit;
-                    smallestWeight = weight;
-                }
-            }
-
-            if(smallestEdge == SPECIAL_EDGEID){
-                for(typename QueryDataT::Graph::EdgeIterator eit = _queryData.graph->BeginEdges(edge.second);eit < _queryData.graph->EndEdges(edge.second);++eit){
-                    const int weight = _queryData.graph->GetEdgeData(eit).distance;
-                    if(_queryData.graph->GetTarget(eit) == edge.first && weight < smallestWeight && _queryData.graph->GetEdgeData(eit).backward){
-                        smallestEdge = eit;
-                        smallestWeight = weight;
-                    }
-                }
-            }
-            assert(smallestWeight != INT_MAX);
-
-            const typename QueryDataT::Graph::EdgeData& ed = _queryData.graph->GetEdgeData(smallestEdge);
+            const typename QueryDataT::Graph::EdgeData& ed = _queryData.graph->GetEdgeData(ShortcutUnpackingIndex::GetEdgeID(step.edgeReference));
             if(ed.shortcut) {//unpack
-                const NodeID middle = ed.id;
                 //again, we need to this in reversed order
-//                INFO("unpacking (" << middle << "," <<  edge.second << ") and (" << edge.first << "," << middle << ")");
-                recursionStack.push(std::make_pair(middle, edge.second));
-                recursionStack.push(std::make_pair(edge.first, middle));
+//                INFO("unpacking (" << ed.id << "," <<  step.second << ") and (" << step.first << "," << ed.id << ")");
+                PushHalvesOfShortcut(step, ed.id, recursionStack);
             } else {
                 assert(!ed.shortcut);
-                unpackedPath.push_back(edge.first );
+                unpackedPath.push_back(step.first);
             }
         }
         unpackedPath.push_back(t);
     }
 
+    //length in meters of a packed path between two phantom nodes, read from the edge length table
+    inline int ComputeLengthOfPackedPath(const std::deque<NodeID> & packedPath, const PhantomNodes & phantomNodePair) const {
+        assert(NULL != _queryData.edgeLengthTable);
+        int length = 0;
+        for(unsigned i = 1; i < packedPath.size(); ++i) {
+            const EdgeID edgeReference = ShortcutUnpackingIndex::FindPathEdge(*_queryData.graph, packedPath[i-1], packedPath[i]);
+            if(SPECIAL_EDGEID != edgeReference) {
+                length += _queryData.edgeLengthTable->GetLengthOfEdge(edgeReference);
+            }
+        }
+        length -= _queryData.edgeLengthTable->GetLengthBeforePhantom(phantomNodePair.startPhantom, packedPath.front());
+        length += _queryData.edgeLengthTable->GetLengthBeforePhantom(phantomNodePair.targetPhantom, packedPath.back());
+        return length;
+    }
+
     inline void RetrievePackedPathFromHeap(const typename QueryDataT::HeapPtr & _fHeap, const typename QueryDataT::HeapPtr & _bHeap, const NodeID middle, std::deque<NodeID>& packedPath) {
         NodeID pathNode = middle;
         if(_fHeap->GetData(pathNode).parent != middle) {
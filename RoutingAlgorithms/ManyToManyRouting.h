@@ -0,0 +1,130 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef MANYTOMANYROUTING_H_
+#define MANYTOMANYROUTING_H_
+
+#include <climits>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include "BasicRoutingInterface.h"
+#include "../DataStructures/PhantomNodes.h"
+
+/*
+ * Bucket-based many-to-many search on the contraction hierarchy.
+ * One backward search per target stores its settled nodes in buckets,
+ * one forward search per source then scans the buckets of its settled nodes.
+ */
+template<class QueryDataT>
+class ManyToManyRouting : private BasicRoutingInterface<QueryDataT>{
+    typedef BasicRoutingInterface<QueryDataT> super;
+    typedef typename QueryDataT::HeapPtr HeapPtr;
+
+    struct NodeBucket {
+        NodeBucket(unsigned t, int d) : targetIndex(t), distance(d) {}
+        unsigned targetIndex;
+        int distance;
+    };
+    typedef boost::unordered_map<NodeID, std::vector<NodeBucket> > SearchSpaceWithBuckets;
+public:
+    ManyToManyRouting(QueryDataT & qd) : super(qd) {}
+
+    ~ManyToManyRouting() {}
+
+    //result is filled row-wise, i.e. distance from source i to target j is at i*targets.size()+j
+    void operator()(const std::vector<PhantomNode> & sources, const std::vector<PhantomNode> & targets, std::vector<int> & resultTable) {
+        resultTable.clear();
+        resultTable.resize(sources.size()*targets.size(), INT_MAX);
+
+        HeapPtr & heap = super::_queryData.forwardHeap;
+        super::_queryData.InitializeOrClearFirstThreadLocalStorage();
+
+        SearchSpaceWithBuckets searchSpaceWithBuckets;
+        for(unsigned targetIndex = 0; targetIndex < targets.size(); ++targetIndex) {
+            const PhantomNode & target = targets[targetIndex];
+            if(UINT_MAX == target.edgeBasedNode) {
+                continue;
+            }
+            heap->Clear();
+            heap->Insert(target.edgeBasedNode, target.weight1, target.edgeBasedNode);
+            if(target.isBidirected()) {
+                heap->Insert(target.edgeBasedNode+1, target.weight2, target.edgeBasedNode+1);
+            }
+            while(heap->Size() > 0) {
+                BackwardRoutingStep(targetIndex, heap, searchSpaceWithBuckets);
+            }
+        }
+
+        for(unsigned sourceIndex = 0; sourceIndex < sources.size(); ++sourceIndex) {
+            const PhantomNode & source = sources[sourceIndex];
+            if(UINT_MAX == source.edgeBasedNode) {
+                continue;
+            }
+            heap->Clear();
+            heap->Insert(source.edgeBasedNode, -source.weight1, source.edgeBasedNode);
+            if(source.isBidirected()) {
+                heap->Insert(source.edgeBasedNode+1, -source.weight2, source.edgeBasedNode+1);
+            }
+            while(heap->Size() > 0) {
+                ForwardRoutingStep(sourceIndex, targets.size(), heap, searchSpaceWithBuckets, resultTable);
+            }
+        }
+    }
+
+private:
+    inline void BackwardRoutingStep(const unsigned targetIndex, HeapPtr & heap, SearchSpaceWithBuckets & searchSpaceWithBuckets) const {
+        const NodeID node = heap->DeleteMin();
+        const int distance = heap->GetKey(node);
+
+        if(super::StallAtNode(heap, node, distance, false)) {
+            return;
+        }
+        searchSpaceWithBuckets[node].push_back(NodeBucket(targetIndex, distance));
+        super::RelaxOutgoingEdges(heap, node, distance, false);
+    }
+
+    inline void ForwardRoutingStep(const unsigned sourceIndex, const unsigned numberOfTargets, HeapPtr & heap, const SearchSpaceWithBuckets & searchSpaceWithBuckets, std::vector<int> & resultTable) const {
+        const NodeID node = heap->DeleteMin();
+        const int sourceDistance = heap->GetKey(node);
+
+        if(super::StallAtNode(heap, node, sourceDistance, true)) {
+            return;
+        }
+
+        //scan the buckets that the backward searches left at this node
+        typename SearchSpaceWithBuckets::const_iterator bucketIterator = searchSpaceWithBuckets.find(node);
+        if(bucketIterator != searchSpaceWithBuckets.end()) {
+            const std::vector<NodeBucket> & bucketList = bucketIterator->second;
+            for(unsigned i = 0; i < bucketList.size(); ++i) {
+                const NodeBucket & bucket = bucketList[i];
+                const int newDistance = sourceDistance + bucket.distance;
+                int & currentDistance = resultTable[sourceIndex*numberOfTargets + bucket.targetIndex];
+                if(newDistance >= 0 && newDistance < currentDistance) {
+                    currentDistance = newDistance;
+                }
+            }
+        }
+        super::RelaxOutgoingEdges(heap, node, sourceDistance, true);
+    }
+};
+
+#endif /* MANYTOMANYROUTING_H_ */
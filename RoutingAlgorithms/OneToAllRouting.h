@@ -0,0 +1,86 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef ONETOALLROUTING_H_
+#define ONETOALLROUTING_H_
+
+#include <climits>
+#include <vector>
+
+#include "BasicRoutingInterface.h"
+#include "../DataStructures/LevelOrderedGraph.h"
+#include "../DataStructures/PhantomNodes.h"
+
+/*
+ * PHAST-style one-to-all search: an upward search from the source labels the
+ * nodes of its search space, then one linear sweep over the nodes in descending
+ * level relaxes all downward edges. Afterwards each node holds its distance.
+ */
+template<class QueryDataT>
+class OneToAllRouting : private BasicRoutingInterface<QueryDataT>{
+    typedef BasicRoutingInterface<QueryDataT> super;
+    typedef typename QueryDataT::HeapPtr HeapPtr;
+    const LevelOrderedGraph * levelOrderedGraph;
+public:
+    OneToAllRouting(QueryDataT & qd, const LevelOrderedGraph * g) : super(qd), levelOrderedGraph(g) {}
+
+    ~OneToAllRouting() {}
+
+    //distances are indexed by position in the level ordered graph, unreachable nodes are INT_MAX
+    void operator()(const PhantomNode & source, std::vector<int> & distances) {
+        distances.clear();
+        distances.resize(levelOrderedGraph->GetNumberOfNodes(), INT_MAX);
+        if(UINT_MAX == source.edgeBasedNode) {
+            return;
+        }
+
+        HeapPtr & heap = super::_queryData.forwardHeap;
+        super::_queryData.InitializeOrClearFirstThreadLocalStorage();
+
+        heap->Insert(source.edgeBasedNode, -source.weight1, source.edgeBasedNode);
+        if(source.isBidirected()) {
+            heap->Insert(source.edgeBasedNode+1, -source.weight2, source.edgeBasedNode+1);
+        }
+        while(heap->Size() > 0) {
+            const NodeID node = heap->DeleteMin();
+            const int distance = heap->GetKey(node);
+            //stalled labels are upper bounds that the sweep corrects
+            distances[levelOrderedGraph->GetPosition(node)] = distance;
+            if(super::StallAtNode(heap, node, distance, true)) {
+                continue;
+            }
+            super::RelaxOutgoingEdges(heap, node, distance, true);
+        }
+
+        //sources of incoming downward edges always have a smaller position
+        for(LevelOrderedGraph::NodeIterator position = 0; position < levelOrderedGraph->GetNumberOfNodes(); ++position) {
+            int currentDistance = distances[position];
+            for(LevelOrderedGraph::EdgeIterator edge = levelOrderedGraph->BeginEdges(position), endEdges = levelOrderedGraph->EndEdges(position); edge < endEdges; ++edge) {
+                const int sourceDistance = distances[levelOrderedGraph->GetSource(edge)];
+                if(INT_MAX != sourceDistance && sourceDistance + levelOrderedGraph->GetDistance(edge) < currentDistance) {
+                    currentDistance = sourceDistance + levelOrderedGraph->GetDistance(edge);
+                }
+            }
+            distances[position] = currentDistance;
+        }
+    }
+};
+
+#endif /* ONETOALLROUTING_H_ */
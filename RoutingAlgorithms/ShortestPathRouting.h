@@ -23,25 +23,70 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef SHORTESTPATHROUTING_H_
 #define SHORTESTPATHROUTING_H_
 
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <vector>
+
 #include "BasicRoutingInterface.h"
+#include "../Util/OpenMPWrapper.h"
 
 template<class QueryDataT>
 class ShortestPathRouting : public BasicRoutingInterface<QueryDataT>{
     typedef BasicRoutingInterface<QueryDataT> super;
+
+    //outcome of the two searches of one leg, towards both directions of its target node
+    struct _LegSearchResult {
+        _LegSearchResult() : searchFrom1stStartNode(true), searchFrom2ndStartNode(true), upperbound1(INT_MAX), upperbound2(INT_MAX), middle1(UINT_MAX), middle2(UINT_MAX) {}
+        bool searchFrom1stStartNode;
+        bool searchFrom2ndStartNode;
+        int upperbound1;
+        int upperbound2;
+        NodeID middle1;
+        NodeID middle2;
+        std::deque<NodeID> packedPath1;
+        std::deque<NodeID> packedPath2;
+    };
+    //threads that search the legs of one route, each of them allocates heaps for the whole graph
+    unsigned _maxNumberOfThreads;
 public:
-    ShortestPathRouting(QueryDataT & qd) : super(qd) {}
+    ShortestPathRouting(QueryDataT & qd) : super(qd), _maxNumberOfThreads(1) {}
 
     ~ShortestPathRouting() {}
 
-    void operator()(std::vector<PhantomNodes> & phantomNodesVector,  RawRouteData & rawRouteData) {
+    //Every server thread starts a team of its own, so that a route with several legs may keep up to
+    //this many cores busy. 1 searches the legs one after the other.
+    void SetMaxNumberOfThreads(const unsigned maxNumberOfThreads) {
+        _maxNumberOfThreads = std::max(1u, maxNumberOfThreads);
+    }
+
+    //Without unpacking, only the length of the route is computed if the edge length table is available.
+    void operator()(std::vector<PhantomNodes> & phantomNodesVector,  RawRouteData & rawRouteData, const bool unpackPath = true) {
         BOOST_FOREACH(PhantomNodes & phantomNodePair, phantomNodesVector) {
             if(!phantomNodePair.AtLeastOnePhantomNodeIsUINTMAX()) {
                 rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
                 return;
             }
         }
+
+        //Legs are searched concurrently on the assumption that both start nodes of each leg are usable.
+        //Each worker thread has its own thread local heaps.
+        const int numberOfLegs = phantomNodesVector.size();
+        const int numberOfThreads = std::min(std::min(numberOfLegs, (int) _maxNumberOfThreads), omp_get_max_threads());
+        const bool legsSearchedAhead = (1 < numberOfThreads);
+        std::vector<_LegSearchResult> legSearchResults(numberOfLegs);
+        if(legsSearchedAhead) {
+#pragma omp parallel for schedule ( dynamic ) num_threads ( numberOfThreads )
+            for(int leg = 0; leg < numberOfLegs; ++leg) {
+                SearchLeg(phantomNodesVector[leg], legSearchResults[leg]);
+            }
+        }
+
         int distance1 = 0;
         int distance2 = 0;
+        const bool computeLength = (!unpackPath && NULL != super::_queryData.edgeLengthTable);
+        int length1 = 0;
+        int length2 = 0;
 
         bool searchFrom1stStartNode(true);
         bool searchFrom2ndStartNode(true);
@@ -50,120 +95,54 @@ public:
         std::deque<NodeID> packedPath1;
         std::deque<NodeID> packedPath2;
 
-        typename QueryDataT::HeapPtr & forwardHeap = super::_queryData.forwardHeap;
-        typename QueryDataT::HeapPtr & backwardHeap = super::_queryData.backwardHeap;
-
-        typename QueryDataT::HeapPtr & forwardHeap2 = super::_queryData.forwardHeap2;
-        typename QueryDataT::HeapPtr & backwardHeap2 = super::_queryData.backwardHeap2;
-
-
-        //Get distance to next pair of target nodes.
-        BOOST_FOREACH(PhantomNodes & phantomNodePair, phantomNodesVector) {
-            super::_queryData.InitializeOrClearFirstThreadLocalStorage();
-            super::_queryData.InitializeOrClearSecondThreadLocalStorage();
-
-            int _localUpperbound1 = INT_MAX;
-            int _localUpperbound2 = INT_MAX;
-
-            //insert new starting nodes into forward heap, adjusted by previous distances.
-            if(searchFrom1stStartNode) {
-                forwardHeap->Insert(phantomNodePair.startPhantom.edgeBasedNode, -phantomNodePair.startPhantom.weight1, phantomNodePair.startPhantom.edgeBasedNode);
-                forwardHeap2->Insert(phantomNodePair.startPhantom.edgeBasedNode, -phantomNodePair.startPhantom.weight1, phantomNodePair.startPhantom.edgeBasedNode);
-//              INFO("a 1,2)forw insert " << phantomNodePair.startPhantom.edgeBasedNode << " with weight " << phantomNodePair.startPhantom.weight1);
-//          } else {
-//              INFO("Skipping first start node");
-            }
-            if(phantomNodePair.startPhantom.isBidirected() && searchFrom2ndStartNode) {
-                forwardHeap->Insert(phantomNodePair.startPhantom.edgeBasedNode+1, -phantomNodePair.startPhantom.weight2, phantomNodePair.startPhantom.edgeBasedNode+1);
-                forwardHeap2->Insert(phantomNodePair.startPhantom.edgeBasedNode+1, -phantomNodePair.startPhantom.weight2, phantomNodePair.startPhantom.edgeBasedNode+1);
-//              INFO("b 1,2)forw insert " << phantomNodePair.startPhantom.edgeBasedNode+1 << " with weight " << -phantomNodePair.startPhantom.weight1);
-//          } else if(!searchFrom2ndStartNode) {
-//              INFO("Skipping second start node");
+        //Stitch the legs together in order. A leg is searched again if the previous legs rule out one of its start nodes.
+        for(int leg = 0; leg < numberOfLegs; ++leg) {
+            PhantomNodes & phantomNodePair = phantomNodesVector[leg];
+            _LegSearchResult & result = legSearchResults[leg];
+            const bool speculationFailed = !searchFrom1stStartNode || (!searchFrom2ndStartNode && phantomNodePair.startPhantom.isBidirected());
+            if(!legsSearchedAhead || speculationFailed) {
+                result = _LegSearchResult();
+                result.searchFrom1stStartNode = searchFrom1stStartNode;
+                result.searchFrom2ndStartNode = searchFrom2ndStartNode;
+                SearchLeg(phantomNodePair, result);
             }
 
-//            backwardHeap->Clear();
-//            backwardHeap2->Clear();
-            //insert new backward nodes into backward heap, unadjusted.
-            backwardHeap->Insert(phantomNodePair.targetPhantom.edgeBasedNode, phantomNodePair.targetPhantom.weight1, phantomNodePair.targetPhantom.edgeBasedNode);
-//          INFO("1) back insert " << phantomNodePair.targetPhantom.edgeBasedNode << " with weight " << phantomNodePair.targetPhantom.weight1);
-            if(phantomNodePair.targetPhantom.isBidirected() ) {
-//              INFO("2) back insert " << phantomNodePair.targetPhantom.edgeBasedNode+1 << " with weight " << phantomNodePair.targetPhantom.weight2);
-                backwardHeap2->Insert(phantomNodePair.targetPhantom.edgeBasedNode+1, phantomNodePair.targetPhantom.weight2, phantomNodePair.targetPhantom.edgeBasedNode+1);
-            }
-            int offset = (phantomNodePair.startPhantom.isBidirected() ? std::max(phantomNodePair.startPhantom.weight1, phantomNodePair.startPhantom.weight2) : phantomNodePair.startPhantom.weight1) ;
-            offset += (phantomNodePair.targetPhantom.isBidirected() ? std::max(phantomNodePair.targetPhantom.weight1, phantomNodePair.targetPhantom.weight2) : phantomNodePair.targetPhantom.weight1) ;
-
-            //run two-Target Dijkstra routing step.
-            while(forwardHeap->Size() + backwardHeap->Size() > 0){
-                if(forwardHeap->Size() > 0){
-                    super::RoutingStep(forwardHeap, backwardHeap, &middle1, &_localUpperbound1, 2*offset, true);
-                }
-                if(backwardHeap->Size() > 0){
-                    super::RoutingStep(backwardHeap, forwardHeap, &middle1, &_localUpperbound1, 2*offset, false);
-                }
-            }
-            if(backwardHeap2->Size() > 0) {
-                while(forwardHeap2->Size() + backwardHeap2->Size() > 0){
-                    if(forwardHeap2->Size() > 0){
-                        super::RoutingStep(forwardHeap2, backwardHeap2, &middle2, &_localUpperbound2, 2*offset, true);
-                    }
-                    if(backwardHeap2->Size() > 0){
-                        super::RoutingStep(backwardHeap2, forwardHeap2, &middle2, &_localUpperbound2, 2*offset, false);
-                    }
-                }
-            }
-//          INFO("upperbound1: " << _localUpperbound1 << ", distance1: " << distance1);
-//          INFO("upperbound2: " << _localUpperbound2 << ", distance2: " << distance2);
+            int _localUpperbound1 = result.upperbound1;
+            int _localUpperbound2 = result.upperbound2;
+            //a search that finds no path keeps the middle node of the previous leg
+            if(UINT_MAX != result.middle1)
+                middle1 = result.middle1;
+            if(UINT_MAX != result.middle2)
+                middle2 = result.middle2;
 
             //No path found for both target nodes?
             if(INT_MAX == _localUpperbound1 && INT_MAX == _localUpperbound2) {
                 rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
                 return;
             }
-            if(UINT_MAX == middle1) {
-                searchFrom1stStartNode = false;
-//              INFO("Next Search will not start from 1st");
-            } else {
-//              INFO("Next Search will start from 1st");
-                searchFrom1stStartNode = true;
-            }
-            if(UINT_MAX == middle2) {
-                searchFrom2ndStartNode = false;
-//              INFO("Next Search will not start from 2nd");
-            } else {
-                searchFrom2ndStartNode = true;
-//              INFO("Next Search will start from 2nd");
-            }
+            searchFrom1stStartNode = (UINT_MAX != middle1);
+            searchFrom2ndStartNode = (UINT_MAX != middle2);
 
             //Was at most one of the two paths not found?
             assert(!(INT_MAX == distance1 && INT_MAX == distance2));
 
-//          INFO("middle1: " << middle1);
-
-            //Unpack paths if they exist
-            std::deque<NodeID> temporaryPackedPath1;
-            std::deque<NodeID> temporaryPackedPath2;
-            if(INT_MAX != _localUpperbound1) {
-                super::RetrievePackedPathFromHeap(forwardHeap, backwardHeap, middle1, temporaryPackedPath1);
-//              INFO("temporaryPackedPath1 ends with " << *(temporaryPackedPath1.end()-1) );
-            }
-//          INFO("middle2: " << middle2);
-
-            if(INT_MAX != _localUpperbound2) {
-                super::RetrievePackedPathFromHeap(forwardHeap2, backwardHeap2, middle2, temporaryPackedPath2);
-//                INFO("temporaryPackedPath2 ends with " << *(temporaryPackedPath2.end()-1) );
-            }
+            std::deque<NodeID> & temporaryPackedPath1 = result.packedPath1;
+            std::deque<NodeID> & temporaryPackedPath2 = result.packedPath2;
+            int _localLength1 = ((computeLength && 0 < temporaryPackedPath1.size()) ? super::ComputeLengthOfPackedPath(temporaryPackedPath1, phantomNodePair) : 0);
+            int _localLength2 = ((computeLength && 0 < temporaryPackedPath2.size()) ? super::ComputeLengthOfPackedPath(temporaryPackedPath2, phantomNodePair) : 0);
 
             //if one of the paths was not found, replace it with the other one.
             if(0 == temporaryPackedPath1.size()) {
 //              INFO("Deleting path 1");
                 temporaryPackedPath1.insert(temporaryPackedPath1.end(), temporaryPackedPath2.begin(), temporaryPackedPath2.end());
                 _localUpperbound1 = _localUpperbound2;
+                _localLength1 = _localLength2;
             }
             if(0 == temporaryPackedPath2.size()) {
 //              INFO("Deleting path 2");
                 temporaryPackedPath2.insert(temporaryPackedPath2.end(), temporaryPackedPath1.begin(), temporaryPackedPath1.end());
                 _localUpperbound2 = _localUpperbound1;
+                _localLength2 = _localLength1;
             }
 
             assert(0 < temporaryPackedPath1.size() && 0 < temporaryPackedPath2.size());
@@ -180,12 +159,14 @@ public:
                         packedPath2.clear();
                         packedPath2.insert(packedPath2.end(), packedPath1.begin(), packedPath1.end());
                         distance2 = distance1;
+                        length2 = length1;
 //                      INFO("packedPath2 now ends with " <<  *(packedPath2.end()-1));
                     } else {
 //                      INFO("Deleting path1 that ends with " << *(packedPath1.end()-1) << ", other ends with " << *(packedPath2.end()-1));
                         packedPath1.clear();
                         packedPath1.insert(packedPath1.end(), packedPath2.begin(), packedPath2.end());
                         distance1 = distance2;
+                        length1 = length2;
 //                      INFO("Path1 now ends with " <<  *(packedPath1.end()-1));
                     }
                 } else  {
@@ -194,6 +175,7 @@ public:
 //                      INFO("Switching");
                         packedPath1.swap(packedPath2);
                         std::swap(distance1, distance2);
+                        std::swap(length1, length2);
                     }
                 }
             }
@@ -212,42 +194,85 @@ public:
 
             distance1 += _localUpperbound1;
             distance2 += _localUpperbound2;
+            length1 += _localLength1;
+            length2 += _localLength2;
         }
 
 //      INFO("length path1: " << distance1);
 //      INFO("length path2: " << distance2);
-        if(distance1 <= distance2){
-            //remove consecutive duplicates
-//          std::cout << "unclean 1: ";
-//          for(unsigned i = 0; i < packedPath1.size(); ++i)
-//              std::cout << packedPath1[i] << " ";
-//          std::cout << std::endl;
-
-//          std::cout << "cleaned 1: ";
-//          for(unsigned i = 0; i < packedPath1.size(); ++i)
-//              std::cout << packedPath1[i] << " ";
-//          std::cout << std::endl;
-//            super::UnpackPath(packedPath1, rawRouteData.computedShortestPath);
-        } else {
+        if(distance1 > distance2){
             std::swap(packedPath1, packedPath2);
-//          std::cout << "unclean 2: ";
-//          for(unsigned i = 0; i < packedPath2.size(); ++i)
-//              std::cout << packedPath2[i] << " ";
-//          std::cout << std::endl;
-//            _RemoveConsecutiveDuplicatesFromContainer(packedPath2);
-//          std::cout << "cleaned 2: ";
-//          for(unsigned i = 0; i < packedPath2.size(); ++i)
-//              std::cout << packedPath2[i] << " ";
-//          std::cout << std::endl;
-//            super::UnpackPath(packedPath2, unpackedPath);
+            std::swap(length1, length2);
+        }
+        if(computeLength) {
+            rawRouteData.distanceOfShortestPath = std::max(length1, 0);
+        } else {
+            _RemoveConsecutiveDuplicatesFromContainer(packedPath1);
+            super::UnpackPath(packedPath1, rawRouteData.computedShortestPath);
         }
-        _RemoveConsecutiveDuplicatesFromContainer(packedPath1);
-        super::UnpackPath(packedPath1, rawRouteData.computedShortestPath);
         rawRouteData.lengthOfShortestPath = std::min(distance1, distance2);
 //      INFO("Found via route with distance " << std::min(distance1, distance2));
         return;
     }
 private:
+    //runs the two searches of a leg from the start nodes that result allows, on the heaps of the calling thread
+    void SearchLeg(const PhantomNodes & phantomNodePair, _LegSearchResult & result) {
+        typename QueryDataT::HeapPtr & forwardHeap = super::_queryData.forwardHeap;
+        typename QueryDataT::HeapPtr & backwardHeap = super::_queryData.backwardHeap;
+
+        typename QueryDataT::HeapPtr & forwardHeap2 = super::_queryData.forwardHeap2;
+        typename QueryDataT::HeapPtr & backwardHeap2 = super::_queryData.backwardHeap2;
+
+        super::_queryData.InitializeOrClearFirstThreadLocalStorage();
+        super::_queryData.InitializeOrClearSecondThreadLocalStorage();
+
+        //insert new starting nodes into forward heap, adjusted by previous distances.
+        if(result.searchFrom1stStartNode) {
+            forwardHeap->Insert(phantomNodePair.startPhantom.edgeBasedNode, -phantomNodePair.startPhantom.weight1, phantomNodePair.startPhantom.edgeBasedNode);
+            forwardHeap2->Insert(phantomNodePair.startPhantom.edgeBasedNode, -phantomNodePair.startPhantom.weight1, phantomNodePair.startPhantom.edgeBasedNode);
+        }
+        if(phantomNodePair.startPhantom.isBidirected() && result.searchFrom2ndStartNode) {
+            forwardHeap->Insert(phantomNodePair.startPhantom.edgeBasedNode+1, -phantomNodePair.startPhantom.weight2, phantomNodePair.startPhantom.edgeBasedNode+1);
+            forwardHeap2->Insert(phantomNodePair.startPhantom.edgeBasedNode+1, -phantomNodePair.startPhantom.weight2, phantomNodePair.startPhantom.edgeBasedNode+1);
+        }
+
+        //insert new backward nodes into backward heap, unadjusted.
+        backwardHeap->Insert(phantomNodePair.targetPhantom.edgeBasedNode, phantomNodePair.targetPhantom.weight1, phantomNodePair.targetPhantom.edgeBasedNode);
+        if(phantomNodePair.targetPhantom.isBidirected() ) {
+            backwardHeap2->Insert(phantomNodePair.targetPhantom.edgeBasedNode+1, phantomNodePair.targetPhantom.weight2, phantomNodePair.targetPhantom.edgeBasedNode+1);
+        }
+        int offset = (phantomNodePair.startPhantom.isBidirected() ? std::max(phantomNodePair.startPhantom.weight1, phantomNodePair.startPhantom.weight2) : phantomNodePair.startPhantom.weight1) ;
+        offset += (phantomNodePair.targetPhantom.isBidirected() ? std::max(phantomNodePair.targetPhantom.weight1, phantomNodePair.targetPhantom.weight2) : phantomNodePair.targetPhantom.weight1) ;
+
+        //run two-Target Dijkstra routing step.
+        while(forwardHeap->Size() + backwardHeap->Size() > 0){
+            if(forwardHeap->Size() > 0){
+                super::RoutingStep(forwardHeap, backwardHeap, &result.middle1, &result.upperbound1, 2*offset, true);
+            }
+            if(backwardHeap->Size() > 0){
+                super::RoutingStep(backwardHeap, forwardHeap, &result.middle1, &result.upperbound1, 2*offset, false);
+            }
+        }
+        if(backwardHeap2->Size() > 0) {
+            while(forwardHeap2->Size() + backwardHeap2->Size() > 0){
+                if(forwardHeap2->Size() > 0){
+                    super::RoutingStep(forwardHeap2, backwardHeap2, &result.middle2, &result.upperbound2, 2*offset, true);
+                }
+                if(backwardHeap2->Size() > 0){
+                    super::RoutingStep(backwardHeap2, forwardHeap2, &result.middle2, &result.upperbound2, 2*offset, false);
+                }
+            }
+        }
+
+        //Retrieve packed paths if they exist
+        if(INT_MAX != result.upperbound1) {
+            super::RetrievePackedPathFromHeap(forwardHeap, backwardHeap, result.middle1, result.packedPath1);
+        }
+        if(INT_MAX != result.upperbound2) {
+            super::RetrievePackedPathFromHeap(forwardHeap2, backwardHeap2, result.middle2, result.packedPath2);
+        }
+    }
+
     template<class ContainerT>
     void _RemoveConsecutiveDuplicatesFromContainer(ContainerT & packedPath) {
         //remove consecutive duplicates
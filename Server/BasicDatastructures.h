@@ -25,9 +25,9 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 namespace http {
 
-const std::string okString 					= "HTTP/1.0 200 OK\r\n";
-const std::string badRequestString 			= "HTTP/1.0 400 Bad Request\r\n";
-const std::string internalServerErrorString = "HTTP/1.0 500 Internal Server Error\r\n";
+const std::string okString 					= "HTTP/1.1 200 OK\r\n";
+const std::string badRequestString 			= "HTTP/1.1 400 Bad Request\r\n";
+const std::string internalServerErrorString = "HTTP/1.1 500 Internal Server Error\r\n";
 
 const char okHTML[] 				 = "";
 const char badRequestHTML[] 		 = "<html><head><title>Bad Request</title></head><body><h1>400 Bad Request</h1></body></html>";
@@ -51,10 +51,21 @@ enum CompressionType {
 } Compression;
 
 struct Request {
+    Request() : keepAlive(false) {}
 	std::string uri;
 	std::string referrer;
 	std::string agent;
 	boost::asio::ip::address endpoint;
+	//HTTP/1.1 unless "Connection: close", HTTP/1.0 only with "Connection: keep-alive"
+	bool keepAlive;
+	//for the next request on the same connection, keeps the memory of the strings
+	void Clear() {
+	    uri.clear();
+	    referrer.clear();
+	    agent.clear();
+	    endpoint = boost::asio::ip::address();
+	    keepAlive = false;
+	}
 };
 
 struct Reply {
@@ -70,6 +81,18 @@ struct Reply {
     std::vector<boost::asio::const_buffer> HeaderstoBuffers();
 	std::string content;
 	static Reply stockReply(status_type status);
+	void Clear() {
+	    status = ok;
+	    headers.clear();
+	    content.clear();
+	}
+	bool HasHeader(const std::string & name) const {
+	    for (std::size_t i = 0; i < headers.size(); ++i) {
+	        if(name == headers[i].name)
+	            return true;
+	    }
+	    return false;
+	}
 	void setSize(unsigned size) {
 	    for (std::size_t i = 0; i < headers.size(); ++i) {
 	            Header& h = headers[i];
@@ -24,6 +24,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <vector>
 
 #include <boost/asio.hpp>
+#include <boost/asio/deadline_timer.hpp>
 #include <boost/array.hpp>
 #include <boost/bind.hpp>
 #include <boost/noncopyable.hpp>
@@ -39,10 +40,18 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 namespace http {
 
-/// Represents a single connection from a client.
+/// Represents a single connection from a client. Requests on a persistent connection, pipelined or not, are
+/// answered one after the other in the order of their arrival.
 class Connection : public boost::enable_shared_from_this<Connection>, private boost::noncopyable {
 public:
-	explicit Connection(boost::asio::io_service& io_service, RequestHandler& handler) : strand(io_service), TCPsocket(io_service), requestHandler(handler) {}
+	//seconds that a persistent connection may idle before it is closed, 0 answers only one request
+	static const unsigned DEFAULT_KEEP_ALIVE_TIMEOUT = 5;
+	//requests per connection, 0 means no limit
+	static const unsigned DEFAULT_MAX_NUMBER_OF_REQUESTS = 100;
+
+	explicit Connection(boost::asio::io_service& io_service, RequestHandler& handler, const unsigned timeout = DEFAULT_KEEP_ALIVE_TIMEOUT, const unsigned maxRequests = DEFAULT_MAX_NUMBER_OF_REQUESTS) :
+	        strand(io_service), TCPsocket(io_service), idleTimer(io_service), requestHandler(handler), keepAliveTimeout(timeout), maxNumberOfRequests(maxRequests),
+	        numberOfRequests(0), keepAlive(false), compressionType(noCompression), unparsedBegin(NULL), unparsedEnd(NULL) {}
 
 	boost::asio::ip::tcp::socket& socket() {
 		return TCPsocket;
@@ -50,30 +59,45 @@ public:
 
 	/// Start the first asynchronous operation for the connection.
 	void start() {
-	    TCPsocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+		ReadRequest();
 	}
 
 private:
+	//reads more of the current request, the idle timer runs while waiting for data
+	void ReadRequest() {
+		if(0 < keepAliveTimeout) {
+			idleTimer.expires_from_now(boost::posix_time::seconds(keepAliveTimeout));
+			idleTimer.async_wait(strand.wrap( boost::bind(&Connection::handleTimeout, this->shared_from_this(), boost::asio::placeholders::error)));
+		}
+		TCPsocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+	}
+
 	void handleRead(const boost::system::error_code& e, std::size_t bytes_transferred) {
 		if (!e) {
-			CompressionType compressionType(noCompression);
-			boost::tribool result;
-			boost::tie(result, boost::tuples::ignore) = requestParser.Parse( request, incomingDataBuffer.data(), incomingDataBuffer.data() + bytes_transferred, &compressionType);
-
-			if (result) {
-				//                std::cout << "----" << std::endl;
-				//				if(compressionType == gzipRFC1952)
-				//					std::cout << "[debug] using gzip" << std::endl;
-				//				if(compressionType == deflateRFC1951)
-				//					std::cout << "[debug] using deflate" << std::endl;
-				//				if(compressionType == noCompression)
-				//					std::cout << "[debug] no compression" << std::endl;
-			    request.endpoint = TCPsocket.remote_endpoint().address();
-				requestHandler.handle_request(request, reply);
+			ParseRequest(incomingDataBuffer.data(), incomingDataBuffer.data() + bytes_transferred);
+		} else {
+			StopIdleTimer();
+		}
+	}
+
+	//The data after a complete request is kept for the next one. More data is only read once it is used up.
+	void ParseRequest(char * begin, char * end) {
+		boost::tribool result;
+		boost::tie(result, unparsedBegin) = requestParser.Parse( request, begin, end, &compressionType);
+		unparsedEnd = end;
+
+		if (result) {
+			StopIdleTimer();
+			++numberOfRequests;
+			boost::system::error_code ignoredEC;
+			request.endpoint = TCPsocket.remote_endpoint(ignoredEC).address();
+			const RequestHandler::PluginSetPointer plugins = requestHandler.GetPlugins();
+			requestHandler.ParseRequest(plugins, request, parsedRequest);
+			if(!requestHandler.FetchCachedReply(plugins, parsedRequest, request, compressionType, reply)) {
+				requestHandler.handle_request(parsedRequest, request, reply);
 
 				Header compressionHeader;
 				std::vector<unsigned char> compressed;
-				std::vector<boost::asio::const_buffer> outputBuffer;
 				switch(compressionType) {
 				case deflateRFC1951:
 					compressionHeader.name = "Content-Encoding";
@@ -81,9 +105,7 @@ private:
 					reply.headers.insert(reply.headers.begin(), compressionHeader);   //push_back(compressionHeader);
 					compressCharArray(reply.content.c_str(), reply.content.length(), compressed, compressionType);
 					reply.setSize(compressed.size());
-					outputBuffer = reply.HeaderstoBuffers();
-					outputBuffer.push_back(boost::asio::buffer(compressed));
-					boost::asio::async_write(TCPsocket, outputBuffer, strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
+					reply.content.assign(compressed.begin(), compressed.end());
 					break;
 				case gzipRFC1952:
 					compressionHeader.name = "Content-Encoding";
@@ -91,34 +113,76 @@ private:
 					reply.headers.insert(reply.headers.begin(), compressionHeader);
 					compressCharArray(reply.content.c_str(), reply.content.length(), compressed, compressionType);
 					reply.setSize(compressed.size());
-					outputBuffer = reply.HeaderstoBuffers();
-					outputBuffer.push_back(boost::asio::buffer(compressed));
-					boost::asio::async_write(TCPsocket, outputBuffer, strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));break;
+					reply.content.assign(compressed.begin(), compressed.end());
+					break;
 				case noCompression:
-					boost::asio::async_write(TCPsocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
 					break;
 				}
-
-			} else if (!result) {
-				reply = Reply::stockReply(Reply::badRequest);
-				boost::asio::async_write(TCPsocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
-			} else {
-				TCPsocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+				requestHandler.CacheReply(parsedRequest, reply);
 			}
+			//the client only finds the end of a reply by its length
+			keepAlive = (request.keepAlive && 0 < keepAliveTimeout && (0 == maxNumberOfRequests || numberOfRequests < maxNumberOfRequests) && reply.HasHeader("Content-Length"));
+			WriteReply();
+		} else if (!result) {
+			StopIdleTimer();
+			reply = Reply::stockReply(Reply::badRequest);
+			keepAlive = false;
+			WriteReply();
+		} else {
+			ReadRequest();
 		}
 	}
 
+	void WriteReply() {
+		Header connectionHeader;
+		connectionHeader.name = "Connection";
+		connectionHeader.value = (keepAlive ? "keep-alive" : "close");
+		reply.headers.push_back(connectionHeader);
+		boost::asio::async_write(TCPsocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
+	}
+
 	/// Handle completion of a write operation.
 	void handleWrite(const boost::system::error_code& e) {
-		if (!e) {
+		if (e) {
+			return;
+		}
+		if (!keepAlive) {
 			// Initiate graceful connection closure.
 			boost::system::error_code ignoredEC;
 			TCPsocket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignoredEC);
+			// No new asynchronous operations are started. This means that all shared_ptr
+			// references to the connection object will disappear and the object will be
+			// destroyed automatically after this handler returns. The connection class's
+			// destructor closes the socket.
+			return;
+		}
+		request.Clear();
+		requestParser.Reset();
+		compressionType = noCompression;
+		reply.Clear();
+		if(unparsedBegin != unparsedEnd) {
+			//pipelined request
+			ParseRequest(unparsedBegin, unparsedEnd);
+		} else {
+			ReadRequest();
 		}
-		// No new asynchronous operations are started. This means that all shared_ptr
-		// references to the connection object will disappear and the object will be
-		// destroyed automatically after this handler returns. The connection class's
-		// destructor closes the socket.
+	}
+
+	void handleTimeout(const boost::system::error_code& e) {
+		//the timer was stopped or restarted meanwhile
+		if (boost::asio::error::operation_aborted == e || idleTimer.expires_at() > boost::asio::deadline_timer::traits_type::now()) {
+			return;
+		}
+		//cancels the pending read, whose handler then releases the connection
+		boost::system::error_code ignoredEC;
+		TCPsocket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignoredEC);
+		TCPsocket.close(ignoredEC);
+	}
+
+	//a handler that is already queued sees the timer as not expired
+	void StopIdleTimer() {
+		boost::system::error_code ignoredEC;
+		idleTimer.expires_at(boost::posix_time::pos_infin, ignoredEC);
 	}
 
 	void compressCharArray(const void *in_data, size_t in_data_size, std::vector<unsigned char> &buffer, CompressionType type) {
@@ -170,10 +234,21 @@ private:
 
 	boost::asio::io_service::strand strand;
 	boost::asio::ip::tcp::socket TCPsocket;
+	boost::asio::deadline_timer idleTimer;
 	RequestHandler& requestHandler;
+	const unsigned keepAliveTimeout;
+	const unsigned maxNumberOfRequests;
+	unsigned numberOfRequests;
+	//whether the connection stays open after the current reply
+	bool keepAlive;
+	CompressionType compressionType;
 	boost::array<char, 8192> incomingDataBuffer;
+	//data in incomingDataBuffer that belongs to the next request
+	char * unparsedBegin;
+	char * unparsedEnd;
 	Request request;
 	RequestParser requestParser;
+	RequestHandler::_StrParsedRequest parsedRequest;
 	Reply reply;
 };
 
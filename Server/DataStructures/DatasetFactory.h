@@ -0,0 +1,139 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef DATASETFACTORY_H_
+#define DATASETFACTORY_H_
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "../../DataStructures/ContainerFile.h"
+#include "../ServerConfiguration.h"
+#include "SharedDataset.h"
+
+//reads the data files named in server.ini into the blocks of a dataset, errors are thrown as std::runtime_error
+struct DatasetFactory {
+    //The checksums of all files are verified before the dataset is created. Generation 0
+    //creates the dataset in memory of this process instead of shared memory.
+    static SharedDataset * CreateDataset(ServerConfiguration & serverConfig, const unsigned generation) {
+        const std::string hsgrPath = serverConfig.GetParameter("hsgrData");
+        const std::string edgesPath = serverConfig.GetParameter("edgesData");
+        const std::string namesPath = serverConfig.GetParameter("namesData");
+        const std::string ramIndexPath = serverConfig.GetParameter("ramIndex");
+        const std::string fileIndexPath = serverConfig.GetParameter("fileIndex");
+        const std::string rtreePath = serverConfig.GetParameter("rtreeData");
+        const std::string timestampPath = serverConfig.GetParameter("timestamp");
+        //the r-tree replaces the grid, which is only read for data that has none
+        const bool useRTree = rtreePath.length();
+
+        //the graph, the original edges, the names and the r-tree are used as containers, the index files only with the contents of a section
+        boost::scoped_ptr<ContainerFile> graphFile(OpenVerifiedContainer(hsgrPath, ContainerFormat::GRAPH_FILE));
+        boost::scoped_ptr<ContainerFile> edgesFile(OpenVerifiedContainer(edgesPath, ContainerFormat::EDGES_FILE));
+        boost::scoped_ptr<ContainerFile> namesFile(OpenVerifiedContainer(namesPath, ContainerFormat::NAMES_FILE));
+        boost::scoped_ptr<ContainerFile> rtreeFile(useRTree ? OpenVerifiedContainer(rtreePath, ContainerFormat::RTREE_FILE) : NULL);
+        boost::scoped_ptr<ContainerFile> ramIndexFile(useRTree ? NULL : OpenVerifiedContainer(ramIndexPath, ContainerFormat::RAM_INDEX_FILE));
+        boost::scoped_ptr<ContainerFile> fileIndexFile(useRTree ? NULL : OpenVerifiedContainer(fileIndexPath, ContainerFormat::FILE_INDEX_FILE));
+        if(!useRTree && 1024*1024*sizeof(unsigned long) != ramIndexFile->GetSectionSize(ContainerFormat::RAM_INDEX_SECTION)) {
+            throw std::runtime_error(ramIndexPath + " has an unexpected size");
+        }
+        if(!edgesFile->HasSection(ContainerFormat::EDGE_LINES_SECTION)) {
+            throw std::runtime_error(edgesPath + " is in an old format, rerun osrm-prepare");
+        }
+
+        std::vector<unsigned long long> blockSizes(SharedDataset::NUMBER_OF_BLOCKS, 0);
+        blockSizes[SharedDataset::GRAPH] = GetFileSize(hsgrPath);
+        blockSizes[SharedDataset::ORIGINAL_EDGES] = GetFileSize(edgesPath);
+        blockSizes[SharedDataset::NAMES] = GetFileSize(namesPath);
+        if(useRTree) {
+            blockSizes[SharedDataset::RTREE] = GetFileSize(rtreePath);
+        } else {
+            blockSizes[SharedDataset::RAM_INDEX] = ramIndexFile->GetSectionSize(ContainerFormat::RAM_INDEX_SECTION);
+            blockSizes[SharedDataset::FILE_INDEX] = fileIndexFile->GetSectionSize(ContainerFormat::FILE_INDEX_SECTION);
+        }
+        if(timestampPath.length() && std::ifstream(timestampPath.c_str()).good()) {
+            blockSizes[SharedDataset::TIMESTAMP] = GetFileSize(timestampPath);
+        }
+
+        std::auto_ptr<SharedDataset> dataset(new SharedDataset(generation, blockSizes));
+        _StrSegmentRemover remover(generation);
+        ReadFileIntoBlock(hsgrPath, *dataset, SharedDataset::GRAPH);
+        ReadFileIntoBlock(edgesPath, *dataset, SharedDataset::ORIGINAL_EDGES);
+        ReadFileIntoBlock(namesPath, *dataset, SharedDataset::NAMES);
+        if(0 != blockSizes[SharedDataset::TIMESTAMP]) {
+            ReadFileIntoBlock(timestampPath, *dataset, SharedDataset::TIMESTAMP);
+        }
+        if(useRTree) {
+            ReadFileIntoBlock(rtreePath, *dataset, SharedDataset::RTREE);
+        } else {
+            memcpy(dataset->GetWritableBlock(SharedDataset::RAM_INDEX), ramIndexFile->GetSection(ContainerFormat::RAM_INDEX_SECTION), blockSizes[SharedDataset::RAM_INDEX]);
+            memcpy(dataset->GetWritableBlock(SharedDataset::FILE_INDEX), fileIndexFile->GetSection(ContainerFormat::FILE_INDEX_SECTION), blockSizes[SharedDataset::FILE_INDEX]);
+        }
+        remover.Release();
+        return dataset.release();
+    }
+
+private:
+    //unlinks the shared memory segment of a dataset that is not returned, i.e. if reading a file throws
+    struct _StrSegmentRemover : private boost::noncopyable {
+        explicit _StrSegmentRemover(const unsigned generation) : generation(generation) { }
+        ~_StrSegmentRemover() {
+            SharedDataset::Remove(generation);
+        }
+        void Release() {
+            generation = 0;
+        }
+        unsigned generation;
+    };
+
+    static unsigned long long GetFileSize(const std::string & fileName) {
+        std::ifstream in(fileName.c_str(), std::ios::binary);
+        in.seekg(0, std::ios::end);
+        return in.tellg();
+    }
+
+    static void ReadFileIntoBlock(const std::string & fileName, SharedDataset & dataset, const SharedDataset::BlockID block) {
+        std::ifstream in(fileName.c_str(), std::ios::binary);
+        in.read(dataset.GetWritableBlock(block), dataset.GetBlockSize(block));
+        if(in.fail()) {
+            throw std::runtime_error("could not read " + fileName);
+        }
+    }
+
+    static ContainerFile * OpenVerifiedContainer(const std::string & fileName, const ContainerFormat::FileType fileType) {
+        if(!std::ifstream(fileName.c_str()).good()) {
+            throw std::runtime_error(fileName + " is missing, check server.ini");
+        }
+        if(!ContainerFile::IsContainerFile(fileName.c_str())) {
+            throw std::runtime_error(fileName + " is in an old format, rerun osrm-prepare");
+        }
+        std::auto_ptr<ContainerFile> container(new ContainerFile(fileName.c_str(), fileType));
+        container->VerifyAllSections();
+        return container.release();
+    }
+};
+
+#endif /* DATASETFACTORY_H_ */
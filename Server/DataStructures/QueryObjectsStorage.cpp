@@ -19,63 +19,252 @@ or see http://www.gnu.org/licenses/agpl.txt.
  */
 
 
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 #include "QueryObjectsStorage.h"
+#include "../../DataStructures/Util.h"
 #include "../../Util/GraphLoader.h"
 
-QueryObjectsStorage::QueryObjectsStorage(std::string hsgrPath, std::string ramIndexPath, std::string fileIndexPath, std::string nodesPath, std::string edgesPath, std::string namesPath, std::string timestampPath, std::string psd) {
+static void LogLoadingTime(const std::string & fileName, const double startTime) {
+	INFO("Loaded " << fileName << " in " << get_timestamp() - startTime << " sec");
+}
+
+QueryObjectsStorage::QueryObjectsStorage(std::string hsgrPath, std::string ramIndexPath, std::string fileIndexPath, std::string rtreePath, std::string nodesPath, std::string edgesPath, std::string namesPath, std::string timestampPath, std::string levelsPath, std::string shortcutsPath, std::string lengthsPath, std::string psd) : nodeHelpDesk(NULL), names(NULL), graph(NULL), levelOrderedGraph(NULL), unpackingIndex(NULL), edgeLengthTable(NULL), sharedDataset(NULL) {
+	double startupTime = get_timestamp();
 	INFO("loading graph data");
-	std::ifstream hsgrInStream(hsgrPath.c_str(), std::ios::binary);
-	//Deserialize road network graph
-	std::vector< QueryGraph::_StrNode> nodeList;
-	std::vector< QueryGraph::_StrEdge> edgeList;
-	const int n = readHSGRFromStream(hsgrInStream, nodeList, edgeList, &checkSum);
+	int n = 0;
+	if(ContainerFile::IsContainerFile(hsgrPath.c_str())) {
+	    //used in place, nothing is copied
+	    graph = new QueryGraph(hsgrPath.c_str(), &checkSum);
+	    n = graph->GetNumberOfNodes();
+	} else {
+	    INFO(hsgrPath << " is in the old format and is copied into memory, rerun osrm-prepare for faster startup");
+	    std::ifstream hsgrInStream(hsgrPath.c_str(), std::ios::binary);
+	    //Deserialize road network graph
+	    std::vector< QueryGraph::_StrNode> nodeList;
+	    std::vector< QueryGraph::_StrEdge> edgeList;
+	    n = readHSGRFromStream(hsgrInStream, nodeList, edgeList, &checkSum);
+	    hsgrInStream.close();
 
+	    graph = new QueryGraph(nodeList, edgeList);
+	    assert(0 == nodeList.size());
+	    assert(0 == edgeList.size());
+	}
 	INFO("Data checksum is " << checkSum);
-	graph = new QueryGraph(nodeList, edgeList);
-	assert(0 == nodeList.size());
-	assert(0 == edgeList.size());
 
+	if(graph->EdgesWereReordered()) {
+	    WARN("Edges of " << hsgrPath << " are not in split order, rerun osrm-prepare for faster queries");
+	}
+	LogLoadingTime(hsgrPath, startupTime);
+
+	//the remaining files are independent of each other and are loaded in parallel, each one by a thread of its own
+	try {
+	    nodeHelpDesk = new NodeInformationHelpDesk(rtreePath, ramIndexPath.c_str(), fileIndexPath.c_str(), n, checkSum);
+	} catch(...) {
+	    //the destructor does not run for an object that was not constructed
+	    DeleteData();
+	    throw;
+	}
+	boost::thread_group loaders;
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadOriginalEdges, this, edgesPath, nodesPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadRAMIndex, this, (rtreePath.empty() ? ramIndexPath : rtreePath)));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadNamesFromFile, this, namesPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadTimestamp, this, timestampPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadShortcuts, this, shortcutsPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadLengths, this, lengthsPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadLevels, this, levelsPath));
+	loaders.join_all();
+	if(!loadingError.empty()) {
+	    DeleteData();
+	    throw std::runtime_error(loadingError);
+	}
+	INFO("All query data structures loaded after " << get_timestamp() - startupTime << " sec");
+}
+
+QueryObjectsStorage::QueryObjectsStorage(SharedDataset * dataset, std::string levelsPath, std::string shortcutsPath, std::string lengthsPath) : nodeHelpDesk(NULL), names(NULL), graph(NULL), levelOrderedGraph(NULL), unpackingIndex(NULL), edgeLengthTable(NULL), sharedDataset(dataset) {
+	//the dataset and everything that was attached to it are released if a part is damaged
+	try {
+	    INFO("attaching to graph data of dataset " << sharedDataset->GetGeneration());
+	    graph = new QueryGraph(sharedDataset->GetBlock(SharedDataset::GRAPH), sharedDataset->GetBlockSize(SharedDataset::GRAPH), &checkSum);
+	    INFO("Data checksum is " << checkSum);
+
+	    LoadOptionalData(levelsPath, shortcutsPath, lengthsPath);
+
+	    timestamp = std::string(sharedDataset->GetBlock(SharedDataset::TIMESTAMP), sharedDataset->GetBlockSize(SharedDataset::TIMESTAMP));
+	    timestamp = timestamp.substr(0, timestamp.find('\n'));
+	    if(!timestamp.length())
+	        timestamp = "n/a";
+	    if(15 < timestamp.length())
+	        timestamp.resize(15);
+
+	    nodeHelpDesk = new NodeInformationHelpDesk(
+	            sharedDataset->GetBlock(SharedDataset::ORIGINAL_EDGES),
+	            sharedDataset->GetBlockSize(SharedDataset::ORIGINAL_EDGES),
+	            sharedDataset->GetBlock(SharedDataset::RTREE),
+	            sharedDataset->GetBlockSize(SharedDataset::RTREE),
+	            reinterpret_cast<const unsigned long *>(sharedDataset->GetBlock(SharedDataset::RAM_INDEX)),
+	            sharedDataset->GetBlock(SharedDataset::FILE_INDEX),
+	            sharedDataset->GetBlockSize(SharedDataset::FILE_INDEX),
+	            graph->GetNumberOfNodes(),
+	            checkSum
+	    );
+
+	    names = new NameTable(sharedDataset->GetBlock(SharedDataset::NAMES), sharedDataset->GetBlockSize(SharedDataset::NAMES));
+	} catch(...) {
+	    DeleteData();
+	    throw;
+	}
+	INFO("All query data structures attached");
+}
+
+//runs a loader in a thread of its own, the first error is kept so that the constructor can pass it on
+void QueryObjectsStorage::StartLoader(boost::thread_group & loaders, boost::function<void ()> loader) {
+	loaders.create_thread(boost::bind(&QueryObjectsStorage::RunLoader, this, loader));
+}
+
+void QueryObjectsStorage::RunLoader(boost::function<void ()> loader) {
+	try {
+	    loader();
+	} catch(std::exception & e) {
+	    boost::mutex::scoped_lock lock(loadingErrorMutex);
+	    if(loadingError.empty())
+	        loadingError = e.what();
+	}
+}
+
+void QueryObjectsStorage::LoadTimestamp(std::string timestampPath) {
+	double startTime = get_timestamp();
 	if(timestampPath.length()) {
-	    INFO("Loading Timestamp")
-	        std::ifstream timestampInStream(timestampPath.c_str());
+	    std::ifstream timestampInStream(timestampPath.c_str());
 	    getline(timestampInStream, timestamp);
 	    timestampInStream.close();
+	    LogLoadingTime(timestampPath, startTime);
 	}
 	if(!timestamp.length())
 	    timestamp = "n/a";
 	if(15 < timestamp.length())
 	    timestamp.resize(15);
+}
+
+void QueryObjectsStorage::LoadOriginalEdges(std::string edgesPath, std::string nodesPath) {
+	double startTime = get_timestamp();
+	nodeHelpDesk->LoadOriginalEdges(edgesPath.c_str(), nodesPath.c_str());
+	LogLoadingTime(edgesPath, startTime);
+}
 
-    INFO("Loading auxiliary information");
-    //Init nearest neighbor data structure
-	std::ifstream nodesInStream(nodesPath.c_str(), std::ios::binary);
-    std::ifstream edgesInStream(edgesPath.c_str(), std::ios::binary);
-	nodeHelpDesk = new NodeInformationHelpDesk(ramIndexPath.c_str(), fileIndexPath.c_str(), n, checkSum);
-	nodeHelpDesk->initNNGrid(nodesInStream, edgesInStream);
+void QueryObjectsStorage::LoadRAMIndex(std::string ramIndexPath) {
+	double startTime = get_timestamp();
+	//Init nearest neighbor data structure
+	nodeHelpDesk->initNNGrid();
+	LogLoadingTime(ramIndexPath, startTime);
+}
 
+void QueryObjectsStorage::LoadNamesFromFile(std::string namesPath) {
+	double startTime = get_timestamp();
 	//deserialize street name list
-	INFO("Loading names index");
-	std::ifstream namesInStream(namesPath.c_str(), std::ios::binary);
-	unsigned size(0);
-	namesInStream.read((char *)&size, sizeof(unsigned));
-	//        names = new std::vector<std::string>();
-
-	char buf[1024];
-	for(unsigned i = 0; i < size; ++i) {
-		unsigned sizeOfString = 0;
-		namesInStream.read((char *)&sizeOfString, sizeof(unsigned));
-		buf[sizeOfString] = '\0'; // instead of memset
-		namesInStream.read(buf, sizeOfString);
-		names.push_back(buf);
+	names = new NameTable(namesPath.c_str());
+	LogLoadingTime(namesPath, startTime);
+}
+
+void QueryObjectsStorage::LoadOptionalData(std::string levelsPath, std::string shortcutsPath, std::string lengthsPath) {
+	boost::thread_group loaders;
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadShortcuts, this, shortcutsPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadLengths, this, lengthsPath));
+	StartLoader(loaders, boost::bind(&QueryObjectsStorage::LoadLevels, this, levelsPath));
+	loaders.join_all();
+	if(!loadingError.empty()) {
+	    throw std::runtime_error(loadingError);
 	}
-	std::vector<std::string>(names).swap(names);
-	hsgrInStream.close();
-	namesInStream.close();
-	INFO("All query data structures loaded");
+}
+
+void QueryObjectsStorage::LoadShortcuts(std::string shortcutsPath) {
+	double startTime = get_timestamp();
+	if(shortcutsPath.length()) {
+	    std::ifstream shortcutsInStream(shortcutsPath.c_str(), std::ios::binary);
+	    std::vector<ShortcutUnpackingIndex::_StrEdgeHalves> halvesList;
+	    unsigned shortcutsCheckSum = 0;
+	    if(!shortcutsInStream.is_open()) {
+	        WARN("Could not open " << shortcutsPath << ", shortcuts are unpacked without index");
+	    } else if(graph->EdgesWereReordered()) {
+	        WARN("Edge ids of " << shortcutsPath << " do not match the reordered graph, shortcuts are unpacked without index");
+	    } else if(readShortcutsFromStream(shortcutsInStream, halvesList, &shortcutsCheckSum) == 2*graph->GetNumberOfEdges() && shortcutsCheckSum == checkSum) {
+	        unpackingIndex = new ShortcutUnpackingIndex(halvesList);
+	    } else {
+	        WARN("Shortcut unpacking index does not match graph data, shortcuts are unpacked without index");
+	    }
+	    shortcutsInStream.close();
+	    LogLoadingTime(shortcutsPath, startTime);
+	}
+}
+
+void QueryObjectsStorage::LoadLengths(std::string lengthsPath) {
+	double startTime = get_timestamp();
+	if(lengthsPath.length()) {
+	    std::ifstream lengthsInStream(lengthsPath.c_str(), std::ios::binary);
+	    std::vector<unsigned> nodeLengths;
+	    std::vector<unsigned> edgeLengths;
+	    unsigned lengthsCheckSum = 0;
+	    if(!lengthsInStream.is_open()) {
+	        WARN("Could not open " << lengthsPath << ", summary queries unpack the route");
+	    } else if(graph->EdgesWereReordered()) {
+	        WARN("Edge ids of " << lengthsPath << " do not match the reordered graph, summary queries unpack the route");
+	    } else if(readLengthsFromStream(lengthsInStream, nodeLengths, edgeLengths, &lengthsCheckSum) == 2*graph->GetNumberOfEdges() && lengthsCheckSum == checkSum) {
+	        edgeLengthTable = new EdgeLengthTable(nodeLengths, edgeLengths);
+	    } else {
+	        WARN("Edge length table does not match graph data, summary queries unpack the route");
+	    }
+	    lengthsInStream.close();
+	    LogLoadingTime(lengthsPath, startTime);
+	}
+}
+
+void QueryObjectsStorage::LoadLevels(std::string levelsPath) {
+	double startTime = get_timestamp();
+	if(levelsPath.length()) {
+	    std::ifstream levelsInStream(levelsPath.c_str(), std::ios::binary);
+	    std::vector<NodeID> originalNodeIDs;
+	    std::vector<_Coordinate> coordinates;
+	    std::vector<LevelOrderedGraph::_StrNode> levelNodeList;
+	    std::vector<LevelOrderedGraph::_StrEdge> levelEdgeList;
+	    unsigned levelsCheckSum = 0;
+	    if(!levelsInStream.is_open()) {
+	        WARN("Could not open " << levelsPath << ", one-to-all queries are disabled");
+	    } else if(readLevelsFromStream(levelsInStream, originalNodeIDs, coordinates, levelNodeList, levelEdgeList, &levelsCheckSum) && levelsCheckSum == checkSum) {
+	        levelOrderedGraph = new LevelOrderedGraph(originalNodeIDs, coordinates, levelNodeList, levelEdgeList);
+	    } else {
+	        WARN("Level ordered graph does not match graph data, one-to-all queries are disabled");
+	    }
+	    levelsInStream.close();
+	    LogLoadingTime(levelsPath, startTime);
+	}
+}
+
+void QueryObjectsStorage::ApplyResidencyPolicies(const ResidencyPolicy & graphPolicy, const ResidencyPolicy & originalEdgesPolicy, const ResidencyPolicy & namesPolicy, const ResidencyPolicy & indexPolicy) {
+	double startTime = get_timestamp();
+	graph->ApplyResidencyPolicy(graphPolicy);
+	nodeHelpDesk->ApplyResidencyPolicies(originalEdgesPolicy, indexPolicy);
+	names->ApplyResidencyPolicy(namesPolicy);
+	if(NULL != sharedDataset && 0 != sharedDataset->GetBlockSize(SharedDataset::FILE_INDEX)) {
+	    //the cells of the grid are only in memory if they come from a dataset
+	    indexPolicy.Apply(sharedDataset->GetBlock(SharedDataset::FILE_INDEX), sharedDataset->GetBlockSize(SharedDataset::FILE_INDEX), "grid cells");
+	}
+	INFO("Applied residency policies in " << get_timestamp() - startTime << " sec");
 }
 
 QueryObjectsStorage::~QueryObjectsStorage() {
-	//        delete names;
+	DeleteData();
+}
+
+void QueryObjectsStorage::DeleteData() {
+	delete names;
 	delete graph;
+	delete levelOrderedGraph;
+	delete unpackingIndex;
+	delete edgeLengthTable;
 	delete nodeHelpDesk;
+	//the data above may point into the shared dataset
+	delete sharedDataset;
 }
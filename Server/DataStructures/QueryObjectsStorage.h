@@ -25,23 +25,61 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include<vector>
 #include<string>
 
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include "../../DataStructures/ContainerFile.h"
+#include "../../DataStructures/EdgeLengthTable.h"
+#include "../../DataStructures/LevelOrderedGraph.h"
+#include "../../DataStructures/NameTable.h"
 #include "../../DataStructures/NodeInformationHelpDesk.h"
 #include "../../DataStructures/QueryEdge.h"
-#include "../../DataStructures/StaticGraph.h"
+#include "../../DataStructures/ShortcutUnpackingIndex.h"
+#include "../../DataStructures/SplitStaticGraph.h"
+#include "../../Util/ResidencyPolicy.h"
+#include "SharedDataset.h"
 
 struct QueryObjectsStorage {
-    typedef StaticGraph<QueryEdge::EdgeData> QueryGraph;
+    typedef SplitStaticGraph<QueryEdge::EdgeData> QueryGraph;
     typedef QueryGraph::InputEdge InputEdge;
 
     NodeInformationHelpDesk * nodeHelpDesk;
-    std::vector<std::string> names;
+    NameTable * names;
     QueryGraph * graph;
+    LevelOrderedGraph * levelOrderedGraph;
+    ShortcutUnpackingIndex * unpackingIndex;
+    EdgeLengthTable * edgeLengthTable;
     std::string timestamp;
     unsigned checkSum;
+    //owns the memory of the data above if they were attached from shared memory
+    SharedDataset * sharedDataset;
+
+    //throws std::runtime_error if a data file is damaged or of another kind
+    QueryObjectsStorage(std::string hsgrPath, std::string ramIndexPath, std::string fileIndexPath, std::string rtreePath, std::string nodesPath, std::string edgesPath, std::string namesPath, std::string timestampPath, std::string levelsPath, std::string shortcutsPath, std::string lengthsPath, std::string psd = "route");
 
-    QueryObjectsStorage(std::string hsgrPath, std::string ramIndexPath, std::string fileIndexPath, std::string nodesPath, std::string edgesPath, std::string namesPath, std::string timestampPath, std::string psd = "route");
+    //takes ownership of the dataset, optional data that is not in shared memory is still loaded from files
+    QueryObjectsStorage(SharedDataset * dataset, std::string levelsPath, std::string shortcutsPath, std::string lengthsPath);
 
     ~QueryObjectsStorage();
+
+    //keeps the sections in memory as server.ini asks for, see ResidencyPolicy
+    void ApplyResidencyPolicies(const ResidencyPolicy & graphPolicy, const ResidencyPolicy & originalEdgesPolicy, const ResidencyPolicy & namesPolicy, const ResidencyPolicy & indexPolicy);
+
+private:
+    void StartLoader(boost::thread_group & loaders, boost::function<void ()> loader);
+    void RunLoader(boost::function<void ()> loader);
+    void DeleteData();
+    void LoadOptionalData(std::string levelsPath, std::string shortcutsPath, std::string lengthsPath);
+    void LoadShortcuts(std::string shortcutsPath);
+    void LoadLengths(std::string lengthsPath);
+    void LoadLevels(std::string levelsPath);
+    void LoadTimestamp(std::string timestampPath);
+    void LoadOriginalEdges(std::string edgesPath, std::string nodesPath);
+    void LoadRAMIndex(std::string ramIndexPath);
+    void LoadNamesFromFile(std::string namesPath);
+
+    std::string loadingError;
+    boost::mutex loadingErrorMutex;
 };
 
 #endif /* QUERYOBJECTSSTORAGE_H_ */
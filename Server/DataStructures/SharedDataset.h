@@ -0,0 +1,236 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SHAREDDATASET_H_
+#define SHAREDDATASET_H_
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/anonymous_shared_memory.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "../../typedefs.h"
+
+/*
+ * Dataset that osrm-datastore placed into POSIX shared memory. Each dataset
+ * lives in a segment of its own and holds the contents of the data files in
+ * blocks that are aligned to a cache line. A small control segment names the
+ * current dataset. osrm-datastore loads a new dataset next to the current one,
+ * makes it current and unlinks the old segment, which stays valid for every
+ * osrm-routed process that still has it attached. Datasets of generation 0
+ * live in memory of this process only, e.g. the replicas that osrm-routed
+ * keeps on each NUMA node.
+ */
+class SharedDataset : private boost::noncopyable {
+public:
+    enum BlockID {
+        GRAPH = 0,      //.hsgr as is
+        ORIGINAL_EDGES, //.edges as is
+        NAMES,          //.names as is
+        RAM_INDEX,      //first level of the grid from .ramIndex, empty if there is an r-tree
+        FILE_INDEX,     //cells of the grid from .fileIndex, empty if there is an r-tree
+        RTREE,          //.rtree as is, empty if the grid is used
+        TIMESTAMP,      //.timestamp as is
+        NUMBER_OF_BLOCKS
+    };
+
+    //creates a new segment for the given generation with blocks of the given sizes, or private memory for generation 0
+    SharedDataset(const unsigned generation, const std::vector<unsigned long long> & blockSizes) {
+        assert(NUMBER_OF_BLOCKS == blockSizes.size());
+        _StrLayout layout;
+        layout.magic = LAYOUT_MAGIC;
+        layout.version = LAYOUT_VERSION;
+        layout.generation = generation;
+        unsigned long long offset = Align(sizeof(_StrLayout));
+        for(unsigned i = 0; i < NUMBER_OF_BLOCKS; ++i) {
+            layout.offsets[i] = offset;
+            layout.sizes[i] = blockSizes[i];
+            offset = Align(offset + blockSizes[i]);
+        }
+
+        CreateRegion(generation, offset);
+        memcpy(_region.get_address(), &layout, sizeof(_StrLayout));
+    }
+
+    //Copy in memory of this process that keeps the generation of this dataset. The pages are
+    //allocated on the NUMA node of the calling thread, which touches each of them first.
+    SharedDataset * CreatePrivateCopy() const {
+        SharedDataset * copy = new SharedDataset();
+        copy->CreateRegion(0, _region.get_size());
+        memcpy(copy->_region.get_address(), _region.get_address(), _region.get_size());
+        return copy;
+    }
+
+    //NULL if osrm-datastore has not loaded any dataset yet
+    static SharedDataset * AttachToCurrent() {
+        try {
+            boost::interprocess::managed_shared_memory control(boost::interprocess::open_only, GetControlSegmentName());
+            _StrControl * current = control.find<_StrControl>("current").first;
+            if(NULL == current) {
+                return NULL;
+            }
+            //the segment is not unlinked while the lock is held
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(current->mutex);
+            if(0 == current->generation) {
+                return NULL;
+            }
+            return new SharedDataset(current->generation);
+        } catch(boost::interprocess::interprocess_exception & e) {
+            WARN("cannot attach to shared memory: " << e.what());
+            return NULL;
+        }
+    }
+
+    //0 if osrm-datastore has not loaded any dataset yet
+    static unsigned GetCurrentGeneration() {
+        try {
+            boost::interprocess::managed_shared_memory control(boost::interprocess::open_only, GetControlSegmentName());
+            _StrControl * current = control.find<_StrControl>("current").first;
+            if(NULL == current) {
+                return 0;
+            }
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(current->mutex);
+            return current->generation;
+        } catch(boost::interprocess::interprocess_exception & e) {
+            return 0;
+        }
+    }
+
+    //publishes this dataset and unlinks the one that was current before
+    void MakeCurrent() const {
+        assert(0 != GetGeneration());
+        boost::interprocess::managed_shared_memory control(boost::interprocess::open_or_create, GetControlSegmentName(), 65536);
+        _StrControl * current = control.find_or_construct<_StrControl>("current")();
+        unsigned previousGeneration = 0;
+        {
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(current->mutex);
+            previousGeneration = current->generation;
+            current->generation = GetGeneration();
+        }
+        if(0 != previousGeneration && GetGeneration() != previousGeneration) {
+            boost::interprocess::shared_memory_object::remove(GetSegmentName(previousGeneration).c_str());
+        }
+    }
+
+    //unlinks the segment of a generation, e.g. of a dataset that could not be filled
+    static void Remove(const unsigned generation) {
+        if(0 != generation) {
+            boost::interprocess::shared_memory_object::remove(GetSegmentName(generation).c_str());
+        }
+    }
+
+    inline unsigned GetGeneration() const {
+        return GetLayout().generation;
+    }
+
+    inline const char * GetBlock(const BlockID block) const {
+        return static_cast<const char *>(_region.get_address()) + GetLayout().offsets[block];
+    }
+
+    inline char * GetWritableBlock(const BlockID block) {
+        return static_cast<char *>(_region.get_address()) + GetLayout().offsets[block];
+    }
+
+    inline unsigned long long GetBlockSize(const BlockID block) const {
+        return GetLayout().sizes[block];
+    }
+
+private:
+    struct _StrLayout {
+        unsigned magic;
+        unsigned version;
+        unsigned generation;
+        unsigned long long offsets[NUMBER_OF_BLOCKS];
+        unsigned long long sizes[NUMBER_OF_BLOCKS];
+    };
+
+    struct _StrControl {
+        _StrControl() : generation(0) {}
+        boost::interprocess::interprocess_mutex mutex;
+        unsigned generation;
+    };
+
+    //"OSDS"
+    static const unsigned LAYOUT_MAGIC = 0x5344534f;
+    static const unsigned LAYOUT_VERSION = 4;
+    static const unsigned LAYOUT_ALIGNMENT = 64;
+
+    SharedDataset() { }
+
+    void CreateRegion(const unsigned generation, const unsigned long long size) {
+        if(0 == generation) {
+            boost::interprocess::mapped_region region(boost::interprocess::anonymous_shared_memory(size));
+            _region.swap(region);
+            return;
+        }
+        const std::string name = GetSegmentName(generation);
+        boost::interprocess::shared_memory_object::remove(name.c_str());
+        boost::interprocess::shared_memory_object segment(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+        try {
+            segment.truncate(size);
+            boost::interprocess::mapped_region region(segment, boost::interprocess::read_write);
+            _region.swap(region);
+        } catch(...) {
+            boost::interprocess::shared_memory_object::remove(name.c_str());
+            throw;
+        }
+    }
+
+    //attaches read-only to an existing segment, throws if its layout is not the one of this version
+    explicit SharedDataset(const unsigned generation) {
+        boost::interprocess::shared_memory_object segment(boost::interprocess::open_only, GetSegmentName(generation).c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(segment, boost::interprocess::read_only);
+        _region.swap(region);
+        if(_region.get_size() < sizeof(_StrLayout) || LAYOUT_MAGIC != GetLayout().magic || LAYOUT_VERSION != GetLayout().version) {
+            throw std::runtime_error("shared memory segment " + GetSegmentName(generation) + " was written by an incompatible osrm-datastore");
+        }
+    }
+
+    static inline unsigned long long Align(const unsigned long long offset) {
+        return (offset + LAYOUT_ALIGNMENT - 1)/LAYOUT_ALIGNMENT*LAYOUT_ALIGNMENT;
+    }
+
+    static inline const char * GetControlSegmentName() {
+        return "osrm-datastore";
+    }
+
+    static inline std::string GetSegmentName(const unsigned generation) {
+        return "osrm-dataset-" + boost::lexical_cast<std::string>(generation);
+    }
+
+    inline const _StrLayout & GetLayout() const {
+        return *static_cast<const _StrLayout *>(_region.get_address());
+    }
+
+    boost::interprocess::mapped_region _region;
+};
+
+#endif /* SHAREDDATASET_H_ */
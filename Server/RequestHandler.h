@@ -25,81 +25,119 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <cctype> // std::tolower
 #include <string>
 #include <iostream>
-#include <boost/lexical_cast.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "BasicDatastructures.h"
+#include "../DataStructures/ConcurrentLRUCache.h"
 #include "../DataStructures/HashTable.h"
 #include "../Plugins/BasePlugin.h"
 #include "../Plugins/RouteParameters.h"
+#include "../Util/NUMAUtil.h"
+#include "../Util/StringUtil.h"
 #include "../typedefs.h"
 
 namespace http {
 
 class RequestHandler : private boost::noncopyable {
+    typedef ConcurrentLRUCache<std::string, boost::shared_ptr<const Reply> > ResponseCache;
+
+    //plugins together with the data they work on, freed after the last request that uses them
+    struct _PluginSet : private boost::noncopyable {
+        _PluginSet() : dataChecksum(0) { }
+        ~_PluginSet() {
+            for(unsigned i = 0; i < pluginVector.size(); i++) {
+                BasePlugin * tempPointer = pluginVector[i];
+                delete tempPointer;
+            }
+        }
+        HashTable<std::string, unsigned> pluginMap;
+        std::vector<BasePlugin *> pluginVector;
+        boost::shared_ptr<void> data;
+        //replies are cached per dataset
+        unsigned dataChecksum;
+    };
 public:
-    explicit RequestHandler() : _pluginCount(0) { }
+    //A request works on one snapshot of the plugins from its start to the end. The cached reply,
+    //the handling and the insert into the cache then all refer to the same data.
+    typedef boost::shared_ptr<const _PluginSet> PluginSetPointer;
 
-    ~RequestHandler() {
+    explicit RequestHandler() : _plugins(1, boost::shared_ptr<_PluginSet>(new _PluginSet())), _responseCache(NULL) { }
 
-        for(unsigned i = 0; i < _pluginVector.size(); i++) {
-            BasePlugin * tempPointer = _pluginVector[i];
-            delete tempPointer;
-        }
+    ~RequestHandler() {
+        delete _responseCache;
     }
 
-    void handle_request(const Request& req, Reply& rep){
-        //parse command
-        std::string request(req.uri);
-        time_t ltime;
-        struct tm *Tm;
+    //A request split into the plugin that answers it and its parameters. A connection keeps one for all of
+    //its requests, so that the buffers of the cache key are reused.
+    struct _StrParsedRequest {
+        _StrParsedRequest() : plugin(NULL), pluginIndex(0), tooManyLocations(false) { }
+        //NULL if no plugin answers the command
+        BasePlugin * plugin;
+        unsigned pluginIndex;
+        bool tooManyLocations;
+        RouteParameters routeParameters;
+        std::string cacheKey;
+        std::vector<RouteParameters::OptionsIterator> sortedOptions;
+        std::vector<const std::string *> sortedParameters;
+    };
 
-        ltime=time(NULL);
-        Tm=localtime(&ltime);
+    //one pass over the uri, parts are only copied where a plugin keeps them as a string
+    void ParseRequest(const PluginSetPointer & plugins, const Request& req, _StrParsedRequest & parsedRequest) const {
+        const char * position = req.uri.data() + std::min<std::size_t>(1, req.uri.size());
+        const char * const end = req.uri.data() + req.uri.size();
+        const char * commandEnd = std::find(position, end, '?');
+        const std::string command(position, commandEnd);
+        parsedRequest.plugin = NULL;
+        parsedRequest.tooManyLocations = false;
+        parsedRequest.routeParameters.Clear();
+        if(!plugins->pluginMap.Holds(command)) {
+            return;
+        }
+        parsedRequest.pluginIndex = plugins->pluginMap.Find(command);
+        parsedRequest.plugin = plugins->pluginVector[parsedRequest.pluginIndex];
+        const unsigned maxNumberOfLocations = parsedRequest.plugin->GetMaxNumberOfLocations();
+        RouteParameters & routeParameters = parsedRequest.routeParameters;
+        bool & tooManyLocations = parsedRequest.tooManyLocations;
+        std::string key, value;
+        for(position = std::min(commandEnd+1, end); position < end && !tooManyLocations; ++position) {
+            const char * itemEnd = std::find(position, end, '&');
+            const char * equalSign = std::find(position, itemEnd, '=');
+            if(equalSign == itemEnd) {
+                routeParameters.parameters.push_back(std::string(position, itemEnd));
+            } else if(KeyEquals(position, equalSign, "loc")) {
+                tooManyLocations = !AddLocation(equalSign+1, itemEnd, maxNumberOfLocations, routeParameters.viaPoints);
+            } else if(KeyEquals(position, equalSign, "src")) {
+                tooManyLocations = !AddLocation(equalSign+1, itemEnd, maxNumberOfLocations, routeParameters.sourcePoints);
+            } else if(KeyEquals(position, equalSign, "dst")) {
+                tooManyLocations = !AddLocation(equalSign+1, itemEnd, maxNumberOfLocations, routeParameters.targetPoints);
+            } else if(KeyEquals(position, equalSign, "hint")) {
+                routeParameters.hints.resize(routeParameters.viaPoints.size());
+                if(routeParameters.viaPoints.size())
+                    routeParameters.hints.back().assign(equalSign+1, itemEnd);
+            } else {
+                key.assign(position, equalSign);
+                std::transform(key.begin(), key.end(), key.begin(), (int(*)(int)) std::tolower);
+                value.assign(equalSign+1, itemEnd);
+                if("jsonp" != key)
+                    std::transform(value.begin(), value.end(), value.begin(), (int(*)(int)) std::tolower);
+                routeParameters.options.Set(key, value);
+            }
+            position = itemEnd;
+        }
+    }
 
-        INFO((Tm->tm_mday < 10 ? "0" : "" )  << Tm->tm_mday << "-" << (Tm->tm_mon+1 < 10 ? "0" : "" )  << (Tm->tm_mon+1) << "-" << 1900+Tm->tm_year << " " << (Tm->tm_hour < 10 ? "0" : "" ) << Tm->tm_hour << ":" << (Tm->tm_min < 10 ? "0" : "" ) << Tm->tm_min << ":" << (Tm->tm_sec < 10 ? "0" : "" ) << Tm->tm_sec << " " <<
-                req.endpoint.to_string() << " " << req.referrer << ( 0 == req.referrer.length() ? "- " :" ") << req.agent << ( 0 == req.agent.length() ? "- " :" ") << request );
-        std::size_t firstAmpPosition = request.find_first_of("?");
-        //DEBUG("[debug] looking for handler for command: " << command);
+    //the caller holds the plugins that parsed the request, they keep their data alive even if they are replaced meanwhile
+    void handle_request(const _StrParsedRequest & parsedRequest, const Request& req, Reply& rep){
+        LogRequest(req);
         try {
-            std::string command = request.substr(1,firstAmpPosition-1);
-            if(pluginMap.Holds(command)) {
-
-                RouteParameters routeParameters;
-                std::stringstream ss(( firstAmpPosition == std::string::npos ? "" : request.substr(firstAmpPosition+1) ));
-                std::string item;
-                while(std::getline(ss, item, '&')) {
-                    size_t found = item.find('=');
-                    if(found == std::string::npos) {
-                        routeParameters.parameters.push_back(item);
-                    } else {
-                        std::string p = item.substr(0, found);
-                        std::transform(p.begin(), p.end(), p.begin(), (int(*)(int)) std::tolower);
-                        std::string o = item.substr(found+1);
-                        if("jsonp" != p && "hint" != p)
-                            std::transform(o.begin(), o.end(), o.begin(), (int(*)(int)) std::tolower);
-                        if("loc" == p) {
-                            if(25 >= routeParameters.viaPoints.size()) {
-                                routeParameters.viaPoints.push_back(o);
-                            }
-                        } else if("hint" == p) {
-                            routeParameters.hints.resize(routeParameters.viaPoints.size());
-                            if(routeParameters.viaPoints.size())
-                                routeParameters.hints.back() = o;
-                        } else {
-                            routeParameters.options.Set(p, o);
-                        }
-                    }
-                }
-                //				std::cout << "[debug] found handler for '" << command << "' at version: " << pluginMap.Find(command)->GetVersionString() << std::endl;
-                //				std::cout << "[debug] remaining parameters: " << parameters.size() << std::endl;
-                rep.status = Reply::ok;
-                _pluginVector[pluginMap.Find(command)]->HandleRequest(routeParameters, rep );
-
-                //				std::cout << rep.content << std::endl;
-            } else {
+            if(NULL == parsedRequest.plugin || parsedRequest.tooManyLocations) {
                 rep = Reply::stockReply(Reply::badRequest);
+                return;
             }
+            rep.status = Reply::ok;
+            parsedRequest.plugin->HandleRequest(parsedRequest.routeParameters, rep );
             return;
         } catch(std::exception& e) {
             rep = Reply::stockReply(Reply::internalServerError);
@@ -108,17 +146,188 @@ public:
         }
     };
 
+    //only before the server runs, use ReplacePlugins() afterwards
     void RegisterPlugin(BasePlugin * plugin) {
         std::cout << "[handler] registering plugin " << plugin->GetDescriptor() << std::endl;
-        pluginMap.Add(plugin->GetDescriptor(), _pluginCount);
-        _pluginVector.push_back(plugin);
-        _pluginCount++;
+        _plugins[0]->pluginMap.Add(plugin->GetDescriptor(), _plugins[0]->pluginVector.size());
+        _plugins[0]->pluginVector.push_back(plugin);
+    }
+
+    //Only before the server runs. Each replica of the query data gets plugins of its own, a
+    //thread uses the ones of the replica that it was pinned to with PinThreadToNUMANode().
+    void SetNumberOfReplicas(const unsigned numberOfReplicas) {
+        _plugins.resize(numberOfReplicas);
+        for(unsigned i = 0; i < _plugins.size(); ++i) {
+            if(!_plugins[i])
+                _plugins[i].reset(new _PluginSet());
+        }
+    }
+
+    //Takes ownership of the plugins and shares the ownership of the data they work on, one entry per
+    //replica. All replicas are switched at once. Requests that are in flight finish with the old plugins,
+    //which are deleted together with their data afterwards.
+    void ReplacePlugins(const std::vector<std::vector<BasePlugin *> > & pluginVectors, const std::vector<boost::shared_ptr<void> > & data, const std::vector<unsigned> & dataChecksums) {
+        std::vector<boost::shared_ptr<_PluginSet> > replicas(pluginVectors.size());
+        for(unsigned replica = 0; replica < pluginVectors.size(); ++replica) {
+            const std::vector<BasePlugin *> & pluginVector = pluginVectors[replica];
+            replicas[replica].reset(new _PluginSet());
+            for(unsigned i = 0; i < pluginVector.size(); ++i) {
+                std::cout << "[handler] registering plugin " << pluginVector[i]->GetDescriptor() << std::endl;
+                replicas[replica]->pluginMap.Add(pluginVector[i]->GetDescriptor(), i);
+                replicas[replica]->pluginVector.push_back(pluginVector[i]);
+            }
+            replicas[replica]->data = data[replica];
+            replicas[replica]->dataChecksum = dataChecksums[replica];
+        }
+        boost::mutex::scoped_lock lock(_pluginsMutex);
+        _plugins.swap(replicas);
+    }
+
+    //caches final replies, i.e. after compression, up to the given number of bytes
+    void EnableResponseCache(const std::size_t budgetInBytes) {
+        delete _responseCache;
+        _responseCache = new ResponseCache(budgetInBytes);
+    }
+
+    //the plugins of the replica that the calling thread uses
+    PluginSetPointer GetPlugins() {
+        boost::mutex::scoped_lock lock(_pluginsMutex);
+        return _plugins[GetReplicaOfThread()%_plugins.size()];
+    }
+
+    //also builds the cache key of the request, which CacheReply() uses afterwards
+    bool FetchCachedReply(const PluginSetPointer & plugins, _StrParsedRequest & parsedRequest, const Request& req, const CompressionType compressionType, Reply& rep) {
+        if(NULL == _responseCache || NULL == parsedRequest.plugin || parsedRequest.tooManyLocations) {
+            return false;
+        }
+        BuildCacheKey(compressionType, plugins->dataChecksum, parsedRequest);
+        boost::shared_ptr<const Reply> cachedReply;
+        if(!_responseCache->Fetch(parsedRequest.cacheKey, cachedReply)) {
+            return false;
+        }
+        LogRequest(req);
+        rep = *cachedReply;
+        return true;
+    }
+
+    void CacheReply(const _StrParsedRequest & parsedRequest, const Reply& rep) {
+        if(NULL == _responseCache || NULL == parsedRequest.plugin || parsedRequest.tooManyLocations || Reply::ok != rep.status) {
+            return;
+        }
+        const std::string & key = parsedRequest.cacheKey;
+        std::size_t cost = key.size() + rep.content.size() + sizeof(Reply);
+        for(unsigned i = 0; i < rep.headers.size(); ++i) {
+            cost += rep.headers[i].name.size() + rep.headers[i].value.size() + sizeof(Header);
+        }
+        _responseCache->Insert(key, boost::shared_ptr<const Reply>(new Reply(rep)), cost);
+    }
+
+    void PrintResponseCacheStatistics() {
+        if(NULL == _responseCache) {
+            return;
+        }
+        INFO("response cache: " << _responseCache->GetNumberOfHits() << " hits, " << _responseCache->GetNumberOfMisses() << " misses, " << _responseCache->GetCost() << " bytes");
     }
 
 private:
-    HashTable<std::string, unsigned> pluginMap;
-    std::vector<BasePlugin *> _pluginVector;
-    unsigned _pluginCount;
+    //compares a key of the uri case insensitive with a lower case name
+    static bool KeyEquals(const char * begin, const char * end, const char * name) {
+        for(; begin != end; ++begin, ++name) {
+            if('\0' == *name || std::tolower(static_cast<unsigned char>(*begin)) != *name)
+                return false;
+        }
+        return '\0' == *name;
+    }
+
+    //false if the list already holds the number of locations that the plugin accepts, the request is then rejected
+    static bool AddLocation(const char * begin, const char * end, const unsigned maxNumberOfLocations, std::vector<_Coordinate> & locations) {
+        if(maxNumberOfLocations <= locations.size())
+            return false;
+        locations.push_back(_Coordinate());
+        parseCoordinate(begin, end, locations.back());
+        return true;
+    }
+
+    void LogRequest(const Request& req) const {
+        time_t ltime;
+        struct tm *Tm;
+
+        ltime=time(NULL);
+        Tm=localtime(&ltime);
+
+        INFO((Tm->tm_mday < 10 ? "0" : "" )  << Tm->tm_mday << "-" << (Tm->tm_mon+1 < 10 ? "0" : "" )  << (Tm->tm_mon+1) << "-" << 1900+Tm->tm_year << " " << (Tm->tm_hour < 10 ? "0" : "" ) << Tm->tm_hour << ":" << (Tm->tm_min < 10 ? "0" : "" ) << Tm->tm_min << ":" << (Tm->tm_sec < 10 ? "0" : "" ) << Tm->tm_sec << " " <<
+                req.endpoint.to_string() << " " << req.referrer << ( 0 == req.referrer.length() ? "- " :" ") << req.agent << ( 0 == req.agent.length() ? "- " :" ") << req.uri );
+    }
+
+    static bool CompareOptionsByName(const RouteParameters::OptionsIterator & a, const RouteParameters::OptionsIterator & b) {
+        return a->first < b->first;
+    }
+
+    static bool CompareParameters(const std::string * a, const std::string * b) {
+        return *a < *b;
+    }
+
+    template<typename T>
+    static void AppendBytes(const T & value, std::string & key) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    static void AppendLocations(const std::vector<_Coordinate> & locations, std::string & key) {
+        AppendBytes((unsigned) locations.size(), key);
+        for(unsigned i = 0; i < locations.size(); ++i) {
+            AppendBytes(locations[i], key);
+        }
+    }
+
+    //Built from the parsed request, so that requests that only differ in the order of their parameters, in the
+    //case of names and values or in the notation of coordinates share a key. Locations keep their order,
+    //each with its hint, the other parameters are sorted by name. The key also holds the compression and the
+    //data checksum. Locations and hints are stored with their lengths, so that their bytes cannot be mistaken
+    //for separators.
+    static void BuildCacheKey(const CompressionType compressionType, const unsigned dataChecksum, _StrParsedRequest & parsedRequest) {
+        const RouteParameters & routeParameters = parsedRequest.routeParameters;
+        std::string & key = parsedRequest.cacheKey;
+        key.clear();
+        AppendBytes(compressionType, key);
+        AppendBytes(dataChecksum, key);
+        AppendBytes(parsedRequest.pluginIndex, key);
+        AppendLocations(routeParameters.viaPoints, key);
+        for(unsigned i = 0; i < routeParameters.viaPoints.size(); ++i) {
+            const std::size_t lengthOfHint = (i < routeParameters.hints.size() ? routeParameters.hints[i].size() : 0);
+            AppendBytes((unsigned) lengthOfHint, key);
+            if(0 < lengthOfHint)
+                key += routeParameters.hints[i];
+        }
+        AppendLocations(routeParameters.sourcePoints, key);
+        AppendLocations(routeParameters.targetPoints, key);
+
+        parsedRequest.sortedOptions.clear();
+        for(RouteParameters::OptionsIterator option = routeParameters.options.begin(); option != routeParameters.options.end(); ++option) {
+            parsedRequest.sortedOptions.push_back(option);
+        }
+        std::sort(parsedRequest.sortedOptions.begin(), parsedRequest.sortedOptions.end(), CompareOptionsByName);
+        for(unsigned i = 0; i < parsedRequest.sortedOptions.size(); ++i) {
+            key += parsedRequest.sortedOptions[i]->first;
+            key += '=';
+            key += parsedRequest.sortedOptions[i]->second;
+            key += '&';
+        }
+
+        parsedRequest.sortedParameters.clear();
+        for(unsigned i = 0; i < routeParameters.parameters.size(); ++i) {
+            parsedRequest.sortedParameters.push_back(&routeParameters.parameters[i]);
+        }
+        std::sort(parsedRequest.sortedParameters.begin(), parsedRequest.sortedParameters.end(), CompareParameters);
+        for(unsigned i = 0; i < parsedRequest.sortedParameters.size(); ++i) {
+            key += *parsedRequest.sortedParameters[i];
+            key += '&';
+        }
+    }
+
+    //one set per replica of the query data
+    std::vector<boost::shared_ptr<_PluginSet> > _plugins;
+    boost::mutex _pluginsMutex;
+    ResponseCache * _responseCache;
 };
 } // namespace http
 
@@ -21,6 +21,11 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef REQUEST_PARSER_H
 #define REQUEST_PARSER_H
 
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/logic/tribool.hpp>
 #include <boost/tuple/tuple.hpp>
 #include "BasicDatastructures.h"
@@ -29,11 +34,27 @@ namespace http {
 
 class RequestParser {
 public:
-    RequestParser() : state_(method_start) { }
-    void Reset() { state_ = method_start; }
+    RequestParser() : state_(method_start), httpVersionMajor(0), httpVersionMinor(0), connectionClose(false), connectionKeepAlive(false) { }
+
+    //for the next request on the same connection
+    void Reset() {
+        state_ = method_start;
+        header.Clear();
+        httpVersionMajor = 0;
+        httpVersionMinor = 0;
+        connectionClose = false;
+        connectionKeepAlive = false;
+    }
 
+    //Parses until a request is complete or invalid, or the data ends. The returned pointer is the first
+    //character that was not consumed, i.e. the start of a pipelined request.
     boost::tuple<boost::tribool, char*> Parse(Request& req, char* begin, char* end, CompressionType * compressionType) {
         while (begin != end) {
+            //the characters of a uri or header are appended as one run instead of one by one
+            begin = AppendRun(req, begin, end);
+            if(begin == end) {
+                break;
+            }
             boost::tribool result = consume(req, *begin++, compressionType);
             if (result || !result){
                 return boost::make_tuple(result, begin);
@@ -44,6 +65,32 @@ public:
     }
 
 private:
+    //Appends the characters up to the first one that consume() has to look at, it would append them
+    //one by one otherwise.
+    char* AppendRun(Request& req, char* begin, char* end) {
+        char* position = begin;
+        switch (state_) {
+        case uri:
+            while(position != end && ' ' != *position && !isCTL(*position))
+                ++position;
+            req.uri.append(begin, position);
+            break;
+        case header_name:
+            while(position != end && ':' != *position && isChar(*position) && !isCTL(*position) && !isTSpecial(*position))
+                ++position;
+            header.name.append(begin, position);
+            break;
+        case header_value:
+            while(position != end && '\r' != *position && !isCTL(*position))
+                ++position;
+            header.value.append(begin, position);
+            break;
+        default:
+            break;
+        }
+        return position;
+    }
+
     boost::tribool consume(Request& req, char input, CompressionType * compressionType) {
         switch (state_) {
         case method_start:
@@ -117,6 +164,7 @@ private:
             }
         case http_version_major_start:
             if (isDigit(input)) {
+                httpVersionMajor = input - '0';
                 state_ = http_version_major;
                 return boost::indeterminate;
             } else {
@@ -127,12 +175,14 @@ private:
                 state_ = http_version_minor_start;
                 return boost::indeterminate;
             } else if (isDigit(input)) {
+                httpVersionMajor = 10*httpVersionMajor + input - '0';
                 return boost::indeterminate;
             } else {
                 return false;
             }
         case http_version_minor_start:
             if (isDigit(input)) {
+                httpVersionMinor = input - '0';
                 state_ = http_version_minor;
                 return boost::indeterminate;
             } else {
@@ -143,6 +193,7 @@ private:
                 state_ = expecting_newline_1;
                 return boost::indeterminate;
             } else if (isDigit(input)) {
+                httpVersionMinor = 10*httpVersionMinor + input - '0';
                 return boost::indeterminate;
             }
             else {
@@ -156,7 +207,8 @@ private:
                 return false;
             }
         case header_line_start:
-            if(header.name == "Accept-Encoding") {
+            //names of headers are case insensitive
+            if(boost::iequals(header.name, "Accept-Encoding")) {
                 /* giving gzip precedence over deflate */
                 if(header.value.find("deflate") != std::string::npos)
                     *compressionType = deflateRFC1951;
@@ -164,12 +216,19 @@ private:
                     *compressionType = gzipRFC1952;
             }
 
-            if("Referer" == header.name)
+            if(boost::iequals(header.name, "Referer"))
                 req.referrer = header.value;
 
-            if("User-Agent" == header.name)
+            if(boost::iequals(header.name, "User-Agent"))
                 req.agent = header.value;
 
+            if(boost::iequals(header.name, "Connection")) {
+                //so are the tokens, the value is not needed anymore and is lower cased in place
+                std::transform(header.value.begin(), header.value.end(), header.value.begin(), (int(*)(int)) std::tolower);
+                connectionClose = (header.value.find("close") != std::string::npos);
+                connectionKeepAlive = (header.value.find("keep-alive") != std::string::npos);
+            }
+
             if (input == '\r') {
                 state_ = expecting_newline_3;
                 return boost::indeterminate;
@@ -229,7 +288,15 @@ private:
                 return false;
             }
         case expecting_newline_3:
-            return (input == '\n');
+            if (input == '\n') {
+                if(1 < httpVersionMajor || (1 == httpVersionMajor && 1 <= httpVersionMinor))
+                    req.keepAlive = !connectionClose;
+                else
+                    req.keepAlive = connectionKeepAlive;
+                return true;
+            } else {
+                return false;
+            }
         default:
             return false;
         }
@@ -284,6 +351,10 @@ private:
     } state_;
 
     Header header;
+    unsigned httpVersionMajor;
+    unsigned httpVersionMinor;
+    bool connectionClose;
+    bool connectionKeepAlive;
 };
 
 } // namespace http
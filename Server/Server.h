@@ -21,6 +21,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <algorithm>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
@@ -30,12 +31,14 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "Connection.h"
 #include "RequestHandler.h"
+#include "../Util/NUMAUtil.h"
 
 namespace http {
 
 class Server: private boost::noncopyable {
 public:
-	explicit Server(const std::string& address, const std::string& port, unsigned thread_pool_size) : threadPoolSize(thread_pool_size), acceptor(ioService), newConnection(new Connection(ioService, requestHandler)), requestHandler(){
+	explicit Server(const std::string& address, const std::string& port, unsigned thread_pool_size, const unsigned keep_alive_timeout = Connection::DEFAULT_KEEP_ALIVE_TIMEOUT, const unsigned max_requests_per_connection = Connection::DEFAULT_MAX_NUMBER_OF_REQUESTS) :
+	        threadPoolSize(thread_pool_size), keepAliveTimeout(keep_alive_timeout), maxRequestsPerConnection(max_requests_per_connection), acceptor(ioService), newConnection(new Connection(ioService, requestHandler, keep_alive_timeout, max_requests_per_connection)), requestHandler(){
 		boost::asio::ip::tcp::resolver resolver(ioService);
 		boost::asio::ip::tcp::resolver::query query(address, port);
 		boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
@@ -50,7 +53,11 @@ public:
 	void Run() {
 		std::vector<boost::shared_ptr<boost::thread> > threads;
 		for (unsigned i = 0; i < threadPoolSize; ++i) {
-			boost::shared_ptr<boost::thread> thread(new boost::thread(boost::bind(&boost::asio::io_service::run, &ioService)));
+			boost::shared_ptr<boost::thread> thread;
+			if(numaNodes.empty())
+				thread.reset(new boost::thread(boost::bind(&boost::asio::io_service::run, &ioService)));
+			else
+				thread.reset(new boost::thread(boost::bind(&Server::RunOnNUMANode, this, numaNodes[i%numaNodes.size()], i%numaNodes.size())));
 			threads.push_back(thread);
 		}
 		for (unsigned i = 0; i < threads.size(); ++i)
@@ -65,22 +72,43 @@ public:
 		return requestHandler;
 	}
 
+	//Only before the server runs. Thread i runs on node i modulo the number of nodes and uses
+	//the replica of the query data with that index, see RequestHandler::ReplacePlugins().
+	void PinThreadsToNUMANodes(const std::vector<unsigned> & nodes) {
+		numaNodes = nodes;
+		requestHandler.SetNumberOfReplicas(std::max<std::size_t>(1, nodes.size()));
+	}
+
+	//empty if the threads are not pinned
+	const std::vector<unsigned> & GetNUMANodesOfThreads() const {
+		return numaNodes;
+	}
+
 private:
 	typedef boost::shared_ptr<Connection > ConnectionPtr;
 
+	void RunOnNUMANode(const unsigned node, const unsigned replica) {
+		if(!PinThreadToNUMANode(node, replica))
+			WARN("could not pin server thread to NUMA node " << node);
+		ioService.run();
+	}
+
 	void handleAccept(const boost::system::error_code& e) {
 		if (!e) {
 			newConnection->start();
-			newConnection.reset(new Connection(ioService, requestHandler));
+			newConnection.reset(new Connection(ioService, requestHandler, keepAliveTimeout, maxRequestsPerConnection));
 			acceptor.async_accept(newConnection->socket(), boost::bind(&Server::handleAccept, this, boost::asio::placeholders::error));
 		}
 	}
 
 	unsigned threadPoolSize;
+	unsigned keepAliveTimeout;
+	unsigned maxRequestsPerConnection;
 	boost::asio::io_service ioService;
 	boost::asio::ip::tcp::acceptor acceptor;
 	ConnectionPtr newConnection;
 	RequestHandler requestHandler;
+	std::vector<unsigned> numaNodes;
 };
 
 }   // namespace http
@@ -25,12 +25,17 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef SERVERFACTORY_H_
 #define SERVERFACTORY_H_
 
+#include <algorithm>
 #include <cstdlib>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
 
 #include "Server.h"
 #include "ServerConfiguration.h"
 
 #include "../Util/InputFileUtil.h"
+#include "../Util/NUMAUtil.h"
 #include "../Util/OpenMPWrapper.h"
 
 typedef http::Server Server;
@@ -53,14 +58,22 @@ struct ServerFactory {
 			exit(-1);
 		}
 
-		if(!testDataFile(serverConfig.GetParameter("ramIndex").c_str())) {
-			std::cerr << "[error] ram index file not found" << std::endl;
-			exit(-1);
-		}
-
-		if(!testDataFile(serverConfig.GetParameter("fileIndex").c_str())) {
-			std::cerr << "[error] file index file not found" << std::endl;
-			exit(-1);
+		//the r-tree replaces the grid, data of earlier versions has only the grid
+		if(serverConfig.GetParameter("rtreeData").length()) {
+			if(!testDataFile(serverConfig.GetParameter("rtreeData").c_str())) {
+				std::cerr << "[error] r-tree file not found" << std::endl;
+				exit(-1);
+			}
+		} else {
+			if(!testDataFile(serverConfig.GetParameter("ramIndex").c_str())) {
+				std::cerr << "[error] ram index file not found" << std::endl;
+				exit(-1);
+			}
+
+			if(!testDataFile(serverConfig.GetParameter("fileIndex").c_str())) {
+				std::cerr << "[error] file index file not found" << std::endl;
+				exit(-1);
+			}
 		}
 
 		unsigned threads = omp_get_num_procs();
@@ -71,9 +84,37 @@ struct ServerFactory {
 
 		if(atoi(serverConfig.GetParameter("Threads").c_str()) != 0 && (unsigned)atoi(serverConfig.GetParameter("Threads").c_str()) <= threads)
 			threads = atoi( serverConfig.GetParameter("Threads").c_str() );
+		//each server thread may search the legs of a route with more threads, by default only with the cores that no server thread uses.
+		//Every one of these threads allocates query heaps for the whole graph.
+		if(serverConfig.GetParameter("ThreadsPerRoute") == "")
+			serverConfig.SetParameter("ThreadsPerRoute", boost::lexical_cast<std::string>(std::max(1, omp_get_num_procs()/(int)threads)));
+		if(1 < atoi(serverConfig.GetParameter("ThreadsPerRoute").c_str()))
+			std::cout << "[server] legs of a route are searched by up to " << serverConfig.GetParameter("ThreadsPerRoute") << " threads, each with query heaps of its own" << std::endl;
+
+		//an empty parameter keeps the default, 0 closes connections after each reply
+		unsigned keepAliveTimeout = http::Connection::DEFAULT_KEEP_ALIVE_TIMEOUT;
+		if(serverConfig.GetParameter("KeepAliveTimeout") != "")
+			keepAliveTimeout = atoi(serverConfig.GetParameter("KeepAliveTimeout").c_str());
+		unsigned maxRequestsPerConnection = http::Connection::DEFAULT_MAX_NUMBER_OF_REQUESTS;
+		if(serverConfig.GetParameter("MaxRequestsPerConnection") != "")
+			maxRequestsPerConnection = atoi(serverConfig.GetParameter("MaxRequestsPerConnection").c_str());
 
 		std::cout << "[server] http 1.1 compression handled by zlib version " << zlibVersion() << std::endl;
-		Server * server = new Server(serverConfig.GetParameter("IP"), serverConfig.GetParameter("Port"), threads);
+		if(0 < keepAliveTimeout)
+			std::cout << "[server] persistent connections idle for at most " << keepAliveTimeout << "s" << std::endl;
+		Server * server = new Server(serverConfig.GetParameter("IP"), serverConfig.GetParameter("Port"), threads, keepAliveTimeout, maxRequestsPerConnection);
+		if(atoi(serverConfig.GetParameter("NUMAReplication").c_str()) != 0) {
+			//nodes without a server thread would only hold an unused replica
+			std::vector<unsigned> nodes;
+			GetNUMANodes(nodes);
+			nodes.resize(std::min<std::size_t>(nodes.size(), threads));
+			if(nodes.size() > 1) {
+				std::cout << "[server] replicating query data on " << nodes.size() << " NUMA nodes" << std::endl;
+				server->PinThreadsToNUMANodes(nodes);
+			} else {
+				std::cout << "[server] only one NUMA node in use, query data is not replicated" << std::endl;
+			}
+		}
 		return server;
 	}
 
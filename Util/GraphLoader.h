@@ -32,6 +32,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include <boost/unordered_map.hpp>
 
+#include "../DataStructures/Coordinate.h"
 #include "../DataStructures/ImportNode.h"
 #include "../DataStructures/ImportEdge.h"
 #include "../DataStructures/NodeCoords.h"
@@ -370,4 +371,58 @@ unsigned readHSGRFromStream(std::istream &in, std::vector<NodeT>& nodeList, std:
     return numberOfNodes;
 }
 
+template<typename NodeT, typename EdgeT>
+unsigned readLevelsFromStream(std::istream &in, std::vector<NodeID> & originalNodeIDs, std::vector<_Coordinate> & coordinates, std::vector<NodeT>& nodeList, std::vector<EdgeT> & edgeList, unsigned * checkSum) {
+    unsigned numberOfNodes = 0;
+    in.read((char*) checkSum, sizeof(unsigned));
+    in.read((char*) & numberOfNodes, sizeof(unsigned));
+    if(!in.good() || 0 == numberOfNodes)
+        return 0;
+    originalNodeIDs.resize(numberOfNodes);
+    in.read((char*) &(originalNodeIDs[0]), numberOfNodes*sizeof(NodeID));
+    coordinates.resize(numberOfNodes);
+    in.read((char*) &(coordinates[0]), numberOfNodes*sizeof(_Coordinate));
+    nodeList.resize(numberOfNodes + 1);
+    in.read((char*) &(nodeList[0]), (numberOfNodes + 1)*sizeof(NodeT));
+
+    unsigned numberOfEdges = 0;
+    in.read((char*) &numberOfEdges, sizeof(unsigned));
+    edgeList.resize(numberOfEdges);
+    if(numberOfEdges)
+        in.read((char*) &(edgeList[0]), numberOfEdges*sizeof(EdgeT));
+
+    return numberOfNodes;
+}
+
+template<typename EdgeHalvesT>
+unsigned readShortcutsFromStream(std::istream &in, std::vector<EdgeHalvesT> & halvesList, unsigned * checkSum) {
+    unsigned numberOfEntries = 0;
+    in.read((char*) checkSum, sizeof(unsigned));
+    in.read((char*) &numberOfEntries, sizeof(unsigned));
+    if(!in.good() || 0 == numberOfEntries)
+        return 0;
+    halvesList.resize(numberOfEntries);
+    in.read((char*) &(halvesList[0]), numberOfEntries*sizeof(EdgeHalvesT));
+    return numberOfEntries;
+}
+
+template<typename LengthT>
+unsigned readLengthsFromStream(std::istream &in, std::vector<LengthT> & nodeLengths, std::vector<LengthT> & edgeLengths, unsigned * checkSum) {
+    unsigned numberOfNodes = 0;
+    in.read((char*) checkSum, sizeof(unsigned));
+    in.read((char*) &numberOfNodes, sizeof(unsigned));
+    if(!in.good() || 0 == numberOfNodes)
+        return 0;
+    nodeLengths.resize(numberOfNodes);
+    in.read((char*) &(nodeLengths[0]), numberOfNodes*sizeof(LengthT));
+
+    unsigned numberOfEntries = 0;
+    in.read((char*) &numberOfEntries, sizeof(unsigned));
+    if(!in.good() || 0 == numberOfEntries)
+        return 0;
+    edgeLengths.resize(numberOfEntries);
+    in.read((char*) &(edgeLengths[0]), numberOfEntries*sizeof(LengthT));
+    return numberOfEntries;
+}
+
 #endif // GRAPHLOADER_H
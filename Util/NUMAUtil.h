@@ -0,0 +1,110 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef NUMAUTIL_H_
+#define NUMAUTIL_H_
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
+
+/*
+ * NUMA topology as the Linux kernel describes it in sysfs, no libnuma is
+ * needed. Under the default memory policy a page is allocated on the node of
+ * the thread that touches it first, so data that a thread pinned to a node
+ * copies is local to that node. Each pinned thread also remembers which
+ * replica of the query data it uses.
+ */
+
+//parses lists like "0-3,8-11" as used by sysfs
+inline void ParseNUMAList(const std::string & list, std::vector<unsigned> & result) {
+    result.clear();
+    std::stringstream ss(list);
+    std::string range;
+    while(std::getline(ss, range, ',')) {
+        const std::size_t dash = range.find('-');
+        try {
+            const unsigned first = boost::lexical_cast<unsigned>(range.substr(0, dash));
+            const unsigned last = (std::string::npos == dash ? first : boost::lexical_cast<unsigned>(range.substr(dash+1)));
+            for(unsigned i = first; i <= last; ++i) {
+                result.push_back(i);
+            }
+        } catch(boost::bad_lexical_cast &) {
+            result.clear();
+            return;
+        }
+    }
+}
+
+//NUMA nodes that have CPUs, node 0 alone if the system does not tell
+inline void GetNUMANodes(std::vector<unsigned> & nodes) {
+    std::string list;
+    std::ifstream in("/sys/devices/system/node/has_cpu");
+    in >> list;
+    ParseNUMAList(list, nodes);
+    if(nodes.empty()) {
+        nodes.push_back(0);
+    }
+}
+
+inline boost::thread_specific_ptr<unsigned> & GetReplicaSlotOfThread() {
+    static boost::thread_specific_ptr<unsigned> replica;
+    return replica;
+}
+
+//replica of the query data that the calling thread uses, 0 for threads that were not pinned
+inline unsigned GetReplicaOfThread() {
+    const unsigned * replica = GetReplicaSlotOfThread().get();
+    return (NULL == replica ? 0 : *replica);
+}
+
+//Restricts the calling thread and the threads it starts to the CPUs of a node. The replica is
+//remembered even if pinning fails, the thread then merely uses memory that may be remote.
+inline bool PinThreadToNUMANode(const unsigned node, const unsigned replica) {
+    GetReplicaSlotOfThread().reset(new unsigned(replica));
+#ifdef __linux__
+    std::string list;
+    std::ifstream in(("/sys/devices/system/node/node" + boost::lexical_cast<std::string>(node) + "/cpulist").c_str());
+    in >> list;
+    std::vector<unsigned> cpus;
+    ParseNUMAList(list, cpus);
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for(unsigned i = 0; i < cpus.size(); ++i) {
+        if(CPU_SETSIZE > cpus[i]) {
+            CPU_SET(cpus[i], &cpuSet);
+        }
+    }
+    return !cpus.empty() && 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#else
+    return false;
+#endif
+}
+
+#endif /* NUMAUTIL_H_ */
@@ -28,6 +28,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 inline const int omp_get_num_procs() { return 1; }
 inline const int omp_get_max_threads() { return 1; }
 inline const int omp_get_thread_num() { return 0; }
+inline const int omp_get_num_threads() { return 1; }
 inline const void omp_set_num_threads(int i) {}
 #endif
 
@@ -0,0 +1,134 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef RESIDENCYPOLICY_H_
+#define RESIDENCYPOLICY_H_
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "../typedefs.h"
+
+/*
+ * How the pages of a data section are kept in memory, given in server.ini as
+ * a comma separated list, e.g. "hugepages,prefault,lock":
+ *  hugepages  backs the section with transparent huge pages, which saves TLB
+ *             misses on large arrays that queries access at random. Sections
+ *             that are mapped from a data file only get them from kernels
+ *             with CONFIG_READ_ONLY_THP_FOR_FS, a warning says so.
+ *  willneed   starts reading the section ahead in the background
+ *  prefault   touches every page while loading, so that queries do not fault
+ *  lock       keeps the pages in RAM, they are never swapped out
+ * Each step is a hint, data whose policy cannot be applied works as before.
+ */
+struct ResidencyPolicy {
+    ResidencyPolicy() : hugePages(false), willNeed(false), prefault(false), lock(false) { }
+
+    explicit ResidencyPolicy(const std::string & description) : hugePages(false), willNeed(false), prefault(false), lock(false) {
+        std::stringstream ss(description);
+        std::string item;
+        while(std::getline(ss, item, ',')) {
+            item.erase(0, item.find_first_not_of(" \t"));
+            item.erase(item.find_last_not_of(" \t") + 1);
+            if("hugepages" == item) {
+                hugePages = true;
+            } else if("willneed" == item) {
+                willNeed = true;
+            } else if("prefault" == item) {
+                prefault = true;
+            } else if("lock" == item) {
+                lock = true;
+            } else if(!item.empty()) {
+                WARN("unknown residency policy '" << item << "' is ignored");
+            }
+        }
+    }
+
+    //applies the policy to the pages that hold [data, data+size)
+    void Apply(const void * data, const std::size_t size, const char * name) const {
+        if(NULL == data || 0 == size) {
+            return;
+        }
+#ifndef _WIN32
+        const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+        char * begin = reinterpret_cast<char *>((std::size_t) data/pageSize*pageSize);
+        const std::size_t length = (const char *) data + size - begin;
+#ifdef MADV_HUGEPAGE
+        if(hugePages && 0 != madvise(begin, length, MADV_HUGEPAGE)) {
+            WARN("no huge pages for " << name << ": " << strerror(errno));
+        } else if(hugePages && IsMappedFromFile(begin)) {
+            //madvise() succeeds, but does nothing on most kernels
+            WARN("huge pages for " << name << " need a kernel with CONFIG_READ_ONLY_THP_FOR_FS, it is mapped from a file");
+        }
+#endif
+        if(willNeed && 0 != madvise(begin, length, MADV_WILLNEED)) {
+            WARN("no read-ahead for " << name << ": " << strerror(errno));
+        }
+        if(prefault) {
+            volatile char sink = 0;
+            for(std::size_t offset = 0; offset < length; offset += pageSize) {
+                sink ^= begin[offset];
+            }
+        }
+        if(lock && 0 != mlock(begin, length)) {
+            WARN("could not lock " << name << " into RAM: " << strerror(errno));
+        }
+#endif
+    }
+
+private:
+#ifndef _WIN32
+    //true if the page at the address belongs to a mapping of a file on disk, i.e. not of anonymous or shared memory
+    static bool IsMappedFromFile(const void * address) {
+        std::ifstream maps("/proc/self/maps");
+        std::string line;
+        while(std::getline(maps, line)) {
+            unsigned long start = 0, end = 0, inode = 0;
+            int pathOffset = 0;
+            if(3 != sscanf(line.c_str(), "%lx-%lx %*s %*s %*s %lu %n", &start, &end, &inode, &pathOffset)) {
+                continue;
+            }
+            if((unsigned long) address < start || end <= (unsigned long) address) {
+                continue;
+            }
+            const std::string path = line.substr(pathOffset);
+            return 0 != inode && 0 != path.compare(0, 9, "/dev/shm/") && 0 != path.compare(0, 5, "/SYSV");
+        }
+        return false;
+    }
+#endif
+
+public:
+    bool hugePages;
+    bool willNeed;
+    bool prefault;
+    bool lock;
+};
+
+#endif /* RESIDENCYPOLICY_H_ */
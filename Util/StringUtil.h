@@ -21,8 +21,11 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef STRINGUTIL_H_
 #define STRINGUTIL_H_
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <sstream>
 
@@ -120,6 +123,69 @@ inline std::string & replaceAll(std::string &s, const std::string &sub, const st
     return s;
 }
 
+//Parses [+-]digits[.digits] from a range without copying it. Up to 15 digits are exact as an integer and
+//a power of ten, whose quotient is the same correctly rounded double that atof() gives. Longer numbers and
+//all other forms that atof() reads, e.g. with an exponent or trailing characters, go through strtod().
+//Only ranges that do not start with a number are rejected.
+inline bool parseDecimal(const char * begin, const char * end, double & result) {
+    static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+    const char * position = begin;
+    bool negative = false;
+    if(position != end && ('-' == *position || '+' == *position)) {
+        negative = ('-' == *position);
+        ++position;
+    }
+    unsigned long long mantissa = 0;
+    unsigned numberOfDigits = 0;
+    unsigned numberOfDecimals = 0;
+    bool hasPoint = false;
+    for(; position != end && numberOfDigits <= 15; ++position) {
+        if('.' == *position && !hasPoint) {
+            hasPoint = true;
+            continue;
+        }
+        if(*position < '0' || *position > '9') {
+            break;
+        }
+        mantissa = 10*mantissa + (*position - '0');
+        ++numberOfDigits;
+        if(hasPoint) {
+            ++numberOfDecimals;
+        }
+    }
+    if(position != end || 15 < numberOfDigits) {
+        const std::string number(begin, end);
+        char * numberEnd = NULL;
+        result = strtod(number.c_str(), &numberEnd);
+        return numberEnd != number.c_str();
+    }
+    if(0 == numberOfDigits) {
+        return false;
+    }
+    result = mantissa/powersOfTen[numberOfDecimals];
+    if(negative) {
+        result = -result;
+    }
+    return true;
+}
+
+//"lat,lon" in degrees to the fixed point values that 100000.*atof() gives for each part
+inline bool parseCoordinate(const char * begin, const char * end, _Coordinate & coordinate) {
+    const char * comma = std::find(begin, end, ',');
+    double lat = 0.;
+    double lon = 0.;
+    if(comma == end || !parseDecimal(begin, comma, lat) || !parseDecimal(comma+1, end, lon)) {
+        return false;
+    }
+    //beyond the range of int
+    if(21474. < std::fabs(lat) || 21474. < std::fabs(lon)) {
+        return false;
+    }
+    coordinate.lat = static_cast<int>(100000.*lat);
+    coordinate.lon = static_cast<int>(100000.*lon);
+    return true;
+}
+
 inline void stringSplit(const std::string &s, const char delim, std::vector<std::string>& result) {
     std::stringstream ss(s);
     std::string item;
@@ -140,6 +206,22 @@ inline std::string HTMLEntitize( std::string result) {
     return result;
 }
 
+//appends the characters in [begin, end) to output and escapes them on the way, all originals are single characters
+inline void HTMLEntitize( const char * begin, const char * end, std::string & output) {
+    const unsigned numberOfOriginals = sizeof(originals)/sizeof(std::string);
+    for(; begin != end; ++begin) {
+        unsigned i = 0;
+        while(i < numberOfOriginals && originals[i][0] != *begin) {
+            ++i;
+        }
+        if(i < numberOfOriginals) {
+            output += entities[i];
+        } else {
+            output += *begin;
+        }
+    }
+}
+
 inline std::string HTMLDeEntitize( std::string result) {
     for(unsigned i = 0; i < sizeof(originals)/sizeof(std::string); i++) {
         result = replaceAll(result, entities[i], originals[i]);
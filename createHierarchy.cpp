@@ -48,9 +48,16 @@ extern "C" {
 #include "Contractor/Contractor.h"
 #include "Contractor/EdgeBasedGraphFactory.h"
 #include "DataStructures/BinaryHeap.h"
+#include "DataStructures/ContainerFile.h"
 #include "DataStructures/DeallocatingVector.h"
+#include "DataStructures/EdgeLengthTable.h"
+#include "DataStructures/LevelOrderedGraph.h"
 #include "DataStructures/NNGrid.h"
 #include "DataStructures/QueryEdge.h"
+#include "DataStructures/ShortcutUnpackingIndex.h"
+#include "DataStructures/SplitStaticGraph.h"
+#include "DataStructures/StaticGraph.h"
+#include "DataStructures/StaticRTree.h"
 #include "Util/BaseConfiguration.h"
 #include "Util/InputFileUtil.h"
 #include "Util/GraphLoader.h"
@@ -67,6 +74,15 @@ std::vector<_Restriction> inputRestrictions;
 std::vector<NodeID> bollardNodes;
 std::vector<NodeID> trafficLightNodes;
 
+//orders node ids by descending contraction level
+struct LevelComparator {
+    LevelComparator(const std::vector<unsigned> & l) : levels(l) {}
+    bool operator()(const NodeID a, const NodeID b) const {
+        return levels[a] > levels[b];
+    }
+    const std::vector<unsigned> & levels;
+};
+
 int main (int argc, char *argv[]) {
     if(argc < 3) {
         ERR("usage: " << std::endl << argv[0] << " <osrm-data> <osrm-restrictions>");
@@ -75,12 +91,18 @@ int main (int argc, char *argv[]) {
     double startupTime = get_timestamp();
     unsigned numberOfThreads = omp_get_num_procs();
     std::string SRTM_ROOT;
+    unsigned rtreeLeafSize = StaticRTree::DEFAULT_LEAF_SIZE;
+    std::size_t gridMemory = WritableGrid::DEFAULT_MEMORY_FOR_SORTING;
     if(testDataFile("contractor.ini")) {
         ContractorConfiguration contractorConfig("contractor.ini");
         if(atoi(contractorConfig.GetParameter("Threads").c_str()) != 0 && (unsigned)atoi(contractorConfig.GetParameter("Threads").c_str()) <= numberOfThreads)
             numberOfThreads = (unsigned)atoi( contractorConfig.GetParameter("Threads").c_str() );
         if(0 < contractorConfig.GetParameter("SRTM").size() )
             SRTM_ROOT = contractorConfig.GetParameter("SRTM");
+        if(0 != atoi(contractorConfig.GetParameter("RTreeLeafSize").c_str()))
+            rtreeLeafSize = (unsigned)atoi( contractorConfig.GetParameter("RTreeLeafSize").c_str() );
+        if(0 != atoi(contractorConfig.GetParameter("GridMemory").c_str()))
+            gridMemory = (std::size_t)atoi( contractorConfig.GetParameter("GridMemory").c_str() )*1024*1024;
     }
     if(0 != SRTM_ROOT.size())
         INFO("Loading SRTM from/to " << SRTM_ROOT);
@@ -109,7 +131,10 @@ int main (int argc, char *argv[]) {
     char graphOut[1024];    	strcpy(graphOut, argv[1]);      	strcat(graphOut, ".hsgr");
     char ramIndexOut[1024];    	strcpy(ramIndexOut, argv[1]);    	strcat(ramIndexOut, ".ramIndex");
     char fileIndexOut[1024];    strcpy(fileIndexOut, argv[1]);    	strcat(fileIndexOut, ".fileIndex");
+    char rtreeOut[1024];        strcpy(rtreeOut, argv[1]);          strcat(rtreeOut, ".rtree");
     char levelInfoOut[1024];    strcpy(levelInfoOut, argv[1]);    	strcat(levelInfoOut, ".levels");
+    char shortcutsOut[1024];    strcpy(shortcutsOut, argv[1]);    	strcat(shortcutsOut, ".shortcuts");
+    char lengthsOut[1024];      strcpy(lengthsOut, argv[1]);      	strcat(lengthsOut, ".lengths");
 
     std::vector<ImportEdge> edgeList;
     NodeID nodeBasedNodeNumber = readBinaryOSRMGraphFromStream(in, edgeList, bollardNodes, trafficLightNodes, &internalToExternalNodeMapping, inputRestrictions);
@@ -169,24 +194,19 @@ int main (int argc, char *argv[]) {
      */
 
     INFO("writing node map ...");
-    std::ofstream mapOutFile(nodeOut, std::ios::binary);
-    mapOutFile.write((char *)&(internalToExternalNodeMapping[0]), internalToExternalNodeMapping.size()*sizeof(NodeInfo));
-    mapOutFile.close();
-    std::vector<NodeInfo>().swap(internalToExternalNodeMapping);
-
-    /***
-     * Writing info on original (node-based) edges
-     */
-    INFO("writing info on original edges");
-    std::vector<OriginalEdgeData> originalEdgeData;
-    edgeBasedGraphFactory->GetOriginalEdgeData(originalEdgeData);
-
-//    std::ofstream oedOutFile(edgeOut, std::ios::binary);
-//    unsigned numberOfOrigEdges = originalEdgeData.size();
-//    oedOutFile.write((char*)&numberOfOrigEdges, sizeof(unsigned));
-//    oedOutFile.write((char*)&(originalEdgeData[0]), originalEdgeData.size()*sizeof(OriginalEdgeData));
-//    oedOutFile.close();
-//    std::vector<OriginalEdgeData>().swap(originalEdgeData);
+    {
+        std::vector<_Coordinate> nodeCoordinates(internalToExternalNodeMapping.size());
+        std::vector<NodeID> nodeIDs(internalToExternalNodeMapping.size());
+        for(unsigned i = 0; i < internalToExternalNodeMapping.size(); ++i) {
+            nodeCoordinates[i] = _Coordinate(internalToExternalNodeMapping[i].lat, internalToExternalNodeMapping[i].lon);
+            nodeIDs[i] = internalToExternalNodeMapping[i].id;
+        }
+        std::vector<NodeInfo>().swap(internalToExternalNodeMapping);
+        ContainerFileWriter mapWriter(nodeOut, ContainerFormat::NODES_FILE, 2);
+        mapWriter.WriteSection(ContainerFormat::COORDINATES_SECTION, (char *)&(nodeCoordinates[0]), nodeCoordinates.size()*sizeof(_Coordinate));
+        mapWriter.WriteSection(ContainerFormat::NODE_IDS_SECTION, (char *)&(nodeIDs[0]), nodeIDs.size()*sizeof(NodeID));
+        mapWriter.Close();
+    }
 
     DeallocatingVector<EdgeBasedGraphFactory::EdgeBasedNode> nodeBasedEdgeList;
     edgeBasedGraphFactory->GetEdgeBasedNodes(nodeBasedEdgeList);
@@ -199,10 +219,22 @@ int main (int argc, char *argv[]) {
 
     INFO("building grid ...");
     WritableGrid * writeableGrid = new WritableGrid();
-    writeableGrid->ConstructGrid(nodeBasedEdgeList, ramIndexOut, fileIndexOut);
+    writeableGrid->ConstructGrid(nodeBasedEdgeList, ramIndexOut, fileIndexOut, gridMemory);
     delete writeableGrid;
+    INFO("building r-tree with " << rtreeLeafSize << " edges per leaf ...");
+    StaticRTree::Build(nodeBasedEdgeList, rtreeOut, rtreeLeafSize);
     IteratorbasedCRC32<DeallocatingVector<EdgeBasedGraphFactory::EdgeBasedNode> > crc32;
     unsigned crc32OfNodeBasedEdgeList = crc32(nodeBasedEdgeList.begin(), nodeBasedEdgeList.end() );
+    //remember the midpoint of each edge-based node for the level ordered graph and its length for the edge length table
+    std::vector<_Coordinate> edgeBasedNodeCoordinates(edgeBasedNodeNumber);
+    std::vector<unsigned> edgeBasedNodeLengths(edgeBasedNodeNumber, 0);
+    BOOST_FOREACH(const EdgeBasedGraphFactory::EdgeBasedNode & edgeBasedNode, nodeBasedEdgeList) {
+        if(edgeBasedNode.id < edgeBasedNodeNumber) {
+            edgeBasedNodeCoordinates[edgeBasedNode.id].lat = (edgeBasedNode.lat1 + edgeBasedNode.lat2)/2;
+            edgeBasedNodeCoordinates[edgeBasedNode.id].lon = (edgeBasedNode.lon1 + edgeBasedNode.lon2)/2;
+            edgeBasedNodeLengths[edgeBasedNode.id] = ApproximateDistance(edgeBasedNode.lat1, edgeBasedNode.lon1, edgeBasedNode.lat2, edgeBasedNode.lon2);
+        }
+    }
     nodeBasedEdgeList.clear();
     INFO("CRC32 based checksum is " << crc32OfNodeBasedEdgeList);
 
@@ -216,6 +248,8 @@ int main (int argc, char *argv[]) {
     contractor->Run();
     INFO("Contraction took " << get_timestamp() - contractionStartedTimestamp << " sec");
 
+    std::vector<unsigned> nodeLevels;
+    contractor->GetNodeLevels( nodeLevels );
     DeallocatingVector< QueryEdge > contractedEdgeList;
     contractor->GetEdges( contractedEdgeList );
     delete contractor;
@@ -225,11 +259,10 @@ int main (int argc, char *argv[]) {
      */
 
     INFO("Building Node Array");
-    sort(contractedEdgeList.begin(), contractedEdgeList.end());
+    sort(contractedEdgeList.begin(), contractedEdgeList.end(), QueryEdge::CompareBySourceAndDirection);
     unsigned numberOfNodes = 0;
     unsigned numberOfEdges = contractedEdgeList.size();
     INFO("Serializing compacted graph");
-    ofstream edgeOutFile(graphOut, ios::binary);
 
     BOOST_FOREACH(QueryEdge & edge, contractedEdgeList) {
         if(edge.source > numberOfNodes) {
@@ -253,17 +286,11 @@ int main (int argc, char *argv[]) {
         _nodes[node].firstEdge = position; //=edge
         position += edge - lastEdge; //remove
     }
-    ++numberOfNodes;
-    //Serialize numberOfNodes, nodes
-    edgeOutFile.write((char*) &crc32OfNodeBasedEdgeList, sizeof(unsigned));
-    edgeOutFile.write((char*) &numberOfNodes, sizeof(unsigned));
-    edgeOutFile.write((char*) &_nodes[0], sizeof(StaticGraph<EdgeData>::_StrNode)*(numberOfNodes));
-    //Serialize number of Edges
-    edgeOutFile.write((char*) &position, sizeof(unsigned));
-    --numberOfNodes;
     edge = 0;
     int usedEdgeCounter = 0;
     StaticGraph<EdgeData>::_StrEdge currentEdge;
+    std::vector< StaticGraph<EdgeData>::_StrEdge > queryEdges;
+    queryEdges.reserve(position);
     for ( StaticGraph<EdgeData>::NodeIterator node = 0; node < numberOfNodes; ++node ) {
         for ( StaticGraph<EdgeData>::EdgeIterator i = _nodes[node].firstEdge, e = _nodes[node+1].firstEdge; i != e; ++i ) {
             assert(node != contractedEdgeList[edge].target);
@@ -273,8 +300,7 @@ int main (int argc, char *argv[]) {
                 INFO("Edge: " << i << ",source: " << contractedEdgeList[edge].source << ", target: " << contractedEdgeList[edge].target << ", dist: " << currentEdge.data.distance);
                 ERR("Failed at edges of node " << node << " of " << numberOfNodes);
             }
-            //Serialize edges
-            edgeOutFile.write((char*) &currentEdge, sizeof(StaticGraph<EdgeData>::_StrEdge));
+            queryEdges.push_back(currentEdge);
             ++edge;
             ++usedEdgeCounter;
         }
@@ -283,9 +309,126 @@ int main (int argc, char *argv[]) {
     INFO("Expansion  : " << (nodeBasedNodeNumber/expansionHasFinishedTime) << " nodes/sec and "<< (edgeBasedNodeNumber/expansionHasFinishedTime) << " edges/sec");
     INFO("Contraction: " << (edgeBasedNodeNumber/expansionHasFinishedTime) << " nodes/sec and "<< usedEdgeCounter/endTime << " edges/sec");
 
-    edgeOutFile.close();
     //cleanedEdgeList.clear();
+
+    /***
+     * Serializing the query graph in the layout that osrm-routed maps into memory as is.
+     */
+
+    {
+        std::vector< SplitStaticGraph<EdgeData>::_StrNode > splitNodes(_nodes.size());
+        for(unsigned i = 0; i < _nodes.size(); ++i) {
+            splitNodes[i].firstEdge = _nodes[i].firstEdge;
+        }
+        std::vector< SplitStaticGraph<EdgeData>::_StrEdge > splitEdges(queryEdges.size());
+        for(unsigned i = 0; i < queryEdges.size(); ++i) {
+            splitEdges[i].target = queryEdges[i].target;
+            splitEdges[i].data = queryEdges[i].data;
+        }
+        SplitStaticGraph<EdgeData> splitGraph(splitNodes, splitEdges);
+        splitGraph.WriteContainer(graphOut, crc32OfNodeBasedEdgeList);
+    }
+
+    /***
+     * Serializing the halves of each shortcut, so that the query does not need to search for them.
+     */
+
+    INFO("Building shortcut unpacking index");
+    std::vector<ShortcutUnpackingIndex::_StrEdgeHalves> edgeHalves;
+    std::vector<unsigned> edgeLengths;
+    {
+        StaticGraph<EdgeData> queryGraph(_nodes, queryEdges);
+        ShortcutUnpackingIndex::Build(queryGraph, edgeHalves);
+        INFO("Building edge length table");
+        EdgeLengthTable::Build(queryGraph, edgeHalves, edgeBasedNodeLengths, edgeLengths);
+    }
+    std::vector< StaticGraph<EdgeData>::_StrEdge >().swap(queryEdges);
+    const unsigned numberOfEdgeHalves = edgeHalves.size();
+    std::ofstream shortcutsOutFile(shortcutsOut, std::ios::binary);
+    shortcutsOutFile.write((char*) &crc32OfNodeBasedEdgeList, sizeof(unsigned));
+    shortcutsOutFile.write((char*) &numberOfEdgeHalves, sizeof(unsigned));
+    shortcutsOutFile.write((char*) &edgeHalves[0], sizeof(ShortcutUnpackingIndex::_StrEdgeHalves)*numberOfEdgeHalves);
+    shortcutsOutFile.close();
+    std::vector<ShortcutUnpackingIndex::_StrEdgeHalves>().swap(edgeHalves);
+
+    /***
+     * Serializing the length of each edge-based node and of each edge, so that summary queries do not need to unpack the route.
+     */
+
+    const unsigned numberOfNodeLengths = edgeBasedNodeLengths.size();
+    const unsigned numberOfEdgeLengths = edgeLengths.size();
+    std::ofstream lengthsOutFile(lengthsOut, std::ios::binary);
+    lengthsOutFile.write((char*) &crc32OfNodeBasedEdgeList, sizeof(unsigned));
+    lengthsOutFile.write((char*) &numberOfNodeLengths, sizeof(unsigned));
+    lengthsOutFile.write((char*) &edgeBasedNodeLengths[0], sizeof(unsigned)*numberOfNodeLengths);
+    lengthsOutFile.write((char*) &numberOfEdgeLengths, sizeof(unsigned));
+    lengthsOutFile.write((char*) &edgeLengths[0], sizeof(unsigned)*numberOfEdgeLengths);
+    lengthsOutFile.close();
+    std::vector<unsigned>().swap(edgeBasedNodeLengths);
+    std::vector<unsigned>().swap(edgeLengths);
     _nodes.clear();
+
+    /***
+     * Renumbering nodes by descending level and serializing their incoming downward edges for one-to-all queries.
+     */
+
+    INFO("Serializing level ordered graph");
+    const unsigned numberOfLevelOrderedNodes = nodeLevels.size();
+    std::vector<NodeID> originalNodeIDOfPosition(numberOfLevelOrderedNodes);
+    for(NodeID node = 0; node < numberOfLevelOrderedNodes; ++node) {
+        originalNodeIDOfPosition[node] = node;
+    }
+    LevelComparator levelComparator(nodeLevels);
+    std::stable_sort(originalNodeIDOfPosition.begin(), originalNodeIDOfPosition.end(), levelComparator);
+    std::vector<NodeID> positionOfNode(numberOfLevelOrderedNodes);
+    std::vector<_Coordinate> coordinateOfPosition(numberOfLevelOrderedNodes);
+    for(NodeID position = 0; position < numberOfLevelOrderedNodes; ++position) {
+        positionOfNode[originalNodeIDOfPosition[position]] = position;
+        coordinateOfPosition[position] = edgeBasedNodeCoordinates[originalNodeIDOfPosition[position]];
+    }
+    std::vector<_Coordinate>().swap(edgeBasedNodeCoordinates);
+
+    //A downward edge u->v is stored at the lower node v with target u and the backward flag set.
+    std::vector<LevelOrderedGraph::_StrNode> levelOrderedNodes(numberOfLevelOrderedNodes+1);
+    for(unsigned i = 0; i <= numberOfLevelOrderedNodes; ++i) {
+        levelOrderedNodes[i].firstEdge = 0;
+    }
+    BOOST_FOREACH(const QueryEdge & edge, contractedEdgeList) {
+        if(!edge.data.backward)
+            continue;
+        if(nodeLevels[edge.target] <= nodeLevels[edge.source]) {
+            ERR("Edge (" << edge.source << "," << edge.target << ") does not point upwards in the hierarchy");
+        }
+        ++levelOrderedNodes[positionOfNode[edge.source]+1].firstEdge;
+    }
+    for(unsigned i = 0; i < numberOfLevelOrderedNodes; ++i) {
+        levelOrderedNodes[i+1].firstEdge += levelOrderedNodes[i].firstEdge;
+    }
+    const unsigned numberOfLevelOrderedEdges = levelOrderedNodes[numberOfLevelOrderedNodes].firstEdge;
+    std::vector<LevelOrderedGraph::_StrEdge> levelOrderedEdges(numberOfLevelOrderedEdges);
+    std::vector<unsigned> nextEdgeOfPosition(numberOfLevelOrderedNodes);
+    for(unsigned i = 0; i < numberOfLevelOrderedNodes; ++i) {
+        nextEdgeOfPosition[i] = levelOrderedNodes[i].firstEdge;
+    }
+    BOOST_FOREACH(const QueryEdge & edge, contractedEdgeList) {
+        if(!edge.data.backward)
+            continue;
+        LevelOrderedGraph::_StrEdge & levelOrderedEdge = levelOrderedEdges[nextEdgeOfPosition[positionOfNode[edge.source]]++];
+        levelOrderedEdge.source = positionOfNode[edge.target];
+        levelOrderedEdge.distance = edge.data.distance;
+    }
+    contractedEdgeList.clear();
+
+    std::ofstream levelOutFile(levelInfoOut, std::ios::binary);
+    levelOutFile.write((char*) &crc32OfNodeBasedEdgeList, sizeof(unsigned));
+    levelOutFile.write((char*) &numberOfLevelOrderedNodes, sizeof(unsigned));
+    levelOutFile.write((char*) &originalNodeIDOfPosition[0], sizeof(NodeID)*numberOfLevelOrderedNodes);
+    levelOutFile.write((char*) &coordinateOfPosition[0], sizeof(_Coordinate)*numberOfLevelOrderedNodes);
+    levelOutFile.write((char*) &levelOrderedNodes[0], sizeof(LevelOrderedGraph::_StrNode)*(numberOfLevelOrderedNodes+1));
+    levelOutFile.write((char*) &numberOfLevelOrderedEdges, sizeof(unsigned));
+    levelOutFile.write((char*) &levelOrderedEdges[0], sizeof(LevelOrderedGraph::_StrEdge)*numberOfLevelOrderedEdges);
+    levelOutFile.close();
+    INFO("Level ordered graph has " << numberOfLevelOrderedNodes << " nodes and " << numberOfLevelOrderedEdges << " downward edges");
     INFO("finished preprocessing");
     return 0;
 }
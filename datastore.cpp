@@ -0,0 +1,52 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include <iostream>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "DataStructures/Util.h"
+#include "Server/DataStructures/DatasetFactory.h"
+#include "Server/DataStructures/SharedDataset.h"
+#include "Server/ServerConfiguration.h"
+#include "typedefs.h"
+
+/*
+ * Loads the data files named in server.ini into a new dataset in shared
+ * memory and makes it the current one. osrm-routed processes that run with
+ * SharedMemory = 1 switch to it while they keep answering requests. The
+ * checksums of all files are verified before anything is published.
+ */
+
+int main (int argc, char *argv[]) {
+    try {
+        double startupTime = get_timestamp();
+        ServerConfiguration serverConfig("server.ini");
+        const unsigned generation = SharedDataset::GetCurrentGeneration() + 1;
+        INFO("Loading dataset " << generation << " into shared memory");
+        boost::scoped_ptr<SharedDataset> dataset(DatasetFactory::CreateDataset(serverConfig, generation));
+        dataset->MakeCurrent();
+        INFO("Dataset " << generation << " is current, loading took " << get_timestamp() - startupTime << " sec");
+    } catch (std::exception& e) {
+        ERR("exception: " << e.what());
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+@cache
+Feature: Caches answer like the computation they stand in for
+
+	Background:
+		Given the node map
+		 | a |   | b |   | c |
+		 |   | x |   | y |   |
+		 | d |   | e |   | f |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | def   |
+		 | ad    |
+		 | be    |
+		 | cf    |
+
+	Scenario: Cached routes are identical to computed ones
+		Then the routes are the same with the server setting "ResponseCacheSize" of "1"
+		 | from | to |
+		 | a    | f  |
+		 | f    | a  |
+		 | x    | y  |
+		 | y    | c  |
+
+	Scenario: Cached nearest streets are identical to looked up ones
+		Then the nearest streets of "xyabe" are the same with the server setting "ResponseCacheSize" of "1"
+
+	Scenario: Routes from cached snapped coordinates are identical to computed ones
+		Then the routes are the same with the server setting "SnappingCacheSize" of "100"
+		 | from | to |
+		 | a    | f  |
+		 | x    | y  |
+		 | y    | x  |
+		 | x    | c  |
+
+	Scenario: Routes from cached snapped coordinates of the grid are identical to computed ones
+		Given the nearest streets are looked up in the grid
+		Then the routes are the same with the server setting "SnappingCacheSize" of "100"
+		 | from | to |
+		 | a    | f  |
+		 | x    | y  |
+		 | y    | x  |
+		 | x    | c  |
+
+	Scenario: Nearest streets from cached grid cells are identical to read ones
+		Given the nearest streets are looked up in the grid
+		Then the nearest streets of "xyabe" are the same with the server setting "GridCacheSize" of "1"
+		And the routes are the same with the server setting "GridCacheSize" of "1"
+		 | from | to |
+		 | a    | f  |
+		 | x    | y  |
+		 | y    | c  |
+
+	Scenario: Shortcuts unpacked through their index give the same routes as unpacked by search
+		Then the routes are the same with the server setting "shortcutsData" of "none"
+		 | from | to |
+		 | a    | f  |
+		 | f    | a  |
+		 | d    | c  |
+		 | x    | y  |
@@ -0,0 +1,21 @@
+@connection
+Feature: Persistent connections
+
+	Scenario: Connection headers are case insensitive
+		Given the node map
+		 | a | b |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+
+		When I send requests with these headers the connection should be
+		 | version  | header                 | connection |
+		 | HTTP/1.1 |                        | keep-alive |
+		 | HTTP/1.1 | Connection: close      | close      |
+		 | HTTP/1.1 | connection: close      | close      |
+		 | HTTP/1.1 | CONNECTION: Close      | close      |
+		 | HTTP/1.0 |                        | close      |
+		 | HTTP/1.0 | Connection: keep-alive | keep-alive |
+		 | HTTP/1.0 | Connection: Keep-Alive | keep-alive |
+		 | HTTP/1.0 | connection: KEEP-ALIVE | keep-alive |
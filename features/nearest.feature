@@ -0,0 +1,112 @@
+@nearest
+Feature: Nearest streets
+
+	Scenario: Candidates are ranked by distance
+		Given the node map
+		 | a | b | c |
+		 |   | x |   |
+		 | d | e | f |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | def   |
+
+		When I request 4 nearest streets of "x" I should get 4 candidates
+
+	Scenario: Candidates are limited by the radius
+		Given the node map
+		 | a | b | c | d |
+		 |   |   |   |   |
+		 | x |   |   |   |
+
+		And the ways
+		 | nodes |
+		 | abcd  |
+
+		When I request nearest streets of "x" within 1000 I should get 3 candidates
+		And I request nearest streets of "x" within 50 I should get 0 candidates
+
+	Scenario: Streets more than one grid cell away are found without the r-tree
+		Given the nearest streets are looked up in the grid
+		And a grid size of 1000 meters
+		And the node map
+		 | a | b | c |
+		 |   |   |   |
+		 |   |   |   |
+		 | x |   |   |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+
+		When I request 2 nearest streets of "x" I should get 2 candidates
+		And I request nearest streets of "x" within 1000 I should get 0 candidates
+		And I route I should get
+		 | from | to | route |
+		 | x    | c  | abc   |
+
+	Scenario: Points beyond the ends of streets snap to the ends
+		Given the node map
+		 | w |   |   |   |   |   |   |   |   |   |   | z |
+		 |   | a | b | c | d | e | f | g | h | i | j |   |
+		 | x |   |   |   |   |   |   |   |   |   |   | y |
+		 |   |   |   |   |   |   |   |   |   |   |   |   |
+		 |   | k | l |   | m |   |   |   |   |   |   |   |
+
+		And the ways
+		 | nodes      | oneway |
+		 | abcdefghij |        |
+		 | kl         | yes    |
+
+		Then the nearest streets are mapped to
+		 | from | to |
+		 | w    | a  |
+		 | x    | a  |
+		 | z    | j  |
+		 | y    | j  |
+		 | m    | l  |
+
+	Scenario: Points beyond the ends of streets snap to the ends in the grid
+		Given the nearest streets are looked up in the grid
+		And the node map
+		 | w |   |   |   |   |   |   |   |   |   |   | z |
+		 |   | a | b | c | d | e | f | g | h | i | j |   |
+		 | x |   |   |   |   |   |   |   |   |   |   | y |
+		 |   |   |   |   |   |   |   |   |   |   |   |   |
+		 |   | k | l |   | m |   |   |   |   |   |   |   |
+
+		And the ways
+		 | nodes      | oneway |
+		 | abcdefghij |        |
+		 | kl         | yes    |
+
+		Then the nearest streets are mapped to
+		 | from | to |
+		 | w    | a  |
+		 | x    | a  |
+		 | z    | j  |
+		 | y    | j  |
+		 | m    | l  |
+
+	Scenario: The grid built by several threads finds the same streets as the one built by one thread
+		Given the nearest streets are looked up in the grid
+		And the node map
+		 | a |   | b |   | c |   | d |
+		 |   | w |   | x |   | y |   |
+		 | e |   | f |   | g |   | h |
+		 |   | z |   | 1 |   | 2 |   |
+		 | i |   | j |   | k |   | l |
+
+		And the ways
+		 | nodes | oneway |
+		 | abcd  |        |
+		 | efgh  |        |
+		 | ijkl  | yes    |
+		 | aei   |        |
+		 | bfj   |        |
+		 | cgk   |        |
+		 | dhl   | yes    |
+		 | ej    |        |
+
+		Then the nearest streets of "wxyz12abgl" are the same when the data is prepared by 1 and by 4 threads
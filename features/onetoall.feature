@@ -0,0 +1,26 @@
+@routing @onetoall
+Feature: Travel times to all nodes
+	
+	Scenario: All nodes of a square are reachable
+		Given the node map
+		 | a | b |
+		 | c | d |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+		 | cd    |
+		 | ac    |
+		 | bd    |
+
+		When I request travel times from "a" I should reach 8 nodes
+
+	Scenario: Travel times are limited by max
+		Given the node map
+		 | a | b | c | d |
+
+		And the ways
+		 | nodes |
+		 | abcd  |
+
+		When I request travel times from "a" within 300 I should reach nodes no farther than 300
@@ -0,0 +1,40 @@
+require 'socket'
+
+#value of the Connection header of the reply, and whether a second request on the same connection is answered
+def request_on_connection version, header
+  socket = TCPSocket.new 'localhost', 5000
+  request = "GET /timestamp #{version}\r\nHost: localhost\r\n"
+  request += "#{header}\r\n" unless header.empty?
+  request += "\r\n"
+  socket.write request
+  headers = ''
+  while (line = socket.gets) && line != "\r\n"
+    headers += line
+  end
+  socket.read headers[/^Content-Length: *(\d+)/i, 1].to_i
+  connection = headers[/^Connection: *([^\r]*)/i, 1]
+  answered = begin
+    socket.write request
+    IO.select([socket], nil, nil, 2) && !socket.readpartial(4096).empty?
+  rescue EOFError, Errno::ECONNRESET, Errno::EPIPE
+    false
+  end
+  socket.close
+  [connection, answered]
+rescue Errno::ECONNREFUSED => e
+  raise "*** osrm-routed is not running."
+end
+
+When /^I send requests with these headers the connection should be$/ do |table|
+  osrm_kill
+  reprocess
+  actual = []
+  OSRMLauncher.new do
+    table.hashes.each do |row|
+      connection, answered = request_on_connection row['version'], row['header']
+      (answered ? true : false).should == (connection == 'keep-alive')
+      actual << { 'version' => row['version'], 'header' => row['header'], 'connection' => connection.to_s }
+    end
+  end
+  table.routing_diff! actual
+end
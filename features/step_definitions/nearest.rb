@@ -0,0 +1,79 @@
+Given /^the nearest streets are looked up in the grid$/ do
+  @grid_index = true
+end
+
+def request_nearest_candidates name, options
+  osrm_kill
+  reprocess
+  node = find_node_by_name name
+  raise "*** unknown node '#{name}'" unless node
+  response = nil
+  OSRMLauncher.new do
+    response = request_nearest node, options
+  end
+  response.code.should == "200"
+  JSON.parse response.body
+end
+
+When /^I request (\d+) nearest streets of "([^"]*)" I should get (\d+) candidates$/ do |count,name,expected|
+  json = request_nearest_candidates name, 'num_results' => count
+  json['status'].should == 0
+  json['candidates'].size.should == expected.to_i
+  json['candidates'].first['mapped_coordinate'].should == json['mapped_coordinate']
+  distances = json['candidates'].map { |c| c['distance'] }
+  distances.should == distances.sort
+end
+
+When /^I request nearest streets of "([^"]*)" within (\d+) I should get (\d+) candidates$/ do |name,radius,expected|
+  json = request_nearest_candidates name, 'num_results' => 10, 'radius' => radius
+  json['candidates'].size.should == expected.to_i
+  json['candidates'].each { |c| c['distance'].should <= radius.to_i }
+  json['status'].should == (expected.to_i > 0 ? 0 : 207)
+end
+
+def request_nearest_bodies names, options
+  names.split('').map do |name|
+    node = find_node_by_name name
+    raise "*** unknown node '#{name}'" unless node
+    response = request_nearest node, options
+    response.code.should == "200"
+    response.body
+  end
+end
+
+Then /^the nearest streets of "([^"]*)" are the same with the server setting "([^"]*)" of "([^"]*)"$/ do |names,key,value|
+  options = { 'num_results' => 4 }
+  expected = with_server_settings({}) { request_nearest_bodies names, options }
+  #the second round is answered from what the first one left in the caches
+  actual = with_server_settings(key => value) { request_nearest_bodies(names, options) + request_nearest_bodies(names, options) }
+  actual.should == expected + expected
+end
+
+Then /^the nearest streets are mapped to$/ do |table|
+  osrm_kill
+  reprocess
+  OSRMLauncher.new do
+    table.hashes.each do |row|
+      node = find_node_by_name row['from']
+      expected = find_node_by_name row['to']
+      raise "*** unknown node '#{row['from']}'" unless node
+      raise "*** unknown node '#{row['to']}'" unless expected
+      response = request_nearest node
+      response.code.should == "200"
+      json = JSON.parse response.body
+      json['status'].should == 0
+      #coordinates have a precision of 1e-5 degrees
+      (json['mapped_coordinate'][0] - expected.lat).abs.should <= 0.00001
+      (json['mapped_coordinate'][1] - expected.lon).abs.should <= 0.00001
+    end
+  end
+end
+
+Then /^the nearest streets of "([^"]*)" are the same when the data is prepared by (\d+) and by (\d+) threads$/ do |names,a,b|
+  responses = [a,b].map do |threads|
+    @preparation_threads = threads.to_i
+    @fingerprint = nil
+    with_server_settings({}) { request_nearest_bodies names, 'num_results' => 4 }
+  end
+  responses[1].should == responses[0]
+end
@@ -0,0 +1,26 @@
+def request_travel_times_from name, max=nil
+  osrm_kill
+  reprocess
+  node = find_node_by_name name
+  raise "*** unknown node '#{name}'" unless node
+  response = nil
+  OSRMLauncher.new do
+    response = request_onetoall node, max
+  end
+  response.code.should == "200"
+  json = JSON.parse response.body
+  json['status'].should == 0
+  json['reachable_nodes']
+end
+
+When /^I request travel times from "([^"]*)" I should reach (\d+) nodes$/ do |name,count|
+  nodes = request_travel_times_from name
+  nodes.size.should == count.to_i
+  nodes.each { |n| n[2].should >= 0 }
+end
+
+When /^I request travel times from "([^"]*)" within (\d+) I should reach nodes no farther than (\d+)$/ do |name,max,limit|
+  nodes = request_travel_times_from name, max
+  nodes.size.should > 0
+  nodes.each { |n| n[2].should <= limit.to_i }
+end
@@ -266,3 +266,24 @@ When /^I route I should get$/ do |table|
   end
   table.routing_diff! actual
 end
+
+Then /^the routes are the same with the server setting "([^"]*)" of "([^"]*)"$/ do |key,value,table|
+  locations = table.hashes.map do |row|
+    from = find_node_by_name row['from']
+    to = find_node_by_name row['to']
+    raise "*** unknown node '#{row['from']}'" unless from
+    raise "*** unknown node '#{row['to']}'" unless to
+    ["#{from.lat},#{from.lon}", "#{to.lat},#{to.lon}"]
+  end
+  request_routes = lambda do
+    locations.map do |a,b|
+      response = request_route a,b
+      response.code.should == "200"
+      response.body
+    end
+  end
+  expected = with_server_settings({}) { request_routes.call }
+  #the second round is answered from what the first one left in the caches
+  actual = with_server_settings(key => value) { request_routes.call + request_routes.call }
+  actual.should == expected + expected
+end
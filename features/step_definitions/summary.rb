@@ -0,0 +1,19 @@
+When /^I request route summaries they should match the routes between$/ do |table|
+  osrm_kill
+  reprocess
+  OSRMLauncher.new do
+    table.hashes.each do |row|
+      from_node = @name_node_hash[ row['from'] ]
+      raise "*** unknown from-node '#{row['from']}" unless from_node
+      to_node = @name_node_hash[ row['to'] ]
+      raise "*** unknown to-node '#{row['to']}" unless to_node
+      a = "#{from_node.lat},#{from_node.lon}"
+      b = "#{to_node.lat},#{to_node.lon}"
+      route = JSON.parse request_route(a,b).body
+      summary = JSON.parse request_summary(a,b).body
+      summary['status'].should == route['status']
+      summary['route_summary']['total_time'].should == route['route_summary']['total_time']
+      summary['route_summary']['total_distance'].should be_within(10).of(route['route_summary']['total_distance'])
+    end
+  end
+end
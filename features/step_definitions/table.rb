@@ -0,0 +1,40 @@
+When /^I request a travel time matrix I should get the route times between "([^"]*)"$/ do |names|
+  osrm_kill
+  reprocess
+  nodes = names.split('').map do |name|
+    node = find_node_by_name name
+    raise "*** unknown node '#{name}'" unless node
+    node
+  end
+  OSRMLauncher.new do
+    response = request_table nodes
+    response.code.should == "200"
+    json = JSON.parse response.body
+    json['status'].should == 0
+    json['distance_table'].size.should == nodes.size
+    nodes.each_with_index do |from_node,i|
+      json['distance_table'][i].size.should == nodes.size
+      nodes.each_with_index do |to_node,j|
+        next if i == j
+        route = JSON.parse request_route("#{from_node.lat},#{from_node.lon}", "#{to_node.lat},#{to_node.lon}").body
+        route['status'].should == 0
+        (json['distance_table'][i][j]/10.0 - route['route_summary']['total_time'].to_i).abs.should <= 1
+      end
+    end
+  end
+end
+
+When /^I request a travel time matrix of "([^"]*)" repeated (\d+) times I should get (\d+)$/ do |name,count,code|
+  osrm_kill
+  reprocess
+  node = find_node_by_name name
+  raise "*** unknown node '#{name}'" unless node
+  OSRMLauncher.new do
+    response = request_table [node]*count.to_i
+    response.code.should == code
+    if code == "200"
+      json = JSON.parse response.body
+      json['distance_table'].size.should == count.to_i
+    end
+  end
+end
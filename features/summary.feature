@@ -0,0 +1,35 @@
+@routing @summary
+Feature: Route summaries without unpacking the route
+
+	Scenario: Summary of a winding path
+		Given a grid size of 100 meters
+		Given the node map
+		 | a | b | e | f |
+		 | d | c | h | g |
+
+		And the ways
+		 | nodes    |
+		 | abcdefgh |
+
+		When I request route summaries they should match the routes between
+		 | from | to |
+		 | a    | b  |
+		 | a    | h  |
+		 | h    | a  |
+		 | c    | f  |
+
+	Scenario: Summary of a route through a junction
+		Given the node map
+		 |   | c |   |
+		 | a | b | d |
+
+		And the ways
+		 | nodes |
+		 | abd   |
+		 | bc    |
+
+		When I request route summaries they should match the routes between
+		 | from | to |
+		 | a    | c  |
+		 | c    | d  |
+		 | d    | a  |
@@ -24,6 +24,10 @@ def write_speedprofile
   File.open( 'speedprofile.ini', 'w') {|f| f.write( speedprofile_str ) }
 end
 
+def write_contractor_ini
+  File.open( 'contractor.ini', 'w') {|f| f.write( "Threads = #{@preparation_threads}\n" ) }
+end
+
 def write_server_ini
   s=<<-EOF
 Threads = 1
@@ -35,8 +39,25 @@ nodesData=#{@osm_file}.osrm.nodes
 edgesData=#{@osm_file}.osrm.edges
 ramIndex=#{@osm_file}.osrm.ramIndex
 fileIndex=#{@osm_file}.osrm.fileIndex
+#{"rtreeData=#{@osm_file}.osrm.rtree" unless @grid_index}
 namesData=#{@osm_file}.osrm.names
+levelsData=#{@osm_file}.osrm.levels
+shortcutsData=#{@osm_file}.osrm.shortcuts
+lengthsData=#{@osm_file}.osrm.lengths
+#{@server_settings.map { |k,v| "#{k} = #{v}" }.join("\n")}
 EOF
   File.open( 'server.ini', 'w') {|f| f.write( s ) }
 end
 
+
+#runs the server with the settings on top of the defaults and returns what the block got from it
+def with_server_settings settings
+  @server_settings = settings
+  osrm_kill
+  reprocess
+  result = nil
+  OSRMLauncher.new do
+    result = yield
+  end
+  result
+end
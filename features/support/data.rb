@@ -82,6 +82,9 @@ def reset_data
   reset_speedprofile
   reset_osm
   @fingerprint = nil
+  @grid_index = false
+  @server_settings = {}
+  @preparation_threads = 4
 end
 
 def make_osm_id
@@ -165,6 +168,7 @@ end
 def reprocess
   Dir.chdir TEST_FOLDER do
     write_speedprofile
+    write_contractor_ini
     write_osm
     convert_osm_to_pbf
     unless extracted?
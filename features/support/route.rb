@@ -83,3 +83,46 @@ def bearing_list instructions
   map { |r| r=="" ? '""' : r }.
   join(',')
 end
+
+def request_table nodes
+  locations = nodes.map { |n| "loc=#{n.lat},#{n.lon}" }.join('&')
+  @query = "http://localhost:5000/table?#{locations}"
+  uri = URI.parse @query
+  Net::HTTP.get_response uri
+rescue Errno::ECONNREFUSED => e
+  raise "*** osrm-routed is not running."
+rescue Timeout::Error
+  raise "*** osrm-routed did not respond."
+end
+
+def request_summary a,b
+  @query = "http://localhost:5000/viaroute?loc=#{a}&loc=#{b}&output=summary"
+  uri = URI.parse @query
+  Net::HTTP.get_response uri
+rescue Errno::ECONNREFUSED => e
+  raise "*** osrm-routed is not running."
+rescue Timeout::Error
+  raise "*** osrm-routed did not respond."
+end
+
+def request_onetoall node, max=nil
+  @query = "http://localhost:5000/onetoall?loc=#{node.lat},#{node.lon}"
+  @query += "&max=#{max}" if max
+  uri = URI.parse @query
+  Net::HTTP.get_response uri
+rescue Errno::ECONNREFUSED => e
+  raise "*** osrm-routed is not running."
+rescue Timeout::Error
+  raise "*** osrm-routed did not respond."
+end
+
+def request_nearest node, options={}
+  @query = "http://localhost:5000/nearest?loc=#{node.lat},#{node.lon}"
+  options.each { |k,v| @query += "&#{k}=#{v}" }
+  uri = URI.parse @query
+  Net::HTTP.get_response uri
+rescue Errno::ECONNREFUSED => e
+  raise "*** osrm-routed is not running."
+rescue Timeout::Error
+  raise "*** osrm-routed did not respond."
+end
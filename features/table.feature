@@ -0,0 +1,41 @@
+@routing @table
+Feature: Travel time matrix
+	
+	Scenario: Matrix of a square
+		Given the node map
+		 | a | b |
+		 | c | d |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+		 | cd    |
+		 | ac    |
+		 | bd    |
+
+		When I request a travel time matrix I should get the route times between "abcd"
+
+	Scenario: Matrix with oneways
+		Given the node map
+		 | a | b | c |
+		 | d | e | f |
+
+		And the ways
+		 | nodes | oneway |
+		 | abc   | yes    |
+		 | def   | -1     |
+		 | ad    | no     |
+		 | cf    | no     |
+
+		When I request a travel time matrix I should get the route times between "acdf"
+
+	Scenario: Matrix with too many locations is rejected
+		Given the node map
+		 | a | b |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+
+		When I request a travel time matrix of "a" repeated 100 times I should get 200
+		And I request a travel time matrix of "a" repeated 101 times I should get 400
@@ -17,33 +17,43 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 or see http://www.gnu.org/licenses/agpl.txt.
  */
-#ifdef __linux__
-#include <sys/mman.h>
-#endif
 #include <iostream>
 #include <signal.h>
+#include <stdexcept>
+#include <vector>
 
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
+#include "Server/DataStructures/DatasetFactory.h"
 #include "Server/DataStructures/QueryObjectsStorage.h"
+#include "Server/DataStructures/SharedDataset.h"
 #include "Server/ServerConfiguration.h"
 #include "Server/ServerFactory.h"
 
+#include "Plugins/DistanceTablePlugin.h"
 #include "Plugins/HelloWorldPlugin.h"
 #include "Plugins/LocatePlugin.h"
 #include "Plugins/NearestPlugin.h"
+#include "Plugins/OneToAllPlugin.h"
 #include "Plugins/TimestampPlugin.h"
 #include "Plugins/ViaRoutePlugin.h"
 
 #include "Util/InputFileUtil.h"
+#include "Util/NUMAUtil.h"
 #include "Util/OpenMPWrapper.h"
+#include "Util/ResidencyPolicy.h"
 
 #ifndef _WIN32
 #include "Util/LinuxStackTrace.h"
 #endif
 
 typedef http::RequestHandler RequestHandler;
+//one set of query data per NUMA node that server threads are pinned to
+typedef std::vector<boost::shared_ptr<QueryObjectsStorage> > ReplicaVector;
 
 #ifdef _WIN32
 boost::function0<void> console_ctrl_function;
@@ -64,11 +74,183 @@ BOOL WINAPI console_ctrl_handler(DWORD ctrl_type)
 }
 #endif
 
+//a new set of plugins that work on the given data
+static void CreatePlugins(ServerConfiguration & serverConfig, const boost::shared_ptr<QueryObjectsStorage> & objects, std::vector<BasePlugin *> & plugins) {
+    const int snappingCacheSize = atoi(serverConfig.GetParameter("SnappingCacheSize").c_str());
+    if(0 < snappingCacheSize) {
+        std::cout << "[server] caching up to " << snappingCacheSize << " snapped coordinates" << std::endl;
+        objects->nodeHelpDesk->EnableSnappingCache(snappingCacheSize, atoi(serverConfig.GetParameter("SnappingCacheGrid").c_str()));
+    }
+    const int gridCacheSize = atoi(serverConfig.GetParameter("GridCacheSize").c_str());
+    if(0 < gridCacheSize && objects->nodeHelpDesk->UsesGrid()) {
+        std::cout << "[server] caching grid cells in up to " << gridCacheSize << " MB" << std::endl;
+        objects->nodeHelpDesk->EnableGridCache(((std::size_t)gridCacheSize) << 20);
+    }
+
+    plugins.push_back(new HelloWorldPlugin());
+
+    plugins.push_back(new LocatePlugin(objects.get()));
+
+    plugins.push_back(new NearestPlugin(objects.get()));
+
+    plugins.push_back(new TimestampPlugin(objects.get()));
+
+    const int maxNumberOfLocations = atoi(serverConfig.GetParameter("MaxLocations").c_str());
+    plugins.push_back(new ViaRoutePlugin(objects.get(), std::max(1, atoi(serverConfig.GetParameter("ThreadsPerRoute").c_str())), (1 < maxNumberOfLocations ? maxNumberOfLocations : BasePlugin::DEFAULT_MAX_NUMBER_OF_LOCATIONS)));
+
+    plugins.push_back(new DistanceTablePlugin(objects.get()));
+
+    if(NULL != objects->levelOrderedGraph)
+        plugins.push_back(new OneToAllPlugin(objects.get()));
+}
+
+//publishes the plugins of all replicas at once, a request never sees replicas of different data
+static void RegisterReplicas(RequestHandler & h, ServerConfiguration & serverConfig, const ReplicaVector & replicas) {
+    std::vector<std::vector<BasePlugin *> > plugins(replicas.size());
+    std::vector<boost::shared_ptr<void> > data(replicas.begin(), replicas.end());
+    std::vector<unsigned> checkSums(replicas.size());
+    for(unsigned i = 0; i < replicas.size(); ++i) {
+        CreatePlugins(serverConfig, replicas[i], plugins[i]);
+        checkSums[i] = replicas[i]->checkSum;
+    }
+    h.ReplacePlugins(plugins, data, checkSums);
+}
+
+//SIGHUP and the watcher of shared memory load and switch data one after the other
+static boost::mutex switchDataMutex;
+//generation of the shared dataset that is served, guarded by switchDataMutex
+static unsigned servedGeneration = 0;
+
+//Pages of the data are kept in memory per section as server.ini asks for. Only the data is
+//locked, buffers of connections and replies can still be swapped out.
+static void ApplyResidencyPolicies(ServerConfiguration & serverConfig, QueryObjectsStorage & objects) {
+    objects.ApplyResidencyPolicies(ResidencyPolicy(serverConfig.GetParameter("GraphResidency")),
+            ResidencyPolicy(serverConfig.GetParameter("OriginalEdgesResidency")),
+            ResidencyPolicy(serverConfig.GetParameter("NamesResidency")),
+            ResidencyPolicy(serverConfig.GetParameter("IndexResidency"))
+            );
+}
+
+//the dataset that osrm-datastore made current, throws if there is none
+static SharedDataset * AttachToSharedDataset() {
+    SharedDataset * dataset = SharedDataset::AttachToCurrent();
+    if(NULL == dataset) {
+        throw std::runtime_error("No dataset in shared memory, run osrm-datastore first");
+    }
+    return dataset;
+}
+
+//builds a replica in a thread on the given NUMA node, which touches and thereby allocates all of its memory first
+static void LoadReplica(ServerConfiguration & serverConfig, const SharedDataset & dataset, const unsigned node, const unsigned replica, boost::shared_ptr<QueryObjectsStorage> & objects) {
+    try {
+        if(!PinThreadToNUMANode(node, replica))
+            WARN("could not pin loader to NUMA node " << node << ", its replica may be remote");
+        objects.reset(new QueryObjectsStorage(dataset.CreatePrivateCopy(),
+                serverConfig.GetParameter("levelsData"),
+                serverConfig.GetParameter("shortcutsData"),
+                serverConfig.GetParameter("lengthsData")
+                ));
+        ApplyResidencyPolicies(serverConfig, *objects);
+    } catch(std::exception & e) {
+        std::cerr << "[server] replica for NUMA node " << node << " failed: " << e.what() << std::endl;
+    }
+}
+
+//Loads the data named in server.ini, or attaches to the current shared dataset. If the server threads are
+//pinned to NUMA nodes, each node gets a private copy of the dataset, which in file mode is read from the files.
+static void LoadQueryObjects(ServerConfiguration & serverConfig, const std::vector<unsigned> & numaNodes, ReplicaVector & replicas) {
+    replicas.clear();
+    const bool useSharedMemory = (0 != atoi(serverConfig.GetParameter("SharedMemory").c_str()));
+    if(numaNodes.empty() && useSharedMemory) {
+        replicas.push_back(boost::shared_ptr<QueryObjectsStorage>(new QueryObjectsStorage(AttachToSharedDataset(),
+                serverConfig.GetParameter("levelsData"),
+                serverConfig.GetParameter("shortcutsData"),
+                serverConfig.GetParameter("lengthsData")
+                )));
+        ApplyResidencyPolicies(serverConfig, *replicas[0]);
+        return;
+    }
+    if(numaNodes.empty()) {
+        replicas.push_back(boost::shared_ptr<QueryObjectsStorage>(new QueryObjectsStorage(serverConfig.GetParameter("hsgrData"),
+                serverConfig.GetParameter("ramIndex"),
+                serverConfig.GetParameter("fileIndex"),
+                serverConfig.GetParameter("rtreeData"),
+                serverConfig.GetParameter("nodesData"),
+                serverConfig.GetParameter("edgesData"),
+                serverConfig.GetParameter("namesData"),
+                serverConfig.GetParameter("timestamp"),
+                serverConfig.GetParameter("levelsData"),
+                serverConfig.GetParameter("shortcutsData"),
+                serverConfig.GetParameter("lengthsData")
+                )));
+        ApplyResidencyPolicies(serverConfig, *replicas[0]);
+        return;
+    }
+
+    double startTime = get_timestamp();
+    boost::scoped_ptr<SharedDataset> dataset(useSharedMemory ? AttachToSharedDataset() : DatasetFactory::CreateDataset(serverConfig, 0));
+    replicas.resize(numaNodes.size());
+    boost::thread_group loaders;
+    for(unsigned i = 0; i < numaNodes.size(); ++i) {
+        loaders.create_thread(boost::bind(&LoadReplica, boost::ref(serverConfig), boost::cref(*dataset), numaNodes[i], i, boost::ref(replicas[i])));
+    }
+    loaders.join_all();
+    for(unsigned i = 0; i < replicas.size(); ++i) {
+        if(!replicas[i]) {
+            replicas.clear();
+            throw std::runtime_error("could not replicate the query data on every NUMA node");
+        }
+    }
+    std::cout << "[server] replicated query data on " << numaNodes.size() << " NUMA nodes in " << get_timestamp() - startTime << " sec" << std::endl;
+}
+
+//loads the data and switches to it, the caller holds switchDataMutex
+static void SwitchData(RequestHandler & h, ServerConfiguration & serverConfig, const std::vector<unsigned> & numaNodes) {
+    ReplicaVector replicas;
+    LoadQueryObjects(serverConfig, numaNodes, replicas);
+    RegisterReplicas(h, serverConfig, replicas);
+    //a replica keeps the generation of the dataset that it was copied from
+    if(NULL != replicas[0]->sharedDataset)
+        servedGeneration = replicas[0]->sharedDataset->GetGeneration();
+}
+
+//Builds a new set of data next to the current one and switches to it, requests in flight finish on the old one.
+//server.ini is read only at startup, a reload uses the same files and settings, e.g. of residency and caches.
+static void ReloadData(RequestHandler & h, ServerConfiguration & serverConfig, const std::vector<unsigned> & numaNodes) {
+    try {
+        double startTime = get_timestamp();
+        boost::mutex::scoped_lock lock(switchDataMutex);
+        std::cout << "[server] reloading data, settings of server.ini are kept from the start" << std::endl;
+        SwitchData(h, serverConfig, numaNodes);
+        std::cout << "[server] switched to reloaded data after " << get_timestamp() - startTime << " sec" << std::endl;
+    } catch (std::exception& e) {
+        std::cerr << "[server] reload failed, keeping current data: " << e.what() << std::endl;
+    }
+}
+
+//Switches to the dataset that osrm-datastore made current, requests in flight finish on the old one.
+//A dataset that could not be loaded is not tried again, only the next one that becomes current.
+static void WatchSharedMemory(RequestHandler & h, ServerConfiguration & serverConfig, const std::vector<unsigned> & numaNodes) {
+    unsigned failedGeneration = 0;
+    while(true) {
+        boost::this_thread::sleep(boost::posix_time::seconds(1));
+        const unsigned currentGeneration = SharedDataset::GetCurrentGeneration();
+        try {
+            boost::mutex::scoped_lock lock(switchDataMutex);
+            //a reload on SIGHUP may have switched to it already
+            if(0 == currentGeneration || servedGeneration == currentGeneration || failedGeneration == currentGeneration) {
+                continue;
+            }
+            std::cout << "[server] switching to shared dataset " << currentGeneration << std::endl;
+            SwitchData(h, serverConfig, numaNodes);
+        } catch (std::exception& e) {
+            failedGeneration = currentGeneration;
+            std::cerr << "[server] switching failed, keeping current data: " << e.what() << std::endl;
+        }
+    }
+}
+
 int main (int argc, char *argv[]) {
-#ifdef __linux__
-    if(!mlockall(MCL_CURRENT | MCL_FUTURE))
-        WARN("Process " << argv[0] << "could not be locked to RAM");
-#endif
 #ifndef _WIN32
 
     installCrashHandler(argv[0]);
@@ -96,26 +278,24 @@ int main (int argc, char *argv[]) {
         Server * s = ServerFactory::CreateServer(serverConfig);
         RequestHandler & h = s->GetRequestHandlerPtr();
 
-        QueryObjectsStorage * objects = new QueryObjectsStorage(serverConfig.GetParameter("hsgrData"),
-                serverConfig.GetParameter("ramIndex"),
-                serverConfig.GetParameter("fileIndex"),
-                serverConfig.GetParameter("nodesData"),
-                serverConfig.GetParameter("edgesData"),
-                serverConfig.GetParameter("namesData"),
-                serverConfig.GetParameter("timestamp")
-                );
-
-        h.RegisterPlugin(new HelloWorldPlugin());
-
-        h.RegisterPlugin(new LocatePlugin(objects));
-
-        h.RegisterPlugin(new NearestPlugin(objects));
+        const std::vector<unsigned> & numaNodes = s->GetNUMANodesOfThreads();
+        const bool useSharedMemory = (0 != atoi(serverConfig.GetParameter("SharedMemory").c_str()));
+        {
+            boost::mutex::scoped_lock lock(switchDataMutex);
+            SwitchData(h, serverConfig, numaNodes);
+        }
 
-        h.RegisterPlugin(new TimestampPlugin(objects));
-
-        h.RegisterPlugin(new ViaRoutePlugin(objects));
+        const int responseCacheSize = atoi(serverConfig.GetParameter("ResponseCacheSize").c_str());
+        if(0 < responseCacheSize) {
+            std::cout << "[server] caching responses in up to " << responseCacheSize << " MB" << std::endl;
+            h.EnableResponseCache(((std::size_t)responseCacheSize) << 20);
+        }
 
         boost::thread t(boost::bind(&Server::Run, s));
+        boost::thread watcher;
+        if(useSharedMemory) {
+            watcher = boost::thread(boost::bind(&WatchSharedMemory, boost::ref(h), boost::ref(serverConfig), boost::cref(numaNodes)));
+        }
 
 #ifndef _WIN32
         sigset_t wait_mask;
@@ -124,9 +304,21 @@ int main (int argc, char *argv[]) {
         sigaddset(&wait_mask, SIGINT);
         sigaddset(&wait_mask, SIGQUIT);
         sigaddset(&wait_mask, SIGTERM);
+        sigaddset(&wait_mask, SIGHUP);
         pthread_sigmask(SIG_BLOCK, &wait_mask, 0);
         std::cout << "[server] running and waiting for requests" << std::endl;
-        sigwait(&wait_mask, &sig);
+        //SIGHUP reloads the data while the server keeps answering requests
+        boost::thread reloader;
+        while(0 == sigwait(&wait_mask, &sig) && SIGHUP == sig) {
+            if(reloader.joinable() && !reloader.timed_join(boost::posix_time::milliseconds(0))) {
+                std::cout << "[server] reload already in progress" << std::endl;
+                continue;
+            }
+            reloader = boost::thread(boost::bind(&ReloadData, boost::ref(h), boost::ref(serverConfig), boost::cref(numaNodes)));
+        }
+        if(reloader.joinable()) {
+            reloader.join();
+        }
 #else
         // Set console control handler to allow server to be stopped.
         console_ctrl_function = boost::bind(&Server::Stop, s);
@@ -138,14 +330,12 @@ int main (int argc, char *argv[]) {
         std::cout << std::endl << "[server] shutting down" << std::endl;
         s->Stop();
         t.join();
+        watcher.interrupt();
+        watcher.join();
+        h.PrintResponseCacheStatistics();
         delete s;
-        delete objects;
     } catch (std::exception& e) {
         std::cerr << "[fatal error] exception: " << e.what() << std::endl;
     }
-#ifdef __linux__
-    munlockall();
-#endif
-
     return 0;
 }